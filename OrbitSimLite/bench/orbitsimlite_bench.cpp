@@ -0,0 +1,523 @@
+// OrbitSimLite - micro benchmarks for the simulation core
+//
+// Like the numerical tests, this is a small self-contained runner rather
+// than a full benchmarking framework. Each case prints its timings (and,
+// where relevant, the accuracy it buys) to stdout.
+//
+// Usage (from the CMake build directory, ideally a Release build):
+//   cmake .. -DORBITSIMLITE_BUILD_BENCH=ON -DCMAKE_BUILD_TYPE=Release
+//   cmake --build . --target orbitsimlite_bench
+//   ./orbitsimlite_bench [case-name-filter]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "pipeline.hpp"
+#include "simulator.hpp"
+#include "transport.hpp"
+#include "snapshot_codec.hpp"
+
+using namespace orbitsimlite;
+
+namespace {
+
+// Wall-clock seconds taken by 'fn()'.
+template <class Fn>
+double seconds(Fn&& fn) {
+    const auto t0 = std::chrono::steady_clock::now();
+    fn();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1 - t0).count();
+}
+
+// Reproducible uniform numbers in [0, 1): a linear congruential generator
+// started from 'seed'.
+struct Lcg {
+    std::uint32_t seed;
+
+    double operator()() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<double>(seed >> 8) / 16777216.0;
+    }
+};
+
+// Sun and the four inner planets on circular orbits.
+std::vector<Body> inner_solar_system() {
+    const double sun_mass = 1.989e30;
+    std::vector<Body> bs;
+    bs.emplace_back(sun_mass, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 30.0, 0xFFFF00, false, true, "Sun");
+    const double radii[] = {5.79e10, 1.082e11, 1.496e11, 2.279e11};
+    const double masses[] = {3.301e23, 4.867e24, 5.972e24, 6.417e23};
+    for (int k = 0; k < 4; ++k) {
+        const double th = 1.3 * k;
+        const double v = std::sqrt(Physics::DefaultG * sun_mass / radii[k]);
+        bs.emplace_back(masses[k], Vec2{radii[k] * std::cos(th), radii[k] * std::sin(th)},
+                        Vec2{-v * std::sin(th), v * std::cos(th)}, 5.0, 0xFFFFFF);
+    }
+    return bs;
+}
+
+void bench_compensated_summation() {
+    // Cost of the compensated mode on a finely stepped run (300 s steps for
+    // ~10 years), and its benefit where round-off dominates: a massless
+    // planet around the Sun, whose exact position is known from the Kepler
+    // solution, at a step where RK4 truncation is negligible.
+    const int steps = 1000000;
+    const double dt = 300.0;
+    for (Integrator kind : {Integrator::Euler, Integrator::RK4}) {
+        double cost[2] = {0.0, 0.0};
+        double error[2] = {0.0, 0.0};
+        for (int compensated = 0; compensated < 2; ++compensated) {
+            Simulator sim(Physics::DefaultG, dt, kind);
+            sim.set_bodies(inner_solar_system());
+            sim.set_compensated(compensated != 0);
+            cost[compensated] = seconds([&] {
+                for (int i = 0; i < steps; ++i) sim.step();
+            }) / steps;
+
+            const double sun_mass = 1.989e30;
+            const double r = 1.496e11;
+            Simulator kepler(Physics::DefaultG, dt, kind);
+            kepler.add_body(Body(sun_mass, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 30.0, 0xFFFF00, false, true));
+            kepler.add_body(Body(0.0, Vec2{r, 0.0}, Vec2{0.0, std::sqrt(Physics::DefaultG * sun_mass / r)},
+                                 5.0, 0xFFFFFF));
+            kepler.set_compensated(compensated != 0);
+            Vec2 exact_pos = kepler.get_bodies()[1].pos;
+            Vec2 exact_vel = kepler.get_bodies()[1].vel;
+            for (int i = 0; i < steps; ++i) kepler.step();
+            Physics::kepler_drift(exact_pos, exact_vel, Physics::DefaultG * sun_mass, kepler.get_time());
+            error[compensated] = (kepler.get_bodies()[1].pos - exact_pos).length() / r;
+        }
+        std::cout << "  " << (kind == Integrator::Euler ? "Euler" : "RK4  ")
+                  << "  plain: " << 1e9 * cost[0] << " ns/step, rel. position error " << error[0]
+                  << "  compensated: " << 1e9 * cost[1] << " ns/step, rel. position error " << error[1]
+                  << "  (overhead " << 100.0 * (cost[1] / cost[0] - 1.0) << "%)\n";
+    }
+}
+
+void bench_snapshot_codec() {
+    // Size and speed of recorded histories: 2000 bodies on circular orbits,
+    // one snapshot per step, at a few position/velocity resolutions.
+    const double sun_mass = 1.989e30;
+    Simulator sim(Physics::DefaultG, 3600.0, Integrator::RK4);
+    sim.add_body(Body(sun_mass, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 30.0, 0xFFFF00, false, true, "Sun"));
+    for (int k = 0; k < 2000; ++k) {
+        const double r = 1.0e11 + 1.0e8 * k;
+        const double th = 0.61803398875 * k;
+        const double v = std::sqrt(Physics::DefaultG * sun_mass / r);
+        Body b(0.0, Vec2{r * std::cos(th), r * std::sin(th)}, Vec2{-v * std::sin(th), v * std::cos(th)}, 1.0, 0xFFFFFF);
+        b.is_test_particle = true;
+        sim.add_body(b);
+    }
+    const int frames = 200;
+    std::vector<std::vector<Body>> history;
+    for (int f = 0; f < frames; ++f) {
+        sim.step();
+        history.push_back(sim.get_bodies());
+    }
+    const double raw = 56.0 * static_cast<double>(sim.get_bodies().size()) * frames;
+
+    for (double step : {1.0, 1.0e3, 1.0e6}) {
+        SnapshotCodecOptions options;
+        options.position_step = step;
+        options.velocity_step = step * 1e-6;
+        SnapshotEncoder encoder(options);
+        std::vector<std::uint8_t> stream;
+        const double enc = seconds([&] {
+            for (const auto& bs : history) encoder.encode(bs, 0.0, stream);
+        });
+        SnapshotDecoder decoder;
+        Snapshot snap;
+        std::size_t offset = 0;
+        const double dec = seconds([&] {
+            while (offset < stream.size() && decoder.decode(stream.data(), stream.size(), offset, snap)) {
+            }
+        });
+        std::cout << "  position step " << step << " m: " << static_cast<double>(stream.size()) / frames / 1024.0
+                  << " KiB/frame (" << 100.0 * static_cast<double>(stream.size()) / raw << "% of raw)"
+                  << "  encode " << raw / enc / 1.0e6 << " MB/s, decode " << raw / dec / 1.0e6
+                  << " MB/s (raw-equivalent)\n";
+    }
+}
+
+void bench_body_churn() {
+    // Debris churn: 50k bodies, despawn and respawn 1000 per round, either
+    // through handles (swap-remove) or by erasing from the body vector.
+    const std::size_t n = 50000, churn = 1000;
+    const int rounds = 50;
+    std::vector<Body> debris;
+    for (std::size_t k = 0; k < n; ++k) {
+        debris.emplace_back(1.0, Vec2{static_cast<double>(k), 0.0}, Vec2{}, 1.0, 0xFFFFFF);
+    }
+
+    Simulator by_handle(Physics::DefaultG, 1.0, Integrator::Euler);
+    std::vector<BodyHandle> handles;
+    for (const auto& b : debris) handles.push_back(by_handle.add_body(b));
+    const double t_handle = seconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            for (std::size_t k = 0; k < churn; ++k) {
+                const std::size_t pick = (k * 7919 + static_cast<std::size_t>(r) * 104729) % handles.size();
+                by_handle.remove_body(handles[pick]);
+                handles[pick] = by_handle.add_body(debris[pick]);
+            }
+        }
+    });
+
+    Simulator by_erase(Physics::DefaultG, 1.0, Integrator::Euler);
+    by_erase.set_bodies(debris);
+    const double t_erase = seconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            for (std::size_t k = 0; k < churn; ++k) {
+                const std::size_t pick = (k * 7919 + static_cast<std::size_t>(r) * 104729) % n;
+                auto& bodies = by_erase.access_bodies();
+                bodies.erase(bodies.begin() + static_cast<std::ptrdiff_t>(pick));
+                bodies.push_back(debris[pick]);
+            }
+        }
+    });
+
+    const double ops = static_cast<double>(rounds) * churn;
+    std::cout << "  " << n << " bodies: remove+add via handle " << 1e9 * t_handle / ops
+              << " ns, via vector erase " << 1e9 * t_erase / ops << " ns\n";
+}
+
+
+void bench_hierarchical_moon() {
+    // Inner solar system plus the Moon over one year: flat RK4 at the step
+    // the Moon needs versus 6-hour outer steps with the Earth-Moon pair as a
+    // subsystem. Error is the Moon's offset from Earth against a 60 s
+    // Wisdom-Holman reference, relative to the Earth-Moon distance.
+    std::vector<Body> bodies = inner_solar_system();
+    const Body& earth = bodies[3];
+    const double moon_speed = std::sqrt(Physics::DefaultG * earth.mass / 3.844e8);
+    const Vec2 out = earth.pos.normalized();
+    bodies.emplace_back(7.35e22, earth.pos + 3.844e8 * out, earth.vel + moon_speed * Vec2{-out.y, out.x}, 2.0,
+                        0xFFFFFF, true);
+
+    const double span = 360.0 * 86400.0;
+    auto run_for = [&](Simulator& sim, bool hierarchical) {
+        sim.set_bodies(bodies);
+        if (hierarchical) sim.detect_subsystems();
+        const int steps = static_cast<int>(std::lround(span / sim.get_dt()));
+        return seconds([&] {
+            for (int k = 0; k < steps; ++k) sim.step();
+        });
+    };
+    auto moon_offset = [](const Simulator& sim) { return sim.get_bodies()[5].pos - sim.get_bodies()[3].pos; };
+
+    Simulator ref(Physics::DefaultG, 60.0, Integrator::WisdomHolman);
+    run_for(ref, false);
+
+    struct Case {
+        const char* label;
+        double dt;
+        bool hierarchical;
+    };
+    const Case cases[] = {{"flat RK4, dt 600 s  ", 600.0, false},
+                          {"flat RK4, dt 3600 s ", 3600.0, false},
+                          {"hierarchical, dt 6 h", 21600.0, true}};
+    for (const Case& c : cases) {
+        Simulator sim(Physics::DefaultG, c.dt, Integrator::RK4);
+        const double t = run_for(sim, c.hierarchical);
+        const double err = (moon_offset(sim) - moon_offset(ref)).length() / 3.844e8;
+        std::cout << "  " << c.label << ": " << t * 1.0e3 << " ms, moon error " << err << "\n";
+    }
+}
+
+void bench_spatial_order() {
+    // Bodies scattered over a square in random storage order versus after
+    // Morton reordering. The collision pass bins bodies into a uniform grid
+    // of cells about one contact distance wide and tests every body against
+    // the 3x3 neighbouring cells, the way a broad-phase collision check
+    // would; its memory access pattern follows storage order. The force pass
+    // is the direct sum of one Euler step, which streams all sources anyway.
+    Lcg next{2024u};
+    auto make = [&](std::size_t n) {
+        std::vector<Body> bs;
+        bs.reserve(n);
+        for (std::size_t k = 0; k < n; ++k) {
+            bs.emplace_back(1.0, Vec2{next(), next()}, Vec2{}, 1.0, 0xFFFFFF);
+        }
+        return bs;
+    };
+
+    auto collision_pass = [](const std::vector<Body>& bs, double contact) {
+        const std::size_t cells = static_cast<std::size_t>(1.0 / contact);
+        auto cell_of = [&](const Vec2& p) {
+            const std::size_t cx = std::min(static_cast<std::size_t>(p.x * cells), cells - 1);
+            const std::size_t cy = std::min(static_cast<std::size_t>(p.y * cells), cells - 1);
+            return cy * cells + cx;
+        };
+        std::vector<std::uint32_t> start(cells * cells + 1, 0), items(bs.size());
+        for (const Body& b : bs) ++start[cell_of(b.pos) + 1];
+        for (std::size_t c = 0; c < cells * cells; ++c) start[c + 1] += start[c];
+        std::vector<std::uint32_t> fill(start.begin(), start.end() - 1);
+        for (std::size_t i = 0; i < bs.size(); ++i) items[fill[cell_of(bs[i].pos)]++] = static_cast<std::uint32_t>(i);
+
+        std::size_t contacts = 0;
+        for (std::size_t i = 0; i < bs.size(); ++i) {
+            const std::size_t c = cell_of(bs[i].pos);
+            const std::size_t cx = c % cells, cy = c / cells;
+            for (std::size_t y = (cy > 0 ? cy - 1 : 0); y <= std::min(cy + 1, cells - 1); ++y) {
+                for (std::size_t x = (cx > 0 ? cx - 1 : 0); x <= std::min(cx + 1, cells - 1); ++x) {
+                    for (std::uint32_t k = start[y * cells + x]; k < start[y * cells + x + 1]; ++k) {
+                        const std::uint32_t j = items[k];
+                        if (j > i && (bs[j].pos - bs[i].pos).length_squared() < contact * contact) ++contacts;
+                    }
+                }
+            }
+        }
+        return contacts;
+    };
+
+    {
+        const std::size_t n = 1000000;
+        Simulator sim(1.0, 1e-6, Integrator::Euler);
+        sim.set_bodies(make(n));
+        std::size_t contacts[2] = {0, 0};
+        double t[2];
+        t[0] = seconds([&] { contacts[0] = collision_pass(sim.get_bodies(), 1e-3); });
+        const double t_sort = seconds([&] { sim.reorder_bodies(); });
+        t[1] = seconds([&] { contacts[1] = collision_pass(sim.get_bodies(), 1e-3); });
+        std::cout << "  collision pass, " << n << " bodies: random order " << t[0] * 1e3 << " ms, Morton order "
+                  << t[1] * 1e3 << " ms (reorder " << t_sort * 1e3 << " ms, " << contacts[0] << "/" << contacts[1]
+                  << " contacts)\n";
+    }
+    {
+        const std::size_t n = 20000;
+        Simulator sim(1.0, 1e-6, Integrator::Euler);
+        sim.set_bodies(make(n));
+        sim.step(); // initial force pass
+        const double t_random = seconds([&] { sim.step(); });
+        sim.reorder_bodies();
+        const double t_sorted = seconds([&] { sim.step(); });
+        std::cout << "  force pass, " << n << " bodies: random order " << t_random * 1e3 << " ms, Morton order "
+                  << t_sorted * 1e3 << " ms\n";
+    }
+}
+
+// Doubles per vector register of the target the benchmark is compiled for.
+#if defined(__AVX512F__)
+constexpr std::size_t kVectorDoubles = 8;
+#elif defined(__AVX__)
+constexpr std::size_t kVectorDoubles = 4;
+#else
+constexpr std::size_t kVectorDoubles = 2; // SSE2, NEON
+#endif
+
+#if defined(__GNUC__)
+typedef double Lanes __attribute__((vector_size(8 * kVectorDoubles)));
+constexpr std::size_t kLaneDoubles = kVectorDoubles;
+#else
+using Lanes = double; // scaled to the vector width below
+constexpr std::size_t kLaneDoubles = 1;
+#endif
+
+// Multiply/add ceiling: 6 independent add chains and 6 independent multiply
+// chains, each a named vector variable so that none of them lives in
+// memory. Current cores retire at most two vector multiplies or adds per
+// cycle (four pipes on Zen) at a latency of 3 to 4 cycles, so 12 chains
+// keep every pipe busy, and 12 accumulators plus two constants still fit
+// the 16 vector registers of x86-64. Multiplies and adds do not feed each
+// other, so no chain waits on the other kind.
+double mul_add_peak_gflops(long iters, double& result) {
+    const Lanes step = Lanes {} + 1e-7, factor = Lanes {} + 0.9999999;
+    Lanes s0 = Lanes {} + 0.0, s1 = s0 + 0.1, s2 = s0 + 0.2, s3 = s0 + 0.3, s4 = s0 + 0.4, s5 = s0 + 0.5;
+    Lanes p0 = Lanes {} + 1.0, p1 = p0 + 0.1, p2 = p0 + 0.2, p3 = p0 + 0.3, p4 = p0 + 0.4, p5 = p0 + 0.5;
+    const double t = seconds([&] {
+        for (long it = 0; it < iters; ++it) {
+            s0 += step, s1 += step, s2 += step, s3 += step, s4 += step, s5 += step;
+            p0 *= factor, p1 *= factor, p2 *= factor, p3 *= factor, p4 *= factor, p5 *= factor;
+        }
+    });
+    const Lanes all = s0 + s1 + s2 + s3 + s4 + s5 + p0 + p1 + p2 + p3 + p4 + p5;
+    result = 0.0;
+    for (std::size_t l = 0; l < kLaneDoubles; ++l) result += reinterpret_cast<const double*>(&all)[l];
+    return 12.0 * kVectorDoubles * static_cast<double>(iters) / t * 1e-9;
+}
+
+void bench_direct_kernel_roofline() {
+    // Direct-sum force pass, tiled ('ForceKernel::compute') versus one
+    // target at a time ('field_at'), against two ceilings measured on this
+    // machine: multiply/add throughput, and the throughput of the sqrt and
+    // division every interaction needs. An interaction is counted as 20
+    // flops (sqrt and division as one each). With 256-source tiles shared by
+    // 64 targets, the kernel loads 0.5 bytes per interaction from L2, about
+    // 40 flops per byte, so it is compute-bound at every N.
+    double lane_sum = 0.0;
+    const double peak_gflops = mul_add_peak_gflops(20000000, lane_sum);
+
+    // Full-precision inputs: some cores finish sqrt and division early on
+    // short mantissas, which would overstate the ceiling.
+    std::vector<double> in(4096), acc(4096, 0.0);
+    std::uint32_t in_seed = 7u;
+    for (double& x : in) {
+        in_seed = in_seed * 1664525u + 1013904223u;
+        x = 1.0 + static_cast<double>(in_seed) / 4294967296.0;
+    }
+    const long rsqrt_reps = 20000;
+    const double t_rsqrt = seconds([&] {
+        for (long r = 0; r < rsqrt_reps; ++r) {
+            for (std::size_t k = 0; k < in.size(); ++k) acc[k] += 1.0 / std::sqrt(in[k]);
+        }
+    });
+    const double rsqrt_rate = static_cast<double>(rsqrt_reps) * in.size() / t_rsqrt;
+    std::cout << "  ceilings: mul/add " << peak_gflops << " GFLOP/s, sqrt+div " << rsqrt_rate * 1e-9
+              << " G/s (" << 20.0 * rsqrt_rate * 1e-9 << " GFLOP/s at 20 flops per interaction)\n";
+    volatile double keep = lane_sum + acc[0]; // the loops above must not be optimised away
+    (void)keep;
+
+    for (std::size_t n : {2000, 5000, 20000}) {
+        std::vector<Body> bodies;
+        Lcg next{99u};
+        for (std::size_t k = 0; k < n; ++k) bodies.emplace_back(1.0, Vec2{next(), next()}, Vec2{}, 1.0, 0xFFFFFF);
+        TestParticles none;
+        ForceKernel<NewtonianGravity> kernel;
+
+        const int reps = (n <= 5000) ? 5 : 1;
+        const double t_tiled = seconds([&] {
+            for (int r = 0; r < reps; ++r) kernel.compute(bodies, none, 1.0);
+        }) / reps;
+        const double t_scalar = seconds([&] {
+            for (int r = 0; r < reps; ++r) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    double phi = 0.0;
+                    bodies[i].acc = kernel.field_at(bodies[i].pos, 0.0, kernel.source_of(i), phi);
+                }
+            }
+        }) / reps;
+
+        const double pairs = static_cast<double>(n) * static_cast<double>(n - 1);
+        const double gflops = 20.0 * pairs / t_tiled * 1e-9;
+        std::cout << "  N=" << n << ": tiled " << t_tiled * 1e3 << " ms (" << gflops << " GFLOP/s, "
+                  << 100.0 * pairs / t_tiled / rsqrt_rate << "% of sqrt+div, " << 100.0 * gflops / peak_gflops
+                  << "% of mul/add), one target at a time " << t_scalar * 1e3 << " ms\n";
+    }
+}
+
+void bench_domain_decomposition() {
+#ifdef _WIN32
+    std::cout << "  (needs fork and Unix domain sockets)\n";
+#else
+    // A debris cloud of 10^6 test particles around a star and 255 moonlets,
+    // stepped with Euler by 1, 2 and 4 processes joined by a SocketTransport.
+    // Every rank integrates its own domain and receives the 256 source
+    // records of the others before each force pass. Times are wall clock on
+    // rank 0 between barriers, so they include waiting for the slowest rank
+    // and the exchanges; they only fall with the rank count when every
+    // process has a core of its own.
+    constexpr std::size_t moonlets = 255;
+    constexpr std::size_t debris = 1000000;
+    Lcg next{2024u};
+    auto circular = [&](double r) {
+        const double th = 6.283185307179586 * next();
+        const double v = 1.0 / std::sqrt(r);
+        return std::make_pair(Vec2{r * std::cos(th), r * std::sin(th)}, Vec2{-v * std::sin(th), v * std::cos(th)});
+    };
+    std::vector<Body> bodies;
+    bodies.emplace_back(1.0, Vec2{}, Vec2{}, 10.0, 0xFFFF00, false, true, "Star");
+    for (std::size_t k = 0; k < moonlets; ++k) {
+        const auto [p, v] = circular(1.0 + 2.0 * next());
+        bodies.emplace_back(1e-9, p, v, 1.0, 0xFFFFFF);
+    }
+    TestParticles cloud;
+    cloud.reserve(debris);
+    for (std::size_t k = 0; k < debris; ++k) {
+        const auto [p, v] = circular(1.0 + 2.0 * next());
+        cloud.add(p, v);
+    }
+
+    std::cout << "  " << std::thread::hardware_concurrency() << " hardware thread(s)\n";
+    const std::string prefix = "/tmp/orbitsimlite_bench_" + std::to_string(::getpid()) + "_rank";
+    double one_rank = 0.0;
+    for (int ranks : {1, 2, 4}) {
+        // Rank 0 reports its timings through a pipe.
+        int result[2];
+        if (::pipe(result) != 0) return;
+        std::cout.flush();
+        std::vector<pid_t> children;
+        for (int r = 0; r < ranks; ++r) {
+            const pid_t pid = ::fork();
+            if (pid != 0) {
+                if (pid > 0) children.push_back(pid);
+                continue;
+            }
+            // Round-robin slices, so the first rebalance moves most of the cloud.
+            Simulator sim(1.0, 1e-3, Integrator::Euler);
+            for (std::size_t i = static_cast<std::size_t>(r); i < bodies.size(); i += ranks) sim.add_body(bodies[i]);
+            TestParticles slice;
+            for (std::size_t k = static_cast<std::size_t>(r); k < cloud.size(); k += ranks) {
+                slice.add(cloud.pos(k), cloud.vel(k));
+            }
+            sim.set_test_particles(slice);
+            SocketTransport transport;
+            if (!transport.connect(prefix, r, ranks) || !sim.set_transport(&transport)) ::_exit(1);
+
+            const int steps = 4;
+            double times[2];
+            transport.max(0.0); // barrier
+            times[0] = seconds([&] {
+                sim.rebalance();
+                transport.max(0.0);
+            });
+            sim.step(); // includes the initial force pass
+            transport.max(0.0);
+            times[1] = seconds([&] {
+                for (int k = 0; k < steps; ++k) sim.step();
+                transport.max(0.0);
+            }) / steps;
+            if (r == 0 && ::write(result[1], times, sizeof(times)) != static_cast<ssize_t>(sizeof(times))) ::_exit(1);
+            ::_exit(0);
+        }
+        ::close(result[1]);
+        double times[2] = {0.0, 0.0};
+        const bool got = ::read(result[0], times, sizeof(times)) == static_cast<ssize_t>(sizeof(times));
+        ::close(result[0]);
+        bool ok = got && children.size() == static_cast<std::size_t>(ranks);
+        for (pid_t pid : children) {
+            int status = 0;
+            ok = ::waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+        }
+        if (!ok) {
+            std::cout << "  " << ranks << " process(es): failed\n";
+            continue;
+        }
+        if (ranks == 1) one_rank = times[1];
+        std::cout << "  " << ranks << " process(es): " << times[1] * 1e3 << " ms/step wall (speedup "
+                  << one_rank / times[1] << "x), first rebalance " << times[0] * 1e3 << " ms\n";
+    }
+#endif
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* filter = (argc > 1) ? argv[1] : "";
+
+    auto run = [&](const char* name, void (*fn)()) {
+        if (std::strstr(name, filter) == nullptr) return;
+        std::cout << "[BENCH] " << name << "\n";
+        fn();
+    };
+
+    run("compensated_summation", &bench_compensated_summation);
+    run("snapshot_codec", &bench_snapshot_codec);
+    run("body_churn", &bench_body_churn);
+    run("hierarchical_moon", &bench_hierarchical_moon);
+    run("spatial_order", &bench_spatial_order);
+    run("direct_kernel_roofline", &bench_direct_kernel_roofline);
+    run("domain_decomposition", &bench_domain_decomposition);
+    return 0;
+}
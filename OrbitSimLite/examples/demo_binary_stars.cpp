@@ -13,9 +13,9 @@ int main() {
     std::cout << "Enter simulator speed multiplier for two-suns demo: ";
     std::cin >> multiplier;
 
-    // Use a moderate timestep with substeps
+    // Use a moderate timestep; substeps are chosen from the binary's period
     Simulator sim(Physics::DefaultG, 3600.0 * multiplier, Integrator::RK4);
-    sim.set_substeps(20);
+    sim.set_auto_substeps(0.01);
 
     // Two equal-mass stars
     double mass_sun = 1.989e30;
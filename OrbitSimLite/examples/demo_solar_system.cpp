@@ -15,7 +15,9 @@ int main() {
     std::cin >> multiplier;
 
     Simulator sim(Physics::DefaultG, 36000.0 * multiplier, Integrator::RK4);
-    sim.set_substeps(12); // 12 substeps -> 3000s / 12 internal step
+    // Substeps follow the fastest orbit, so larger multipliers stay accurate
+    // and only cost more substeps.
+    sim.set_auto_substeps(0.01);
 
     // Bodies
 
@@ -110,6 +112,10 @@ int main() {
         sim.add_body(mars);
     }
 
+    // The Moon orbits Earth in its own Jacobi coordinates, so the automatic
+    // substeps only need to resolve the planetary orbits.
+    sim.detect_subsystems();
+
     // Renderer
     Renderer renderer(1000, 800, 2e-9);
     renderer.run(sim);
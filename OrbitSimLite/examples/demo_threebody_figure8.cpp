@@ -34,7 +34,13 @@ int main() {
     const double G_dimless = 1.0;
     const double dt = 0.001 * multiplier; // base step
     Simulator sim(G_dimless, dt, Integrator::RK4);
-    sim.set_substeps(4); // effective internal step dt/4
+    // At least 4 substeps (internal step dt/4), more while two bodies are
+    // close enough for their orbital timescale to need it.
+    sim.set_substeps(4);
+    sim.set_auto_substeps(0.01);
+    // Perturbed variants pass through near-collisions; pairs closer than
+    // 0.1 units are regularised instead of needing more substeps.
+    sim.set_regularization(0.1);
 
     const double m = 1.0;
 
@@ -0,0 +1,81 @@
+// OrbitSimLite - Compile-time specialised simulator
+//
+// BasicSimulator fixes the integrator, the force law and the scalar type of
+// the pairwise loop at compile time:
+//
+//   BasicSimulator<RK4Integration>                          // Newtonian, double
+//   BasicSimulator<EulerIntegration, PlummerGravity>(G, dt, PlummerGravity{1e6})
+//   BasicSimulator<RK4Integration, NewtonianGravity, float> // float pair loop
+//
+// Every combination is a distinct type, so the compiler can inline the force
+// law into the kernel and the kernel into the integrator. It offers the same
+// body/time/diagnostics API as the runtime-configurable Simulator facade
+// (both derive from SimulatorBase); use the facade when the integrator must
+// be switchable at runtime, as in the demos.
+#pragma once
+
+#include <type_traits>
+#include <vector>
+
+#include "pipeline.hpp"
+#include "simulator_base.hpp"
+
+namespace orbitsimlite {
+
+template <class IntegratorPolicy, class ForceLaw = NewtonianGravity, class Scalar = double>
+class BasicSimulator final : public SimulatorBase {
+public:
+    using pipeline_type = Pipeline<IntegratorPolicy, ForceLaw, Scalar>;
+
+    explicit BasicSimulator(double G = Physics::DefaultG, double dt = 1.0,
+                            const ForceLaw& law = ForceLaw{})
+        : SimulatorBase(G, dt), pipeline_(law) {}
+
+    // The copied pipeline still points at the other simulator's pool.
+    BasicSimulator(const BasicSimulator& other) : SimulatorBase(other), pipeline_(other.pipeline_) {
+        pipeline_.set_execution(execution());
+    }
+    BasicSimulator& operator=(const BasicSimulator& other) {
+        if (this != &other) {
+            SimulatorBase::operator=(other);
+            pipeline_ = other.pipeline_;
+            pipeline_.set_execution(execution());
+        }
+        return *this;
+    }
+
+    const ForceLaw& force_law() const { return pipeline_.law(); }
+
+    // Optional drag / post-Newtonian terms (see ExtraForces).
+    void set_extra_forces(const ExtraForces& extra) {
+        pipeline_.set_extra_forces(extra);
+        invalidate_forces();
+    }
+    const ExtraForces& get_extra_forces() const { return pipeline_.extra_forces(); }
+
+protected:
+    double refresh_forces(std::vector<Body>& bodies, TestParticles& tracers, double G) override {
+        return pipeline_.refresh(bodies, tracers, G);
+    }
+
+    double advance(std::vector<Body>& bodies, TestParticles& tracers, double G, double h, int n) override {
+        return pipeline_.advance(bodies, tracers, G, h, n);
+    }
+
+    double compute_potential(const std::vector<Body>& bodies, double G) const override {
+        return pipeline_.potential(bodies, G);
+    }
+
+    void apply_execution(const ExecutionOptions& options) override {
+        pipeline_.set_execution(options);
+    }
+
+    bool supports_transport() const override {
+        return !std::is_same_v<IntegratorPolicy, WisdomHolmanIntegration>;
+    }
+
+private:
+    pipeline_type pipeline_;
+};
+
+} // namespace orbitsimlite
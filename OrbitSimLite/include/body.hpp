@@ -8,6 +8,9 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include "name_table.hpp"
 #include "vec2.hpp"
 
 namespace orbitsimlite {
@@ -18,17 +21,30 @@ struct Body {
     Vec2 pos;            // Position in world space (metres).
     Vec2 vel;            // Velocity (metres / second).
     Vec2 acc;            // Acceleration (metres / second^2), updated per step.
+    Vec2 pos_carry;      // Low-order parts of pos / vel kept by the compensated
+    Vec2 vel_carry;      // summation mode (see SimulatorBase::set_compensated).
     std::uint32_t color; // Packed RGB colour in 0xRRGGBB format.
+    double softening;    // Gravitational softening length (metres), 0 for a point mass.
 
     bool is_satellite;   // True for natural satellites (e.g., Moon).
     bool is_star;        // True for stars (e.g., Sun); used by collision logic.
+    bool is_test_particle; // True for passive bodies: they feel gravity but are
+                           // not sources (restricted N-body problem).
 
-    // Optional display name used in JSON output and debug logging. When empty,
+    // Optional display name used in JSON output and debug logging, interned
+    // in the global name table (see name_table.hpp). When unnamed (kNoName),
     // JSON serialisation falls back to a synthetic "body_<index>" identifier.
-    std::string name;
+    NameId name_id;
 
     Body();
-    Body(double mass_, const Vec2& pos_, const Vec2& vel_, double radius_, std::uint32_t color_, bool is_satellite_ = false, bool is_star_ = false, const std::string& name_ = {});
+    Body(double mass_, const Vec2& pos_, const Vec2& vel_, double radius_, std::uint32_t color_, bool is_satellite_ = false, bool is_star_ = false, std::string_view name_ = {});
+
+    const std::string& name() const { return name_of(name_id); }
+    bool has_name() const { return name_id != kNoName; }
+    void set_name(std::string_view n) { name_id = intern_name(n); }
 };
 
+// Bodies are copied wholesale by the integrators and exporters.
+static_assert(std::is_trivially_copyable_v<Body>, "Body must stay trivially copyable");
+
 } // namespace orbitsimlite
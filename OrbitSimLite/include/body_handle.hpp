@@ -0,0 +1,71 @@
+// OrbitSimLite - Stable body handles
+//
+// Bodies are stored densely (the force loops iterate a plain vector), so a
+// body's index changes whenever another one is removed. A BodyHandle names a
+// body independently of its position: it refers to a slot in a HandleTable,
+// which maps slots to dense indices and back. Removing a body moves the last
+// body into the gap (O(1), no shifting), and only that one moved body's
+// mapping is updated.
+//
+// Every slot carries a generation counter that is bumped when its body is
+// removed, so a handle to a removed body is detected as stale instead of
+// silently aliasing whatever body later reuses the slot.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace orbitsimlite {
+
+struct BodyHandle {
+    static constexpr std::uint32_t kInvalidSlot = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t slot {kInvalidSlot};
+    std::uint32_t generation {0};
+
+    bool operator==(const BodyHandle& o) const { return slot == o.slot && generation == o.generation; }
+    bool operator!=(const BodyHandle& o) const { return !(*this == o); }
+};
+
+class HandleTable {
+public:
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    // Number of live handles (equals the number of dense elements).
+    std::size_t size() const { return dense_.size(); }
+
+    // Issue a handle for a new element appended at dense index size().
+    BodyHandle insert();
+
+    // Bookkeeping for a swap-remove of dense element 'index': its handle
+    // becomes stale and the last element takes over 'index'.
+    void erase_at(std::size_t index);
+
+    // Dense index of 'h', or npos if the handle is stale or invalid.
+    std::size_t index_of(BodyHandle h) const;
+
+    // Handle of the element at dense index 'index' (< size()).
+    BodyHandle handle_at(std::size_t index) const;
+
+    // Bookkeeping for a reordering in which the element at dense index
+    // order[k] moves to index k ('order' is a permutation of 0 .. size()).
+    // Every handle stays valid and follows its element.
+    void permute(const std::vector<std::size_t>& order);
+
+    // Invalidate every handle and issue fresh ones for 'n' elements.
+    void reset(std::size_t n);
+
+private:
+    struct Slot {
+        std::uint32_t dense;
+        std::uint32_t generation;
+    };
+
+    std::vector<Slot> slots_;
+    std::vector<std::uint32_t> dense_; // slot of each dense element
+    std::vector<std::uint32_t> free_;  // slots available for reuse
+};
+
+} // namespace orbitsimlite
@@ -0,0 +1,28 @@
+// OrbitSimLite - Interpolation of body states within a step
+//
+// After a step both ends are known to the integrator's accuracy: position,
+// velocity and acceleration at the start (the cached force pass) and at the
+// end (refreshed by every integrator). The quintic Hermite polynomial
+// through these six values reproduces the trajectory between them with a
+// local error of O(h^6), independently of the integration scheme, and costs
+// no force evaluations.
+#pragma once
+
+#include <vector>
+
+#include "body.hpp"
+#include "vec2.hpp"
+
+namespace orbitsimlite {
+
+// State at fraction 'f' in [0, 1] of a step of length 'h' from 'start' to
+// 'end' (the same body at both ends). Writes position, velocity and
+// acceleration.
+void interpolate_state(const Body& start, const Body& end, double h, double f, Vec2& pos, Vec2& vel, Vec2& acc);
+
+// 'out' becomes 'end' with pos/vel/acc replaced by the interpolated state at
+// fraction 'f'. 'start' and 'end' must list the same bodies.
+void interpolate_bodies(const std::vector<Body>& start, const std::vector<Body>& end, double h, double f,
+                        std::vector<Body>& out);
+
+} // namespace orbitsimlite
@@ -0,0 +1,72 @@
+// OrbitSimLite - Incrementally updated density grid for dense particle fields
+//
+// The renderer's level-of-detail path bins bodies and test particles into
+// coarse screen cells. Cells holding at least 'threshold' items are drawn as
+// one heatmap pixel instead of individual points. DensityMap keeps the
+// per-cell counts and the RGBA heatmap pixels; items are re-binned with
+// 'place', which only touches the two affected cells, and the bounding box
+// of modified pixels is tracked so the texture upload can be limited to it.
+//
+// It has no SFML dependency so it can be used (and tested) headless.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace orbitsimlite {
+
+class DensityMap {
+public:
+    // Cell value meaning "not on the grid".
+    static constexpr int kOutside = -1;
+
+    // Clear the grid and resize it to 'cols' x 'rows' cells, tracking
+    // 'items' items (all initially outside).
+    void reset(unsigned cols, unsigned rows, std::size_t items, unsigned threshold);
+
+    unsigned cols() const { return cols_; }
+    unsigned rows() const { return rows_; }
+    std::size_t items() const { return cell_of_.size(); }
+    unsigned threshold() const { return threshold_; }
+
+    // Cell index for grid coordinates, or kOutside when off the grid.
+    int cell_at(int cx, int cy) const;
+
+    // Move item 'item' to 'cell' (or kOutside). O(1).
+    void place(std::size_t item, int cell);
+
+    std::uint32_t count(int cell) const { return counts_[static_cast<std::size_t>(cell)]; }
+
+    // True when 'cell' is aggregated into the heatmap (count >= threshold).
+    bool aggregated(int cell) const { return cell != kOutside && count(cell) >= threshold_; }
+
+    // RGBA pixels, one per cell, row-major.
+    const std::vector<std::uint8_t>& pixels() const { return pixels_; }
+
+    // Bounding box [x0, x1) x [y0, y1) of cells changed since the last
+    // 'clear_dirty'. Empty when x0 >= x1.
+    bool dirty() const { return dirty_x0_ < dirty_x1_; }
+    unsigned dirty_x0() const { return dirty_x0_; }
+    unsigned dirty_y0() const { return dirty_y0_; }
+    unsigned dirty_x1() const { return dirty_x1_; }
+    unsigned dirty_y1() const { return dirty_y1_; }
+    void clear_dirty();
+
+private:
+    void touch(int cell);
+
+    unsigned cols_ {0};
+    unsigned rows_ {0};
+    unsigned threshold_ {1};
+    std::vector<std::uint32_t> counts_;
+    std::vector<int> cell_of_;
+    std::vector<std::uint8_t> pixels_;
+
+    unsigned dirty_x0_ {0};
+    unsigned dirty_y0_ {0};
+    unsigned dirty_x1_ {0};
+    unsigned dirty_y1_ {0};
+};
+
+} // namespace orbitsimlite
@@ -0,0 +1,39 @@
+// OrbitSimLite - Conserved-quantity diagnostics
+//
+// A small value type collecting the global invariants of an isolated N-body
+// system (energy, linear/angular momentum, centre of mass). Monitoring these
+// over time is the usual way to detect that an integration has gone unstable
+// long before bodies visibly leave the screen.
+//
+// The potential energy is not recomputed here: it is accumulated by the
+// Simulator during its force pass (reusing the pair distances it already
+// evaluates) and passed in, so building a Diagnostics snapshot is O(N).
+#pragma once
+
+#include <vector>
+#include "body.hpp"
+
+namespace orbitsimlite {
+
+struct Diagnostics {
+    double total_mass {0.0};        // Sum of all body masses (kg).
+    double kinetic_energy {0.0};    // Sum of 1/2 m v^2 (J).
+    double potential_energy {0.0};  // Pairwise gravitational energy (J).
+    double total_energy {0.0};      // kinetic_energy + potential_energy (J).
+
+    Vec2 linear_momentum;           // Sum of m v (kg m / s).
+    double angular_momentum {0.0};  // z-component of sum of m (r x v) about the origin.
+
+    Vec2 center_of_mass;            // Mass-weighted mean position (m).
+    Vec2 center_of_mass_velocity;   // Mass-weighted mean velocity (m / s).
+};
+
+// Build a Diagnostics snapshot from the current bodies and a precomputed
+// total potential energy. Runs in O(N).
+Diagnostics compute_diagnostics(const std::vector<Body>& bodies, double potential_energy);
+
+// Relative deviation |value - reference| / |reference|, guarded against a
+// zero reference. Used for energy drift monitoring.
+double relative_drift(double value, double reference);
+
+} // namespace orbitsimlite
@@ -0,0 +1,50 @@
+// OrbitSimLite - Spatial domain decomposition across ranks
+//
+// Each rank of a Transport owns the bodies and test particles of one
+// domain: a contiguous range of the Morton curve (spatial_order.hpp) over
+// the bounding box of the whole system. The ranges are chosen from a global
+// histogram of the curve so that every rank gets about the same number of
+// targets; a force pass costs the same per target, so this balances the
+// work. Bodies that drift out of their domain are handed over by
+// 'migrate_to_domains' (SimulatorBase::rebalance).
+//
+// The direct-sum force pass needs every source, so the ranks exchange the
+// compact source records of their active bodies (position, G m, softening)
+// before each pass and evaluate the forces on their own targets only (see
+// ForceKernel::load_sources). The traffic per pass is O(N_active), the work
+// O(N_active * N_local): bulk test particles and passive bodies never leave
+// their rank, which is what makes debris clouds of millions of tracers
+// scale with the number of ranks.
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "body.hpp"
+#include "diagnostics.hpp"
+#include "test_particles.hpp"
+#include "transport.hpp"
+
+namespace orbitsimlite {
+
+// Collective: the rank that owns each body and test particle under the
+// current decomposition. Bodies with non-finite positions stay where they
+// are.
+void assign_domains(const std::vector<Body>& bodies, const TestParticles& tracers, Transport& transport,
+                    std::vector<int>& body_rank, std::vector<int>& tracer_rank);
+
+// Collective: send every body and test particle whose entry in 'body_rank'
+// / 'tracer_rank' names another rank there. The ones received from other
+// ranks are appended to 'arrived' / 'arrived_tracers' (in rank order);
+// nothing is removed from 'bodies' or 'tracers'. Names travel as text, so
+// ranks need not share a name table.
+void migrate_to_domains(const std::vector<Body>& bodies, const TestParticles& tracers,
+                        const std::vector<int>& body_rank, const std::vector<int>& tracer_rank, Transport& transport,
+                        std::vector<Body>& arrived, TestParticles& arrived_tracers);
+
+// Collective: combine the per-rank diagnostics of a decomposed simulation
+// (each covering the rank's own bodies and its share of the potential
+// energy) into those of the whole system.
+Diagnostics reduce_diagnostics(const Diagnostics& local, Transport& transport);
+
+} // namespace orbitsimlite
@@ -0,0 +1,65 @@
+// OrbitSimLite - Event conditions for SimulatorBase::add_event
+//
+// An event is the zero crossing of a scalar function of the body states,
+// g(bodies), in a chosen direction. After every step the simulator samples
+// g along the interpolated trajectory (dense_output.hpp), locates each
+// crossing to round-off with a bracketing root finder and calls the event's
+// callback with the exact time and the interpolated state at that time.
+//
+// The helpers below cover the usual orbital events. They refer to bodies by
+// handle, so they keep working while other bodies are added or removed; a
+// condition whose bodies are gone evaluates to NaN and never fires.
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "body.hpp"
+#include "body_handle.hpp"
+#include "vec2.hpp"
+
+namespace orbitsimlite {
+
+class SimulatorBase;
+
+enum class EventDirection {
+    Rising,  // g goes from negative to zero or positive
+    Falling, // g goes from positive to zero or negative
+    Both
+};
+
+using EventFunction = std::function<double(const std::vector<Body>& bodies)>;
+
+struct EventCondition {
+    EventFunction function;
+    EventDirection direction {EventDirection::Both};
+};
+
+struct EventInfo {
+    std::size_t id {0};       // as returned by add_event
+    double time {0.0};        // simulation time of the crossing
+    bool rising {false};      // direction of this crossing
+};
+
+// Called with the event and the interpolated bodies at the event time.
+using EventCallback = std::function<void(const EventInfo& event, const std::vector<Body>& bodies)>;
+
+// Closest approach of 'body' to 'other' (periapsis for an orbit, or a
+// conjunction of two bodies): the radial velocity dot(r, v) rising through
+// zero.
+EventCondition distance_minimum(const SimulatorBase& sim, BodyHandle body, BodyHandle other);
+
+// Largest separation (apoapsis): the radial velocity falling through zero.
+EventCondition distance_maximum(const SimulatorBase& sim, BodyHandle body, BodyHandle other);
+
+// The two-body energy of 'body' relative to 'primary', v^2/2 - G(m1+m2)/r,
+// becoming positive: the body is no longer bound to it.
+EventCondition escape(const SimulatorBase& sim, BodyHandle body, BodyHandle primary);
+
+// 'body' crossing the line through 'point' along 'direction'. Rising
+// crossings go from its right-hand side to its left-hand side.
+EventCondition line_crossing(const SimulatorBase& sim, BodyHandle body, const Vec2& point, const Vec2& direction,
+                             EventDirection which = EventDirection::Both);
+
+} // namespace orbitsimlite
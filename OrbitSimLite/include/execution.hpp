@@ -0,0 +1,34 @@
+// OrbitSimLite - Execution options of a force/integration pipeline
+//
+// Settings that change how a pipeline runs but not what it models: the
+// thread pool used for the per-body loops, the floating-point
+// reproducibility/accuracy modes and the ranks of a domain decomposition.
+// SimulatorBase owns them and hands them to the kernel of the active
+// pipeline whenever they change.
+#pragma once
+
+#include "thread_pool.hpp"
+
+namespace orbitsimlite {
+
+class Transport;
+
+struct ExecutionOptions {
+    // Pool for the per-body loops; nullptr runs them serially.
+    ThreadPool* pool {nullptr};
+
+    // Reduce the potential energy in a fixed pairwise order, so it does not
+    // depend on the thread count.
+    bool reproducible {false};
+
+    // Keep compensated (TwoSum) accumulators for body positions and
+    // velocities (Body::pos_carry / Body::vel_carry).
+    bool compensated {false};
+
+    // Ranks sharing the simulation (see transport.hpp and domain.hpp); the
+    // sources of the other ranks are gathered before every force pass.
+    // nullptr: all bodies are local.
+    Transport* transport {nullptr};
+};
+
+} // namespace orbitsimlite
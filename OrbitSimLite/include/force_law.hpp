@@ -0,0 +1,131 @@
+// OrbitSimLite - Force laws
+//
+// A force law describes how the pairwise interaction depends on distance.
+// It is a small value type with a templated call operator:
+//
+//   template <typename T>
+//   void operator()(T dist2, T eps2, T& accel, T& potential) const;
+//
+// Given the squared separation 'dist2' of a pair and the pair softening
+// 'eps2' (the mean of the two bodies' squared Body::softening lengths), it
+// returns the two radial factors used by the force kernel:
+//
+//   a_i   += G * m_j * accel * (r_j - r_i)
+//   phi_i -= G * m_j * potential
+//
+// so for plain Newtonian gravity accel = 1/r^3 and potential = 1/r.
+//
+// Force laws are passed to the simulation pipeline as template parameters,
+// so the call is inlined into the pairwise loop instead of going through a
+// function pointer or virtual call. Any user type (including a generic
+// lambda) with the same call signature can be used in place of the laws
+// below. Implementations should prefer selects over early returns so that
+// the pair loop stays vectorisable.
+//
+// Velocity-dependent or non-pairwise effects (drag, post-Newtonian
+// corrections) are not part of the force law; see ExtraForces below.
+#pragma once
+
+#include <cmath>
+
+namespace orbitsimlite {
+
+// Default squared distance below which the Newtonian law ignores a pair. It
+// is intentionally small compared to the astronomical distances used in the
+// demos but prevents division-by-zero when two positions coincide.
+inline constexpr double kSingularityEps2 = 1e-9;
+
+// Point-mass Newtonian gravity (the library default). Per-body softening is
+// honoured Plummer-style; with all softening lengths at zero this is the
+// exact 1/r^2 law. Pairs whose (softened) squared separation does not exceed
+// 'min_dist2' are skipped.
+struct NewtonianGravity {
+    double min_dist2 {kSingularityEps2};
+
+    template <typename T>
+    void operator()(T dist2, T eps2, T& accel, T& potential) const {
+        const T d2 = dist2 + eps2;
+        const T inv = T(1) / std::sqrt(d2);
+        const bool resolved = d2 > T(min_dist2);
+        accel = resolved ? inv * inv * inv : T(0);
+        potential = resolved ? inv : T(0);
+    }
+};
+
+// Plummer-softened gravity: the point masses are replaced by Plummer spheres
+// of scale length 'softening' (metres), which bounds the force at small
+// separations:
+//
+//   accel = 1 / (r^2 + eps^2)^(3/2),   potential = 1 / (r^2 + eps^2)^(1/2)
+//
+// The global length is combined in quadrature with the per-body lengths.
+struct PlummerGravity {
+    double softening {0.0};
+
+    template <typename T>
+    void operator()(T dist2, T eps2, T& accel, T& potential) const {
+        const T inv = T(1) / std::sqrt(dist2 + eps2 + T(softening * softening));
+        accel = inv * inv * inv;
+        potential = inv;
+    }
+};
+
+// Cubic spline softening (Monaghan & Lattanzio 1985, as used in GADGET). The
+// mass is smoothed with a compact kernel of radius h = 2.8 * eps, so unlike
+// Plummer the force is exactly Newtonian beyond h while the Plummer-
+// equivalent softening length is 'eps'. The global length is combined in
+// quadrature with the per-body lengths.
+struct SplineGravity {
+    double softening {0.0};
+
+    template <typename T>
+    void operator()(T dist2, T eps2, T& accel, T& potential) const {
+        const T e2 = eps2 + T(softening * softening);
+        const T h = T(2.8) * std::sqrt(e2);
+        const T r = std::sqrt(dist2);
+
+        // Newtonian branch (also used when no softening is configured).
+        const T inv = T(1) / r;
+        const T newton_acc = inv * inv * inv;
+
+        const T h_inv = T(1) / h;
+        const T h_inv3 = h_inv * h_inv * h_inv;
+        const T u = r * h_inv;
+        const T u2 = u * u;
+
+        // Inner (u < 1/2) and outer (1/2 <= u < 1) kernel pieces.
+        const T in_acc = h_inv3 * (T(10.666666666667) + u2 * (T(32.0) * u - T(38.4)));
+        const T in_pot = -h_inv * (T(-2.8) + u2 * (T(5.333333333333) + u2 * (T(6.4) * u - T(9.6))));
+        const T out_acc = h_inv3 * (T(21.333333333333) - T(48.0) * u + T(38.4) * u2 -
+                                    T(10.666666666667) * u2 * u - T(0.066666666667) / (u2 * u));
+        const T out_pot = -h_inv * (T(-3.2) + T(0.066666666667) / u +
+                                    u2 * (T(10.666666666667) + u * (T(-16.0) + u * (T(9.6) - T(2.133333333333) * u))));
+
+        const bool smoothed = e2 > T(0) && u < T(1);
+        const bool inner = u < T(0.5);
+        accel = smoothed ? (inner ? in_acc : out_acc) : (dist2 > T(0) ? newton_acc : T(0));
+        potential = smoothed ? (inner ? in_pot : out_pot) : (dist2 > T(0) ? inv : T(0));
+    }
+};
+
+// Optional per-body accelerations applied after the pairwise sum. They are
+// evaluated once per body (not per pair) and skipped entirely when disabled.
+struct ExtraForces {
+    // Linear drag a = -drag_rate * v (1/s), e.g. gas drag on debris.
+    double drag_rate {0.0};
+
+    // First post-Newtonian correction of the central body's field, in the
+    // test-particle limit (harmonic gauge):
+    //
+    //   a = G M / (c^2 r^3) * [ (4 G M / r - v^2) r + 4 (r . v) v ]
+    //
+    // with r, v relative to the central body (the first 'is_star' body, or
+    // the most massive one). Reproduces the relativistic perihelion
+    // precession. Zero disables the term; otherwise the speed of light in
+    // simulation units.
+    double speed_of_light {0.0};
+
+    bool enabled() const { return drag_rate != 0.0 || speed_of_light > 0.0; }
+};
+
+} // namespace orbitsimlite
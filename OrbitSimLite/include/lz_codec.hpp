@@ -0,0 +1,38 @@
+// OrbitSimLite - Small LZ77 block codec
+//
+// A fast, dependency-free byte compressor in the spirit of LZ4: a single
+// hash table of recent 4-byte sequences, greedy matching, no entropy coding.
+// It is meant for the residual streams produced by SnapshotEncoder (long
+// runs of small, similar varints), where speed matters more than ratio.
+//
+// Block format: a sequence of
+//   varint literal_count, literal bytes, varint offset, [varint match_length - 4]
+// where offset == 0 terminates the block (and carries no match length).
+// Offsets and match lengths are at most 65536, which bounds how much a block
+// can expand (lz_max_decompressed_size).
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace orbitsimlite {
+
+// Append the compressed form of src[0 .. size) to 'out'.
+void lz_compress(const std::uint8_t* src, std::size_t size, std::vector<std::uint8_t>& out);
+
+// Largest output a block of 'size' compressed bytes can decode to.
+std::size_t lz_max_decompressed_size(std::size_t size);
+
+// Decompress one block of 'size' bytes at 'src' into 'out' (replacing its
+// contents). 'expected_size' is the uncompressed length recorded by the
+// caller; it is untrusted, and sizes the block cannot reach are rejected
+// before any memory is reserved. Returns false on malformed input.
+bool lz_decompress(const std::uint8_t* src, std::size_t size, std::size_t expected_size,
+                   std::vector<std::uint8_t>& out);
+
+// LEB128 variable-length integers, shared with the snapshot format.
+void put_varint(std::vector<std::uint8_t>& out, std::uint64_t value);
+bool get_varint(const std::uint8_t* src, std::size_t size, std::size_t& at, std::uint64_t& value);
+
+} // namespace orbitsimlite
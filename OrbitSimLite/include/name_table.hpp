@@ -0,0 +1,36 @@
+// OrbitSimLite - Interned body names
+//
+// Bodies refer to their display names through a small integer (NameId)
+// instead of owning a std::string, which keeps Body trivially copyable:
+// copying the body vector (RK4 stages, snapshots, removals) is a plain
+// memory copy with no allocation.
+//
+// Names live in one process-wide, append-only table. Interning the same
+// text twice yields the same id, ids are never reused, and the string
+// returned by 'name_of' stays valid (and unchanged) for the lifetime of the
+// program. All functions are thread-safe; lookups only take a shared lock.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace orbitsimlite {
+
+using NameId = std::uint32_t;
+
+// Id of the empty name; bodies without a name use it.
+inline constexpr NameId kNoName = 0;
+
+// Id for 'name', adding it to the table on first use. The empty string maps
+// to kNoName.
+NameId intern_name(std::string_view name);
+
+// Text of 'id'; the empty string for kNoName or an unknown id.
+const std::string& name_of(NameId id);
+
+// Number of distinct names interned so far (excluding the empty name).
+std::size_t interned_name_count();
+
+} // namespace orbitsimlite
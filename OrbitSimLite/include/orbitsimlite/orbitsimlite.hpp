@@ -4,6 +4,16 @@
 //  - version information
 //  - 2D vector math (Vec2)
 //  - Body, Physics, Simulator (core physics)
+//  - Diagnostics (conserved quantities)
+//  - event conditions and dense output between steps
+//  - Morton ordering of bodies for spatial locality
+//  - force laws and the compile-time BasicSimulator pipeline
+//  - Ensemble (many small systems stepped in lockstep), ThreadPool and TaskQueue
+//  - StepExecutor (asynchronous, cancellable advances on shared workers)
+//  - Transport (LoopbackGroup, SocketTransport) and the spatial domain decomposition
+//  - TelemetryServer/TelemetryClient (binary state stream over a local socket)
+//  - SnapshotEncoder/SnapshotDecoder (compressed state histories)
+//  - StatePublisher/StateReader (lock-free snapshots, optionally in shared memory)
 //  - optional SFML renderer and utility helpers
 //
 // Typical usage:
@@ -15,9 +25,29 @@
 #include <orbitsimlite/version.hpp>
 
 #include "vec2.hpp"
+#include "name_table.hpp"
 #include "body.hpp"
+#include "body_handle.hpp"
 #include "physics.hpp"
+#include "diagnostics.hpp"
+#include "test_particles.hpp"
+#include "dense_output.hpp"
+#include "events.hpp"
+#include "spatial_order.hpp"
+#include "force_law.hpp"
+#include "pipeline.hpp"
+#include "simulator_base.hpp"
 #include "simulator.hpp"
+#include "basic_simulator.hpp"
+#include "thread_pool.hpp"
+#include "task_queue.hpp"
+#include "step_executor.hpp"
+#include "transport.hpp"
+#include "domain.hpp"
+#include "telemetry.hpp"
+#include "snapshot_codec.hpp"
+#include "state_publisher.hpp"
+#include "ensemble.hpp"
 #include "renderer.hpp"
 #include "utils.hpp"
 
@@ -4,6 +4,8 @@
 //  - computation of pairwise Newtonian gravitational acceleration in 2D
 //  - a simple symplectic Euler integrator (good energy behaviour, low cost)
 //  - an educational Runge–Kutta 4 (RK4) step for smoother trajectories
+//  - an analytic Kepler drift (universal variables) used by the
+//    Wisdom–Holman integrator
 //
 // Notes:
 //  - All quantities are expressed in SI units (m, kg, s).
@@ -55,6 +57,19 @@ struct Physics {
     //
     // Reference: https://en.wikipedia.org/wiki/Runge%E2%80%93Kutta_methods
     static void step_rk4(Body& body, const std::vector<Body>& others, double G, double dt);
+
+    // Advance a relative position/velocity pair along its unperturbed Kepler
+    // orbit around a point mass with gravitational parameter mu = G * M, for
+    // a time 'dt' (which may be negative).
+    //
+    // The orbit is propagated analytically with Gauss' f and g functions in
+    // universal variables, so elliptic, parabolic and hyperbolic motion are
+    // handled uniformly and the result is exact up to round-off regardless of
+    // 'dt'. The universal Kepler equation is solved with Laguerre–Conway
+    // iterations.
+    //
+    // Reference: Danby, "Fundamentals of Celestial Mechanics", ch. 6.9.
+    static void kepler_drift(Vec2& pos, Vec2& vel, double mu, double dt);
 };
 
 } // namespace orbitsimlite
@@ -0,0 +1,901 @@
+// OrbitSimLite - Compile-time force/integration pipeline
+//
+// The building blocks used by BasicSimulator and the Simulator facade:
+//
+//  - ForceKernel<ForceLaw, Scalar>: gathers the active (massive) bodies
+//    into flat structure-of-arrays source buffers and evaluates the pairwise
+//    sum with the force law inlined. Passive bodies (Body::is_test_particle)
+//    and bulk TestParticles are targets only, so the cost of a force pass is
+//    O(N_active * N_total). 'Scalar' selects the precision of the pair loop
+//    (body state itself is always kept in double precision). Optional
+//    per-body ExtraForces are added after the pair sum.
+//  - EulerIntegration / RK4Integration / WisdomHolmanIntegration:
+//    integrator policies that advance a body set by a number of substeps
+//    using a kernel.
+//  - Pipeline<Integrator, ForceLaw, Scalar>: ties one integrator to one
+//    kernel, so every combination is a separate, fully specialised type.
+//
+// Full force passes are tiled: targets are taken in tiles of kTargetTile,
+// sources are streamed in L1-sized tiles of kSourceTile, and within a tile
+// kRegisterBlock targets are updated together per loaded source, with their
+// accumulators held in registers (see 'fields'). Each target still adds its
+// sources one by one in index order, so the tiled pass gives exactly the
+// same bits as evaluating 'field_at' target by target.
+//
+// A kernel can be given a ThreadPool; its per-target loops (and those of the
+// integrators) are then split across the threads. Because of the fixed
+// per-target order, accelerations and trajectories do not depend on the
+// thread count, and neither does the potential energy, whose per-target
+// terms are added in index order (or by pairwise summation in reproducible
+// mode, see 'set_execution').
+//
+// With a Transport in the execution options, the kernel is one rank of a
+// domain decomposition (domain.hpp): 'load_sources' gathers the sources of
+// all ranks, in rank order, and the targets are the rank's own bodies and
+// test particles. A rank thus computes the same accelerations as a single
+// kernel over the concatenated body lists, and its potential energy is its
+// share of the total. Every source load is a collective exchange, so all
+// ranks must step in lockstep.
+//
+// In compensated mode the Euler and RK4 policies add each position and
+// velocity increment with TwoSum, carrying the rounding error in
+// Body::pos_carry / Body::vel_carry. Test particles and the Wisdom–Holman
+// drift (which computes positions directly, not as increments) are not
+// compensated.
+//
+// Integrator policies share a small contract: on entry Body::acc (and the
+// TestParticles accelerations) hold the accelerations of the current state;
+// on exit bodies and test particles are advanced by 'n' substeps of size
+// 'h', the accelerations are refreshed for the final state and the total
+// potential energy of that state (bodies only) is returned.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "body.hpp"
+#include "execution.hpp"
+#include "force_law.hpp"
+#include "physics.hpp"
+#include "summation.hpp"
+#include "test_particles.hpp"
+#include "transport.hpp"
+
+namespace orbitsimlite {
+
+// Index of the body that anchors star-centred terms (the post-Newtonian
+// correction, the Wisdom–Holman Kepler drift): the first active star, or the
+// most massive active body when there is none. Returns bodies.size() when no
+// body is active.
+inline std::size_t central_body_index(const std::vector<Body>& bodies) {
+    std::size_t best = bodies.size();
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        if (bodies[i].is_test_particle) continue;
+        if (bodies[i].is_star) return i;
+        if (best == bodies.size() || bodies[i].mass > bodies[best].mass) best = i;
+    }
+    return best;
+}
+
+template <class ForceLaw, class Scalar = double>
+class ForceKernel {
+public:
+    using scalar_type = Scalar;
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // Tiling of 'fields': 256 sources take 8 KiB in double precision (x, y,
+    // G m, eps^2), so a source tile stays in L1 while every register block
+    // of the target tile passes over it.
+    static constexpr std::size_t kRegisterBlock = 4;
+    static constexpr std::size_t kTargetTile = 64;
+    static constexpr std::size_t kSourceTile = 256;
+
+    explicit ForceKernel(const ForceLaw& law = ForceLaw{}) : law_(law) {}
+
+    const ForceLaw& law() const { return law_; }
+
+    void set_extra_forces(const ExtraForces& extra) { extra_ = extra; }
+    const ExtraForces& extra_forces() const { return extra_; }
+
+    // Run per-target loops on 'options.pool' (nullptr: serially). In
+    // reproducible mode the per-target potential energy terms are combined
+    // by 'pairwise_sum' (O(log n) error growth); otherwise they are added
+    // in index order.
+    void set_execution(const ExecutionOptions& options) { exec_ = options; }
+    const ExecutionOptions& execution() const { return exec_; }
+
+    // Call 'fn(i)' for every i in [0, n), on the pool when there is one.
+    // Iterations must be independent.
+    template <class Fn>
+    void for_each_index(std::size_t n, Fn&& fn) const {
+        if (exec_.pool == nullptr || exec_.pool->size() == 1) {
+            for (std::size_t i = 0; i < n; ++i) fn(i);
+            return;
+        }
+        exec_.pool->parallel_for(n, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) fn(i);
+        });
+    }
+
+    // Snapshot the positions, G * m and squared softening lengths of the
+    // active bodies in 'bodies'. Subsequent calls to 'field_at' evaluate the
+    // field of this snapshot. Body 'exclude' (if any) is left out of the
+    // sources, as if it were passive.
+    void load_sources(const std::vector<Body>& bodies, double G, std::size_t exclude = npos) {
+        const std::size_t n = bodies.size();
+        x_.clear();
+        y_.clear();
+        gm_.clear();
+        e2_.clear();
+        source_of_.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            const Body& b = bodies[i];
+            if (b.is_test_particle || i == exclude) {
+                source_of_[i] = npos;
+                continue;
+            }
+            source_of_[i] = x_.size();
+            x_.push_back(static_cast<Scalar>(b.pos.x));
+            y_.push_back(static_cast<Scalar>(b.pos.y));
+            gm_.push_back(static_cast<Scalar>(G * b.mass));
+            e2_.push_back(static_cast<Scalar>(b.softening * b.softening));
+        }
+        if (exec_.transport != nullptr) {
+            gather_sources(bodies, G);
+        } else if (extra_.enabled()) {
+            load_central(bodies, G);
+        }
+    }
+
+    // Number of loaded (active) sources.
+    std::size_t source_count() const { return x_.size(); }
+
+    // Source index of body 'i' from the last 'load_sources', or npos when the
+    // body is passive.
+    std::size_t source_of(std::size_t i) const { return source_of_[i]; }
+
+    // Acceleration at 'p' due to all loaded sources except source 'skip'
+    // (pass 'npos' to include all of them). 'e2_self' is the squared
+    // softening length of the probe. The specific potential at 'p' is added
+    // to 'potential'.
+    Vec2 field_at(const Vec2& p, Scalar e2_self, std::size_t skip, double& potential) const {
+        const std::size_t n = x_.size();
+        const Scalar px = static_cast<Scalar>(p.x);
+        const Scalar py = static_cast<Scalar>(p.y);
+        Scalar ax = 0, ay = 0, phi = 0;
+
+        // Two plain ranges around 'skip' keep the inner loop branch-free.
+        const std::size_t split = (skip < n) ? skip : n;
+        accumulate(0, split, px, py, e2_self, ax, ay, phi);
+        accumulate((skip < n) ? skip + 1 : n, n, px, py, e2_self, ax, ay, phi);
+
+        potential += static_cast<double>(phi);
+        return Vec2{static_cast<double>(ax), static_cast<double>(ay)};
+    }
+
+    // Fields at 'count' probes in one tiled pass. 'probe(k, p, e2_self,
+    // skip)' describes probe k as for 'field_at'; 'sink(k, field,
+    // potential)' receives its result. Probes are processed in tiles, on the
+    // pool when there is one, so 'sink' must only touch state of probe k.
+    template <class Probe, class Sink>
+    void fields(std::size_t count, Probe&& probe, Sink&& sink) const {
+        const std::size_t tiles = (count + kTargetTile - 1) / kTargetTile;
+        for_each_index(tiles, [&](std::size_t tile) {
+            TargetTile t;
+            const std::size_t first = tile * kTargetTile;
+            t.count = std::min(kTargetTile, count - first);
+            for (std::size_t k = 0; k < t.count; ++k) {
+                Vec2 p;
+                Scalar e2 = 0;
+                probe(first + k, p, e2, t.skip[k]);
+                t.x[k] = static_cast<Scalar>(p.x);
+                t.y[k] = static_cast<Scalar>(p.y);
+                t.e2[k] = e2;
+                t.ax[k] = t.ay[k] = t.phi[k] = Scalar(0);
+            }
+            tile_pass(t);
+            for (std::size_t k = 0; k < t.count; ++k) {
+                sink(first + k, Vec2{static_cast<double>(t.ax[k]), static_cast<double>(t.ay[k])},
+                     static_cast<double>(t.phi[k]));
+            }
+        });
+    }
+
+    // Add the enabled ExtraForces for a probe at 'p' moving with 'v' to 'a'
+    // (as 'accel_at' does after the pairwise field).
+    void add_extra(Vec2& a, const Vec2& p, const Vec2& v, std::size_t skip) const {
+        if (extra_.enabled()) a += extra_at(p, v, skip);
+    }
+
+    // Total acceleration at position 'p' moving with velocity 'v': the
+    // pairwise field plus the enabled ExtraForces.
+    Vec2 accel_at(const Vec2& p, const Vec2& v, Scalar e2_self, std::size_t skip, double& potential) const {
+        Vec2 a = field_at(p, e2_self, skip, potential);
+        if (extra_.enabled()) a += extra_at(p, v, skip);
+        return a;
+    }
+
+    Vec2 accel_at(const Vec2& p, const Vec2& v, Scalar e2_self, std::size_t skip) const {
+        double unused = 0.0;
+        return accel_at(p, v, e2_self, skip, unused);
+    }
+
+    // Acceleration of body 'i' of the loaded set at an arbitrary stage
+    // position/velocity (used by multi-stage integrators).
+    Vec2 body_accel_at(const Body& b, std::size_t i, const Vec2& p, const Vec2& v) const {
+        return accel_at(p, v, static_cast<Scalar>(b.softening * b.softening), source_of_[i]);
+    }
+
+    // Full force pass: store the acceleration of every body in Body::acc and
+    // of every test particle, and return the total potential energy of the
+    // bodies.
+    double compute(std::vector<Body>& bodies, TestParticles& tracers, double G) {
+        load_sources(bodies, G);
+        // Active pairs are visited twice (once per partner) and weighted 1/2;
+        // a passive body only sees the active ones, so its term counts fully.
+        phi_.resize(bodies.size());
+        fields(
+            bodies.size(),
+            [&](std::size_t i, Vec2& p, Scalar& e2, std::size_t& skip) {
+                p = bodies[i].pos;
+                e2 = static_cast<Scalar>(bodies[i].softening * bodies[i].softening);
+                skip = source_of_[i];
+            },
+            [&](std::size_t i, Vec2 a, double phi) {
+                Body& b = bodies[i];
+                add_extra(a, b.pos, b.vel, source_of_[i]);
+                b.acc = a;
+                phi_[i] = (b.is_test_particle ? 2.0 : 1.0) * b.mass * phi;
+            });
+
+        double phi_sum = 0.0;
+        if (exec_.reproducible) {
+            phi_sum = pairwise_sum(phi_.data(), phi_.size());
+        } else {
+            for (double term : phi_) phi_sum += term;
+        }
+        compute_tracers(tracers);
+        return 0.5 * phi_sum;
+    }
+
+    // Accelerations of all test particles in the field of the loaded sources.
+    void compute_tracers(TestParticles& tracers) const {
+        fields(
+            tracers.size(),
+            [&](std::size_t k, Vec2& p, Scalar&, std::size_t& skip) {
+                p = tracers.pos(k);
+                skip = npos;
+            },
+            [&](std::size_t k, Vec2 a, double) {
+                add_extra(a, tracers.pos(k), tracers.vel(k), npos);
+                tracers.ax[k] = a.x;
+                tracers.ay[k] = a.y;
+            });
+    }
+
+    // Potential energy of 'bodies' without touching the kernel buffers.
+    // Pairs of two passive bodies do not interact.
+    double potential(const std::vector<Body>& bodies, double G) const {
+        double phi_sum = 0.0;
+        for (std::size_t i = 0; i < bodies.size(); ++i) {
+            const double ei2 = bodies[i].softening * bodies[i].softening;
+            for (std::size_t j = i + 1; j < bodies.size(); ++j) {
+                if (bodies[i].is_test_particle && bodies[j].is_test_particle) continue;
+                const Scalar dx = static_cast<Scalar>(bodies[j].pos.x - bodies[i].pos.x);
+                const Scalar dy = static_cast<Scalar>(bodies[j].pos.y - bodies[i].pos.y);
+                const double ej2 = bodies[j].softening * bodies[j].softening;
+                Scalar a, pot;
+                law_(dx * dx + dy * dy, static_cast<Scalar>(0.5 * (ei2 + ej2)), a, pot);
+                phi_sum -= G * bodies[i].mass * bodies[j].mass * static_cast<double>(pot);
+            }
+        }
+        return phi_sum;
+    }
+
+private:
+    struct TargetTile {
+        std::size_t count {0};
+        Scalar x[kTargetTile], y[kTargetTile], e2[kTargetTile];
+        std::size_t skip[kTargetTile];
+        Scalar ax[kTargetTile], ay[kTargetTile], phi[kTargetTile];
+    };
+
+    // Sources are visited tile by tile, so every target of 't' accumulates
+    // them in index order. A register block whose targets' own sources lie
+    // in the current tile takes the scalar path, split around each of them.
+    void tile_pass(TargetTile& t) const {
+        const std::size_t n = x_.size();
+        for (std::size_t s0 = 0; s0 < n; s0 += kSourceTile) {
+            const std::size_t s1 = std::min(n, s0 + kSourceTile);
+            for (std::size_t b0 = 0; b0 < t.count; b0 += kRegisterBlock) {
+                bool clean = b0 + kRegisterBlock <= t.count;
+                for (std::size_t b = 0; clean && b < kRegisterBlock; ++b) {
+                    clean = t.skip[b0 + b] < s0 || t.skip[b0 + b] >= s1;
+                }
+                if (clean) {
+                    accumulate_block(t, b0, s0, s1);
+                    continue;
+                }
+                for (std::size_t k = b0; k < std::min(t.count, b0 + kRegisterBlock); ++k) {
+                    const std::size_t split = (t.skip[k] >= s0 && t.skip[k] < s1) ? t.skip[k] : s1;
+                    accumulate(s0, split, t.x[k], t.y[k], t.e2[k], t.ax[k], t.ay[k], t.phi[k]);
+                    accumulate(std::min(split + 1, s1), s1, t.x[k], t.y[k], t.e2[k], t.ax[k], t.ay[k], t.phi[k]);
+                }
+            }
+        }
+    }
+
+    // kRegisterBlock targets against sources [begin, end): each source is
+    // loaded once and applied to all of them. The same expressions as in
+    // 'accumulate', so the bits match the scalar path.
+    void accumulate_block(TargetTile& t, std::size_t b0, std::size_t begin, std::size_t end) const {
+        constexpr std::size_t B = kRegisterBlock;
+        Scalar px[B], py[B], pe[B], ax[B], ay[B], phi[B];
+        for (std::size_t b = 0; b < B; ++b) {
+            px[b] = t.x[b0 + b];
+            py[b] = t.y[b0 + b];
+            pe[b] = t.e2[b0 + b];
+            ax[b] = t.ax[b0 + b];
+            ay[b] = t.ay[b0 + b];
+            phi[b] = t.phi[b0 + b];
+        }
+        for (std::size_t j = begin; j < end; ++j) {
+            const Scalar sx = x_[j], sy = y_[j], sgm = gm_[j], se2 = e2_[j];
+            for (std::size_t b = 0; b < B; ++b) {
+                const Scalar dx = sx - px[b];
+                const Scalar dy = sy - py[b];
+                const Scalar eps2 = Scalar(0.5) * (pe[b] + se2);
+                Scalar a, pot;
+                law_(dx * dx + dy * dy, eps2, a, pot);
+                ax[b] += sgm * (dx * a);
+                ay[b] += sgm * (dy * a);
+                phi[b] -= sgm * pot;
+            }
+        }
+        for (std::size_t b = 0; b < B; ++b) {
+            t.ax[b0 + b] = ax[b];
+            t.ay[b0 + b] = ay[b];
+            t.phi[b0 + b] = phi[b];
+        }
+    }
+
+    void accumulate(std::size_t begin, std::size_t end, Scalar px, Scalar py, Scalar e2_self,
+                    Scalar& ax, Scalar& ay, Scalar& phi) const {
+        for (std::size_t j = begin; j < end; ++j) {
+            const Scalar dx = x_[j] - px;
+            const Scalar dy = y_[j] - py;
+            // Pair softening: mean of the two squared softening lengths.
+            const Scalar eps2 = Scalar(0.5) * (e2_self + e2_[j]);
+            Scalar a, pot;
+            law_(dx * dx + dy * dy, eps2, a, pot);
+            // a = G * m * r / |r|^3 for the Newtonian law
+            ax += gm_[j] * (dx * a);
+            ay += gm_[j] * (dy * a);
+            phi -= gm_[j] * pot;
+        }
+    }
+
+    // Remember the body that anchors the post-Newtonian term. It may have
+    // been excluded from the sources (see 'load_sources').
+    void load_central(const std::vector<Body>& bodies, double G) {
+        const std::size_t best = central_body_index(bodies);
+        has_central_ = best < bodies.size();
+        if (!has_central_) return;
+        central_ = source_of_[best];
+        central_pos_ = bodies[best].pos;
+        central_vel_ = bodies[best].vel;
+        central_gm_ = G * bodies[best].mass;
+    }
+
+    // Summary of one rank's sources, followed by its x, y, G m and eps^2
+    // arrays. 'central' is 0 without active bodies, 2 when the rank's
+    // central body candidate is a star and 1 otherwise.
+    struct SourceBlock {
+        std::uint64_t count;
+        std::uint64_t central;
+        std::uint64_t central_source;
+        double gm, px, py, vx, vy;
+    };
+
+    // Exchange the loaded sources with the other ranks of the transport.
+    // The sources of all ranks are concatenated in rank order and
+    // 'source_of_' is shifted into that numbering, so every rank evaluates
+    // the same global sum. The post-Newtonian anchor is picked from the
+    // ranks' candidates by the rule of 'central_body_index' applied to the
+    // concatenation.
+    void gather_sources(const std::vector<Body>& bodies, double G) {
+        const std::size_t local = x_.size();
+        const std::size_t c = central_body_index(bodies);
+        SourceBlock head {};
+        head.count = local;
+        if (c < bodies.size()) {
+            head.central = bodies[c].is_star ? 2 : 1;
+            head.central_source = source_of_[c];
+            head.gm = G * bodies[c].mass;
+            head.px = bodies[c].pos.x;
+            head.py = bodies[c].pos.y;
+            head.vx = bodies[c].vel.x;
+            head.vy = bodies[c].vel.y;
+        }
+        const std::size_t array = local * sizeof(Scalar);
+        send_.resize(sizeof(SourceBlock) + 4 * array);
+        std::memcpy(send_.data(), &head, sizeof(SourceBlock));
+        unsigned char* out = send_.data() + sizeof(SourceBlock);
+        for (const std::vector<Scalar>* a : {&x_, &y_, &gm_, &e2_}) {
+            if (array > 0) std::memcpy(out, a->data(), array);
+            out += array;
+        }
+        exec_.transport->allgather(send_.data(), send_.size(), recv_, recv_offsets_);
+
+        const int me = exec_.transport->rank();
+        std::size_t total = 0, base = 0;
+        SourceBlock central {};
+        std::size_t central_base = 0;
+        for (int r = 0; r < exec_.transport->size(); ++r) {
+            SourceBlock block;
+            std::memcpy(&block, recv_.data() + recv_offsets_[static_cast<std::size_t>(r)], sizeof(SourceBlock));
+            if (r == me) base = total;
+            bool better = false;
+            if (block.central == 2) {
+                better = central.central != 2;
+            } else if (block.central == 1) {
+                better = central.central == 0 || (central.central == 1 && block.gm > central.gm);
+            }
+            if (better) {
+                central = block;
+                central_base = total;
+            }
+            total += block.count;
+        }
+        x_.resize(total);
+        y_.resize(total);
+        gm_.resize(total);
+        e2_.resize(total);
+        std::size_t at = 0;
+        for (int r = 0; r < exec_.transport->size(); ++r) {
+            const unsigned char* from = recv_.data() + recv_offsets_[static_cast<std::size_t>(r)];
+            SourceBlock block;
+            std::memcpy(&block, from, sizeof(SourceBlock));
+            const std::size_t n = block.count;
+            from += sizeof(SourceBlock);
+            for (std::vector<Scalar>* a : {&x_, &y_, &gm_, &e2_}) {
+                if (n > 0) std::memcpy(a->data() + at, from, n * sizeof(Scalar));
+                from += n * sizeof(Scalar);
+            }
+            at += n;
+        }
+        for (std::size_t& s : source_of_) {
+            if (s != npos) s += base;
+        }
+
+        has_central_ = central.central != 0;
+        if (!has_central_) return;
+        central_ = (central.central_source == npos) ? npos : central_base + central.central_source;
+        central_pos_ = Vec2{central.px, central.py};
+        central_vel_ = Vec2{central.vx, central.vy};
+        central_gm_ = central.gm;
+    }
+
+    Vec2 extra_at(const Vec2& p, const Vec2& v, std::size_t self) const {
+        Vec2 a = -extra_.drag_rate * v;
+        if (extra_.speed_of_light > 0.0 && has_central_ && (central_ == npos || self != central_)) {
+            const Vec2 r = p - central_pos_;
+            const Vec2 u = v - central_vel_;
+            const double r2 = r.length_squared();
+            if (r2 > 0.0) {
+                const double inv_r = 1.0 / std::sqrt(r2);
+                const double c2 = extra_.speed_of_light * extra_.speed_of_light;
+                const double k = central_gm_ * inv_r * inv_r * inv_r / c2;
+                a += k * ((4.0 * central_gm_ * inv_r - u.length_squared()) * r +
+                          4.0 * Vec2::dot(r, u) * u);
+            }
+        }
+        return a;
+    }
+
+    ForceLaw law_;
+    ExtraForces extra_;
+    std::vector<Scalar> x_;
+    std::vector<Scalar> y_;
+    std::vector<Scalar> gm_;
+    std::vector<Scalar> e2_;
+    std::vector<std::size_t> source_of_;
+    std::vector<double> phi_;
+    // Buffers of 'gather_sources'.
+    std::vector<unsigned char> send_;
+    std::vector<unsigned char> recv_;
+    std::vector<std::size_t> recv_offsets_;
+
+    ExecutionOptions exec_;
+
+    bool has_central_ {false};
+    std::size_t central_ {npos};
+    Vec2 central_pos_;
+    Vec2 central_vel_;
+    double central_gm_ {0.0};
+};
+
+// Symplectic Euler (kick, then drift). Accelerations of the new positions are
+// computed at the end of each substep and reused by the next one, so each
+// substep costs exactly one force pass.
+struct EulerIntegration {
+    template <class Kernel>
+    static double advance(std::vector<Body>& bodies, TestParticles& tracers, Kernel& kernel,
+                          double G, double h, int n) {
+        const bool compensated = kernel.execution().compensated;
+        double potential = 0.0;
+        for (int s = 0; s < n; ++s) {
+            for (auto& b : bodies) {
+                if (compensated) {
+                    compensated_add(b.vel, b.vel_carry, b.acc * h);
+                    compensated_add(b.pos, b.pos_carry, b.vel * h);
+                } else {
+                    b.vel += b.acc * h;
+                    b.pos += b.vel * h;
+                }
+            }
+            // Test particles: the same update as flat array sweeps.
+            const std::size_t m = tracers.size();
+            for (std::size_t k = 0; k < m; ++k) {
+                tracers.vx[k] += tracers.ax[k] * h;
+                tracers.vy[k] += tracers.ay[k] * h;
+                tracers.x[k] += tracers.vx[k] * h;
+                tracers.y[k] += tracers.vy[k] * h;
+            }
+            potential = kernel.compute(bodies, tracers, G);
+        }
+        return potential;
+    }
+};
+
+// The educational RK4 scheme of Physics::step_rk4: each body is integrated
+// with the other bodies frozen at the start of the substep. Since no target
+// sees another target's stages, stage k of every body and test particle is
+// evaluated in one tiled pass ('ForceKernel::fields'); targets are taken in
+// chunks of kChunk to bound the stage storage. The first stage of a step is
+// the state the accelerations were cached for, so it needs no pass: a step
+// of n substeps costs 4 n passes, the last one being the final 'compute'.
+struct RK4Integration {
+    static constexpr std::size_t kChunk = 4096;
+
+    template <class Kernel>
+    static double advance(std::vector<Body>& bodies, TestParticles& tracers, Kernel& kernel,
+                          double G, double h, int n) {
+        using Scalar = typename Kernel::scalar_type;
+        const std::size_t count = bodies.size();
+        const std::size_t total = count + tracers.size();
+        const bool compensated = kernel.execution().compensated;
+        std::vector<Vec2> next_pos(count);
+        std::vector<Vec2> next_vel(count);
+        Stages st;
+
+        for (int s = 0; s < n; ++s) {
+            kernel.load_sources(bodies, G);
+            for (std::size_t c0 = 0; c0 < total; c0 += kChunk) {
+                const std::size_t len = std::min(kChunk, total - c0);
+                st.resize(len);
+                // Targets [0, count) are bodies, the rest test particles.
+                auto skip_of = [&](std::size_t k) { return (k < count) ? kernel.source_of(k) : Kernel::npos; };
+                for (std::size_t q = 0; q < len; ++q) {
+                    const std::size_t k = c0 + q;
+                    st.x0[q] = (k < count) ? bodies[k].pos : tracers.pos(k - count);
+                    st.v0[q] = (k < count) ? bodies[k].vel : tracers.vel(k - count);
+                }
+
+                for (int stage = 0; stage < 4; ++stage) {
+                    // Stage position and velocity: x0 + c h k_x and v0 + c h k_v
+                    // of the previous stage (x0, v0 for the first).
+                    if (stage == 0) {
+                        for (std::size_t q = 0; q < len; ++q) {
+                            st.pos[q] = st.x0[q];
+                            st.kx[q] = st.v0[q];
+                        }
+                    } else {
+                        const double ch = (stage == 3) ? h : 0.5 * h;
+                        for (std::size_t q = 0; q < len; ++q) {
+                            st.pos[q] = st.x0[q] + ch * st.kx[q];
+                            st.kx[q] = st.v0[q] + ch * st.kv[q];
+                        }
+                    }
+                    if (s == 0 && stage == 0) {
+                        // The cached accelerations are the first k_v of the
+                        // step: the same pass as 'compute' left them.
+                        for (std::size_t q = 0; q < len; ++q) {
+                            const std::size_t k = c0 + q;
+                            st.kv[q] = (k < count) ? bodies[k].acc
+                                                   : Vec2{tracers.ax[k - count], tracers.ay[k - count]};
+                        }
+                    } else {
+                        kernel.fields(
+                            len,
+                            [&](std::size_t q, Vec2& p, Scalar& e2, std::size_t& skip) {
+                                const std::size_t k = c0 + q;
+                                p = st.pos[q];
+                                e2 = (k < count) ? static_cast<Scalar>(bodies[k].softening * bodies[k].softening)
+                                                 : Scalar(0);
+                                skip = skip_of(k);
+                            },
+                            [&](std::size_t q, Vec2 a, double) {
+                                kernel.add_extra(a, st.pos[q], st.kx[q], skip_of(c0 + q));
+                                st.kv[q] = a;
+                            });
+                    }
+                    // dv = (h/6) (k1_v + 2 k2_v + 2 k3_v + k4_v), likewise dx.
+                    for (std::size_t q = 0; q < len; ++q) {
+                        if (stage == 0) {
+                            st.sum_x[q] = st.kx[q];
+                            st.sum_v[q] = st.kv[q];
+                        } else if (stage == 3) {
+                            st.sum_x[q] = st.sum_x[q] + st.kx[q];
+                            st.sum_v[q] = st.sum_v[q] + st.kv[q];
+                        } else {
+                            st.sum_x[q] = st.sum_x[q] + 2.0 * st.kx[q];
+                            st.sum_v[q] = st.sum_v[q] + 2.0 * st.kv[q];
+                        }
+                    }
+                }
+
+                for (std::size_t q = 0; q < len; ++q) {
+                    const std::size_t k = c0 + q;
+                    const Vec2 dx = (h / 6.0) * st.sum_x[q];
+                    const Vec2 dv = (h / 6.0) * st.sum_v[q];
+                    if (k < count) {
+                        Body& b = bodies[k];
+                        next_pos[k] = b.pos;
+                        next_vel[k] = b.vel;
+                        if (compensated) {
+                            compensated_add(next_pos[k], b.pos_carry, dx);
+                            compensated_add(next_vel[k], b.vel_carry, dv);
+                        } else {
+                            next_pos[k] += dx;
+                            next_vel[k] += dv;
+                        }
+                    } else {
+                        // Test particles do not act on anything: update in place.
+                        const Vec2 p = st.x0[q] + dx;
+                        const Vec2 v = st.v0[q] + dv;
+                        tracers.x[k - count] = p.x;
+                        tracers.y[k - count] = p.y;
+                        tracers.vx[k - count] = v.x;
+                        tracers.vy[k - count] = v.y;
+                    }
+                }
+            }
+            for (std::size_t i = 0; i < count; ++i) {
+                bodies[i].pos = next_pos[i];
+                bodies[i].vel = next_vel[i];
+            }
+        }
+        // Refresh accelerations and potential for the final state once.
+        return kernel.compute(bodies, tracers, G);
+    }
+
+private:
+    // Per-target state of one chunk: start point, current stage position,
+    // k_x (stage velocity), k_v (stage acceleration) and the weighted sums.
+    struct Stages {
+        std::vector<Vec2> x0, v0, pos, kx, kv, sum_x, sum_v;
+
+        void resize(std::size_t len) {
+            for (auto* v : {&x0, &v0, &pos, &kx, &kv, &sum_x, &sum_v}) v->resize(len);
+        }
+    };
+};
+
+// Wisdom–Holman mapping in democratic heliocentric coordinates (Duncan,
+// Levison & Lee 1998). The Hamiltonian is split into
+//  - the Kepler motion of every body around the central star (solved exactly
+//    by Physics::kepler_drift),
+//  - the mutual interactions of the non-central bodies (a kick), and
+//  - the motion of the star around the barycentre (a linear "jump"),
+// composed as kick/2, jump/2, drift, jump/2, kick/2. Because the dominant
+// star–planet term is integrated analytically, the error scales with the
+// planet/star mass ratio and long steps (a few percent of the shortest
+// orbital period) stay accurate and symplectic. Kicks of consecutive
+// substeps are merged, so a substep costs one interaction pass.
+//
+// The central body is chosen by 'central_body_index'. Passive bodies and
+// test particles are massless here: they are kicked and drifted but do not
+// enter the barycentre or the jump. ExtraForces are applied in the kicks
+// (velocities there are barycentric; the post-Newtonian term uses the
+// velocity relative to the star). Softening only affects the interactions
+// between non-central bodies. Close encounters between planets or with the
+// star are not regularised; use RK4 for such systems. The scheme needs every
+// body in one place, so it cannot run under a transport.
+struct WisdomHolmanIntegration {
+    template <class Kernel>
+    static double advance(std::vector<Body>& bodies, TestParticles& tracers, Kernel& kernel,
+                          double G, double h, int n) {
+        const std::size_t count = bodies.size();
+        const std::size_t c = central_body_index(bodies);
+        if (c == count || bodies[c].mass <= 0.0) {
+            // Nothing to orbit: fall back to plain kick-drift steps.
+            return EulerIntegration::advance(bodies, tracers, kernel, G, h, n);
+        }
+
+        const double m0 = bodies[c].mass;
+        const double mu = G * m0;
+
+        // To democratic heliocentric coordinates: positions relative to the
+        // star, velocities relative to the barycentre.
+        double mtot = 0.0;
+        Vec2 mr, mv;
+        for (const auto& b : bodies) {
+            if (b.is_test_particle) continue;
+            mtot += b.mass;
+            mr += b.mass * b.pos;
+            mv += b.mass * b.vel;
+        }
+        const Vec2 cm_pos = mr / mtot;
+        const Vec2 cm_vel = mv / mtot;
+        const Vec2 star_pos = bodies[c].pos;
+        for (auto& b : bodies) {
+            b.pos -= star_pos;
+            b.vel -= cm_vel;
+        }
+        for (std::size_t k = 0; k < tracers.size(); ++k) {
+            tracers.x[k] -= star_pos.x;
+            tracers.y[k] -= star_pos.y;
+            tracers.vx[k] -= cm_vel.x;
+            tracers.vy[k] -= cm_vel.y;
+        }
+
+        kick(bodies, tracers, kernel, G, c, 0.5 * h);
+        for (int s = 0; s < n; ++s) {
+            jump(bodies, tracers, c, 0.5 * h);
+            for (std::size_t i = 0; i < count; ++i) {
+                if (i != c) Physics::kepler_drift(bodies[i].pos, bodies[i].vel, mu, h);
+            }
+            for (std::size_t k = 0; k < tracers.size(); ++k) {
+                Vec2 p = tracers.pos(k);
+                Vec2 v = tracers.vel(k);
+                Physics::kepler_drift(p, v, mu, h);
+                tracers.x[k] = p.x;
+                tracers.y[k] = p.y;
+                tracers.vx[k] = v.x;
+                tracers.vy[k] = v.y;
+            }
+            jump(bodies, tracers, c, 0.5 * h);
+            kick(bodies, tracers, kernel, G, c, (s + 1 < n) ? h : 0.5 * h);
+        }
+
+        // Back to inertial coordinates. The barycentre moves uniformly; the
+        // star sits where the barycentre condition puts it.
+        Vec2 mq;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (i != c && !bodies[i].is_test_particle) mq += bodies[i].mass * bodies[i].pos;
+        }
+        const Vec2 new_star_pos = cm_pos + cm_vel * (h * n) - mq / mtot;
+        const Vec2 star_vel = star_velocity(bodies, c);
+        for (std::size_t i = 0; i < count; ++i) {
+            if (i == c) continue;
+            bodies[i].pos += new_star_pos;
+            bodies[i].vel += cm_vel;
+        }
+        bodies[c].pos = new_star_pos;
+        bodies[c].vel = star_vel + cm_vel;
+        for (std::size_t k = 0; k < tracers.size(); ++k) {
+            tracers.x[k] += new_star_pos.x;
+            tracers.y[k] += new_star_pos.y;
+            tracers.vx[k] += cm_vel.x;
+            tracers.vy[k] += cm_vel.y;
+        }
+
+        return kernel.compute(bodies, tracers, G);
+    }
+
+private:
+    // Barycentric velocity of the star implied by zero total momentum.
+    static Vec2 star_velocity(const std::vector<Body>& bodies, std::size_t c) {
+        Vec2 p;
+        for (std::size_t i = 0; i < bodies.size(); ++i) {
+            if (i != c && !bodies[i].is_test_particle) p += bodies[i].mass * bodies[i].vel;
+        }
+        return -1.0 * p / bodies[c].mass;
+    }
+
+    // Interaction kick: the star is excluded from the sources; it stays at
+    // the origin with its barycentric velocity so that the post-Newtonian
+    // term sees heliocentric relative motion.
+    template <class Kernel>
+    static void kick(std::vector<Body>& bodies, TestParticles& tracers, Kernel& kernel,
+                     double G, std::size_t c, double tau) {
+        bodies[c].pos = Vec2{};
+        bodies[c].vel = star_velocity(bodies, c);
+        using Scalar = typename Kernel::scalar_type;
+        kernel.load_sources(bodies, G, c);
+        kernel.fields(
+            bodies.size(),
+            [&](std::size_t i, Vec2& p, Scalar& e2, std::size_t& skip) {
+                p = bodies[i].pos;
+                e2 = static_cast<Scalar>(bodies[i].softening * bodies[i].softening);
+                skip = kernel.source_of(i);
+            },
+            [&](std::size_t i, Vec2 a, double) {
+                if (i == c) return;
+                Body& b = bodies[i];
+                kernel.add_extra(a, b.pos, b.vel, kernel.source_of(i));
+                b.vel += tau * a;
+            });
+        kernel.fields(
+            tracers.size(),
+            [&](std::size_t k, Vec2& p, Scalar&, std::size_t& skip) {
+                p = tracers.pos(k);
+                skip = Kernel::npos;
+            },
+            [&](std::size_t k, Vec2 a, double) {
+                kernel.add_extra(a, tracers.pos(k), tracers.vel(k), Kernel::npos);
+                tracers.vx[k] += tau * a.x;
+                tracers.vy[k] += tau * a.y;
+            });
+    }
+
+    // Jump: every body is shifted by the star's barycentric displacement,
+    // tau * (sum of planet momenta) / m_star.
+    static void jump(std::vector<Body>& bodies, TestParticles& tracers, std::size_t c, double tau) {
+        const Vec2 shift = -tau * star_velocity(bodies, c);
+        for (std::size_t i = 0; i < bodies.size(); ++i) {
+            if (i != c) bodies[i].pos += shift;
+        }
+        for (std::size_t k = 0; k < tracers.size(); ++k) {
+            tracers.x[k] += shift.x;
+            tracers.y[k] += shift.y;
+        }
+    }
+};
+
+template <class IntegratorPolicy, class ForceLaw = NewtonianGravity, class Scalar = double>
+class Pipeline {
+public:
+    using integrator_type = IntegratorPolicy;
+    using force_law_type = ForceLaw;
+    using scalar_type = Scalar;
+
+    explicit Pipeline(const ForceLaw& law = ForceLaw{}) : kernel_(law) {}
+
+    // Compute accelerations for the current state; returns the potential energy.
+    double refresh(std::vector<Body>& bodies, TestParticles& tracers, double G) {
+        return kernel_.compute(bodies, tracers, G);
+    }
+
+    // Advance by 'n' substeps of size 'h'; returns the final potential energy.
+    double advance(std::vector<Body>& bodies, TestParticles& tracers, double G, double h, int n) {
+        return IntegratorPolicy::advance(bodies, tracers, kernel_, G, h, n);
+    }
+
+    double potential(const std::vector<Body>& bodies, double G) const {
+        return kernel_.potential(bodies, G);
+    }
+
+    // Gravitational field of 'sources' (without body 'exclude') at each of
+    // 'points'. ExtraForces are not included.
+    void field(const std::vector<Body>& sources, double G, std::size_t exclude,
+               const std::vector<Vec2>& points, std::vector<Vec2>& out) {
+        kernel_.load_sources(sources, G, exclude);
+        out.resize(points.size());
+        kernel_.fields(
+            points.size(),
+            [&](std::size_t k, Vec2& p, Scalar&, std::size_t& skip) {
+                p = points[k];
+                skip = ForceKernel<ForceLaw, Scalar>::npos;
+            },
+            [&](std::size_t k, const Vec2& a, double) { out[k] = a; });
+    }
+
+    const ForceLaw& law() const { return kernel_.law(); }
+
+    void set_extra_forces(const ExtraForces& extra) { kernel_.set_extra_forces(extra); }
+    const ExtraForces& extra_forces() const { return kernel_.extra_forces(); }
+
+    void set_execution(const ExecutionOptions& options) { kernel_.set_execution(options); }
+
+private:
+    ForceKernel<ForceLaw, Scalar> kernel_;
+};
+
+} // namespace orbitsimlite
@@ -1,10 +1,32 @@
 // OrbitSimLite - SFML-based renderer
 //
 // Responsible for visualising the current Simulator state:
-//  - fixed world-to-screen mapping (metres -> pixels)
+//  - world-to-screen mapping (metres -> pixels) with interactive zoom/pan
 //  - drawing bodies as circles with fading trails
 //  - basic interactive controls (pause, reset, collision handling)
 //  - continuous export of the current state to a JSON file
+//
+// Trails are kept in world space, so zooming or panning never invalidates
+// them; the world-to-screen transform is applied lazily while building the
+// vertex arrays, and only to bodies, trail segments and test particles that
+// intersect the visible region. Frame cost therefore follows what is on
+// screen rather than the total number of bodies and trail points.
+//
+// Dense fields (tens of thousands of bodies or test particles) switch to a
+// level-of-detail path: stars and named bodies stay crisp circles with
+// trails, every other body becomes a single point or quad in one batch, and
+// screen cells crowded beyond a threshold are aggregated into a heatmap
+// texture that is updated incrementally (see DensityMap).
+//
+// When the simulator advances one step per frame, trails are smoothed with
+// the simulator's dense output: 'set_trail_subdivisions(n)' adds n - 1
+// interpolated points inside every step, so long steps draw curves instead
+// of polygons at no extra force evaluations.
+//
+// render_offscreen draws the same scene into an sf::RenderTexture without
+// opening a window and writes every frame to disk as an image sequence.
+// Encoding and file output run on a TaskQueue, so they overlap with
+// simulating and drawing the following frames.
 #pragma once
 
 #include <deque>
@@ -14,30 +36,137 @@
 
 #include <SFML/Graphics.hpp>
 
+#include "density_map.hpp"
 #include "simulator.hpp"
+#include "telemetry.hpp"
 #include "utils.hpp"
 
 namespace orbitsimlite {
 
+// Settings for Renderer::render_offscreen. Frames are written as
+// <directory>/<prefix><index, 6 digits>.<png|ppm>.
+struct CaptureOptions {
+    enum class Format {
+        Png, // compressed, via sf::Image
+        Ppm  // binary PPM (P6): no compression, cheapest to encode
+    };
+
+    std::string directory {"frames"};
+    std::string prefix {"frame_"};
+    Format format {Format::Png};
+    std::size_t frames {1000};
+    int steps_per_frame {1};  // simulation steps between captured frames
+    unsigned workers {0};     // encoding threads; 0 uses all hardware threads
+    std::size_t max_pending {0}; // frames in flight; 0 allows two per worker
+};
+
 class Renderer {
 public:
     Renderer(unsigned width = 1000, unsigned height = 800, double meters_to_pixels = 2e-9);
 
     // Runs the visualization loop. Blocks until window close.
-    void run(Simulator& sim);
+    // Accepts the Simulator facade as well as any BasicSimulator.
+    void run(SimulatorBase& sim);
+
+    // Renders 'options.frames' frames without a window, advancing 'sim' by
+    // 'options.steps_per_frame' steps before each frame. Collisions between
+    // regular bodies remove the lighter one instead of pausing. Returns the
+    // number of frames written successfully (0 if no render texture could
+    // be created, e.g. without an OpenGL context).
+    std::size_t render_offscreen(SimulatorBase& sim, const CaptureOptions& options);
+
+    // Level of detail: active once bodies + test particles reach
+    // 'min_items'. Cells of kDensityCellPx pixels holding at least
+    // 'density_threshold' items are drawn as heatmap pixels.
+    void set_level_of_detail(bool enabled, std::size_t min_items = 5000, unsigned density_threshold = 8);
+
+    static constexpr unsigned kDensityCellPx = 4;
+
+    // Trail points per simulation step (1 disables interpolation). While
+    // 'run' or 'render_offscreen' is active the simulator's dense output is
+    // switched on; its previous setting is restored afterwards.
+    void set_trail_subdivisions(int n);
+
+    // State export. The JSON snapshot is rewritten every frame unless
+    // 'filename' is empty; a started TelemetryServer (not owned) is handed
+    // the state every frame and applies its own rate limit.
+    void set_state_file(const std::string& filename);
+    void set_telemetry(TelemetryServer* server);
 
 private:
+    // Axis-aligned rectangle in world coordinates (metres).
+    struct WorldRect {
+        double min_x, min_y, max_x, max_y;
+
+        bool contains(const Vec2& p) const {
+            return p.x >= min_x && p.x <= max_x && p.y >= min_y && p.y <= max_y;
+        }
+        bool overlaps(double x0, double y0, double x1, double y1) const {
+            return x1 >= min_x && x0 <= max_x && y1 >= min_y && y0 <= max_y;
+        }
+    };
+
     sf::Vector2f world_to_screen(const Vec2& p) const;
+    Vec2 screen_to_world(float sx, float sy) const;
+
+    // World region currently on screen, grown by 'margin_px' pixels.
+    WorldRect visible_world(double margin_px) const;
+
+    // Zoom by 'factor' keeping the world point under screen (sx, sy) fixed.
+    void zoom_at(float sx, float sy, double factor);
+    void pan_pixels(float dx, float dy);
+    void reset_view();
+
+    // Mouse wheel / drag and keyboard zoom/pan. Returns true when consumed.
+    bool handle_view_event(const sf::Event& event);
+
+    // Stars and named bodies are always drawn in full detail.
+    static bool is_crisp(const Body& b) { return b.is_star || b.has_name(); }
+    bool lod_active(const SimulatorBase& sim) const;
+    void update_density(const SimulatorBase& sim);
+    int density_cell(const sf::Vector2f& screen) const;
+
+    void remove_body(SimulatorBase& sim, std::size_t idx);
+    void handle_collisions(SimulatorBase& sim, bool interactive);
+
     void rebuild_trails(std::size_t count);
-    void write_state_json(const Simulator& sim, const std::string& filename) const;
+    // Match trails to the simulator's current body order by handle, so they
+    // survive spatial reordering and bodies added or removed elsewhere.
+    void sync_trails(const SimulatorBase& sim);
+    void update_trails(const SimulatorBase& sim);
+    void draw_scene(sf::RenderTarget& target, const SimulatorBase& sim);
+    void write_state_json(const SimulatorBase& sim, const std::string& filename) const;
 
     unsigned width_;
     unsigned height_;
-    double scale_; // meters to pixels
+    double base_scale_; // meters to pixels at zoom 1; also used for collisions
+    double scale_;      // current meters to pixels
+    Vec2 center_;       // world point shown at the screen centre
     bool paused_ {false};
-    const std::size_t max_trail_ = 200;
+    const std::size_t max_trail_ = 200; // steps shown per trail
+    int trail_subdivisions_ {4};
+    double trail_time_ {0.0};           // simulation time of the newest trail points
+    std::vector<Body> trail_state_;     // scratch for interpolated states
+
+    // Mouse drag panning
+    bool dragging_ {false};
+    int drag_x_ {0};
+    int drag_y_ {0};
+
+    std::vector<std::deque<Vec2>> trails_; // world-space positions
+    std::vector<BodyHandle> trail_owners_;  // body of each trail
 
-    std::vector<std::deque<sf::Vector2f>> trails_;
+    // Level of detail
+    bool lod_enabled_ {true};
+    std::size_t lod_min_items_ {5000};
+    unsigned lod_density_threshold_ {8};
+    DensityMap density_;
+    sf::Texture heat_texture_;
+    std::vector<sf::Uint8> heat_upload_;
+    double density_scale_ {0.0}; // view the density map was binned for
+    Vec2 density_center_;
+    unsigned density_width_ {0};
+    unsigned density_height_ {0};
 
     // Collision handling state
     bool collision_active_ {false};
@@ -46,6 +175,7 @@ private:
 
     // JSON state output file (overwritten each frame)
     std::string state_filename_ {"bodies.json"};
+    TelemetryServer* telemetry_ {nullptr};
 };
 
 } // namespace orbitsimlite
@@ -1,89 +1,183 @@
 // OrbitSimLite - Simulator
 //
-// The Simulator owns the collection of bodies and is responsible for:
-//  - storing global simulation parameters (G, dt, integrator, substeps)
-//  - advancing the system in time via Physics integrators
-//  - exposing read/write access to the current bodies
+// The Simulator is the runtime-configurable front-end used by the demos and
+// the renderer. It owns the collection of bodies (via SimulatorBase) and adds:
+//  - a runtime choice of integration scheme ('Integrator')
+//  - a runtime choice of force law (Newtonian, Plummer or spline softening)
+//  - optional drag / post-Newtonian terms
+//  - hierarchical integration of tight pairs (planet-moon, binaries) and
+//    regularisation of close encounters
+//
+// Internally each (integrator, force law) combination is a fully specialised
+// Pipeline (see pipeline.hpp) hidden behind a small type-erased interface.
+// Switching integrator or softening swaps the pipeline; the dispatch happens
+// once per 'step()', so the pairwise loop is the same code BasicSimulator
+// runs.
 //
 // It deliberately stays agnostic of any rendering or input concerns.
 #pragma once
 
+#include <memory>
 #include <vector>
 #include "body.hpp"
+#include "force_law.hpp"
 #include "physics.hpp"
+#include "simulator_base.hpp"
 
 namespace orbitsimlite {
 
-enum class Integrator { Euler, RK4 };
+// Euler and RK4 work for any configuration. WisdomHolman is a symplectic
+// Kepler-drift scheme for systems dominated by one central star (see
+// WisdomHolmanIntegration): it tolerates much longer steps there, but is
+// not suited to close encounters.
+enum class Integrator { Euler, RK4, WisdomHolman };
+
+// Shape of the global softening applied when 'set_softening' is non-zero.
+enum class SofteningKernel { Plummer, Spline };
+
+// A tight pair integrated in relative (Jacobi) coordinates; see
+// Simulator::add_subsystem. 'inner_substeps' is the number of steps of the
+// relative orbit per outer substep.
+struct Subsystem {
+    BodyHandle primary;
+    BodyHandle secondary;
+    int inner_substeps {8};
+};
+
+namespace detail {
+
+// Type-erased pipeline used by the Simulator facade.
+class AnyPipeline {
+public:
+    virtual ~AnyPipeline() = default;
+    virtual double refresh(std::vector<Body>& bodies, TestParticles& tracers, double G) = 0;
+    virtual double advance(std::vector<Body>& bodies, TestParticles& tracers, double G, double h, int n) = 0;
+    virtual double potential(const std::vector<Body>& bodies, double G) const = 0;
+    virtual void field(const std::vector<Body>& sources, double G, std::size_t exclude,
+                       const std::vector<Vec2>& points, std::vector<Vec2>& out) = 0;
+    virtual void set_extra_forces(const ExtraForces& extra) = 0;
+    virtual void set_execution(const ExecutionOptions& options) = 0;
+};
+
+} // namespace detail
 
-class Simulator {
+class Simulator : public SimulatorBase {
 public:
     // Construct a simulator with given gravitational constant G (in SI units),
     // base timestep dt (seconds) and integrator type. The actual internal step
     // can be further refined using 'set_substeps'.
     explicit Simulator(double G = Physics::DefaultG, double dt = 1.0, Integrator integrator = Integrator::RK4);
 
-    // Body management -------------------------------------------------------
-
-    // Append a new body to the simulation.
-    void add_body(const Body& b);
-
-    // Replace the entire body set with 'bs'.
-    void set_bodies(const std::vector<Body>& bs);
-
-    // Remove all bodies.
-    void clear();
-
-    // Time step (seconds) ---------------------------------------------------
-
-    void set_dt(double dt_);
-    double get_dt() const;
+    Simulator(const Simulator& other);
+    Simulator& operator=(const Simulator& other);
 
-    // Choose the integration scheme used in 'step()'.
-    void set_integrator(Integrator i);
+    // Choose the integration scheme used in 'step()'. Returns false (and
+    // keeps the current one) for WisdomHolman while a transport is set.
+    bool set_integrator(Integrator i);
     Integrator get_integrator() const;
 
-    // Gravitational constant (SI units) ------------------------------------
-
-    void set_gravity(double G_);
-    double get_gravity() const;
-
-    // Substepping -----------------------------------------------------------
+    // Global softening length (metres). Zero selects plain Newtonian
+    // gravity, which is the default. Per-body lengths (Body::softening) are
+    // honoured by every law and combined in quadrature with the global one.
+    // Changing either setting invalidates the cached accelerations and the
+    // energy drift reference.
+    void set_softening(double eps);
+    double get_softening() const;
+    void set_softening_kernel(SofteningKernel kernel);
+    SofteningKernel get_softening_kernel() const;
+
+    // Optional drag / post-Newtonian terms (see ExtraForces). These are not
+    // conservative, so an armed energy drift alert will eventually fire.
+    void set_extra_forces(const ExtraForces& extra);
+    const ExtraForces& get_extra_forces() const;
+
+    // Hierarchical subsystems ------------------------------------------------
     //
-    // Each call to 'step()' advances the simulation by dt_. Internally this
-    // can be subdivided into 'n' smaller steps of size dt_/n to improve
-    // stability for tight orbits (e.g., Earth–Moon) without changing the
-    // externally visible timestep.
-    void set_substeps(int n);
-    int get_substeps() const;
-
-    // Simulation time -------------------------------------------------------
-
-    // Return the accumulated simulation time in seconds since construction
-    // or the last call to 'reset_time()'.
-    double get_time() const;
-
-    // Reset the accumulated simulation time to zero. Does not modify bodies.
-    void reset_time();
-
-    // Advance the whole system by one external step of size dt_. Depending
-    // on the configured substeps, this may internally perform multiple
-    // smaller integration steps.
-    void step();
-
-    // Access the current bodies. The non-const accessor is intended for
-    // components such as the renderer that need to remove bodies (e.g. on
-    // collision). External users should prefer the const view where possible.
-    const std::vector<Body>& get_bodies() const;
-    std::vector<Body>& access_bodies();
+    // A moon or close binary companion forces every body to substep at the
+    // pair's orbital timescale. A declared subsystem is instead split into
+    // its centre of mass, which takes part in the outer integration as one
+    // body with the combined mass, and the relative orbit of the pair, which
+    // is advanced by an exact Kepler drift in 'inner_substeps' pieces per
+    // outer substep, kicked by the tidal field of the other bodies. The outer
+    // step then only has to resolve the motion of the centres of mass.
+    //
+    // Approximations: the rest of the system sees the pair as a point mass
+    // at its barycentre (no back-reaction of the tidal term), the mutual
+    // attraction of the pair is unsoftened Newtonian gravity, and
+    // ExtraForces act on the centre of mass only. A body belongs to at most
+    // one subsystem. Subsystems whose bodies were removed are dropped.
+    //
+    // 'add_subsystem' returns false for stale or identical handles, passive
+    // bodies, bodies already in a subsystem and while a transport is set
+    // (SimulatorBase::set_transport). 'detect_subsystems' declares
+    // a subsystem for every Body::is_satellite body inside the Hill sphere of
+    // a heavier non-central body (with respect to the central body, see
+    // 'central_body_index') and bound to it, and returns how many it added.
+    bool add_subsystem(BodyHandle primary, BodyHandle secondary, int inner_substeps = 8);
+    std::size_t detect_subsystems(int inner_substeps = 8);
+    void clear_subsystems();
+    const std::vector<Subsystem>& get_subsystems() const;
+
+    // Close-encounter regularisation -----------------------------------------
+    //
+    // Near-collisions make the pairwise force grow like 1/r^2, so a fixed
+    // step either needs a huge number of substeps or lets the pair gain
+    // energy and fly apart. With a positive 'distance', any two massive
+    // bodies that come closer than that during a step, extrapolating their
+    // relative motion in a straight line from its start (closest pairs first,
+    // each body in at most one pair, declared subsystems excluded) are
+    // treated as a subsystem for that step: their relative motion is
+    // advanced by Physics::kepler_drift, the closed-form solution of the
+    // regularised (Levi-Civita) two-body problem, which passes through the
+    // pericentre exactly at a cost independent of the separation. The
+    // others perturb the pair through tidal kicks in 'inner_substeps'
+    // pieces per substep. Pick 'distance' well below the typical
+    // separation of the system so that the rest of it may see a pair as a
+    // point mass; zero (the default) disables the scheme. Enabling it
+    // returns false (and changes nothing) while a transport is set.
+    bool set_regularization(double distance, int inner_substeps = 16);
+    double get_regularization_distance() const;
+
+    // Pairs regularised during the last 'step()'.
+    std::size_t get_regularized_pair_count() const;
+
+protected:
+    double refresh_forces(std::vector<Body>& bodies, TestParticles& tracers, double G) override;
+    double advance(std::vector<Body>& bodies, TestParticles& tracers, double G, double h, int n) override;
+    double compute_potential(const std::vector<Body>& bodies, double G) const override;
+    void apply_execution(const ExecutionOptions& options) override;
+    // Drops stale subsystems and picks the close encounters of the step.
+    void plan_step(double span) override;
+    // Subsystem pairs and the encounters regularised in this step.
+    bool pair_resolved(std::size_t i, std::size_t j) const override;
+    // Not with Wisdom–Holman, subsystems or regularisation.
+    bool supports_transport() const override;
 
 private:
-    double G_;
-    double dt_;
+    void rebuild_pipeline();
+    bool in_subsystem(BodyHandle h) const;
+    double advance_hierarchical(std::vector<Body>& bodies, TestParticles& tracers, double G, double h, int n);
+
     Integrator integrator_;
-    std::vector<Body> bodies_;
-    int substeps_;
-    double time_ {0.0};
+    double softening_ {0.0};
+    SofteningKernel softening_kernel_ {SofteningKernel::Plummer};
+    ExtraForces extra_;
+    std::unique_ptr<detail::AnyPipeline> pipeline_;
+
+    std::vector<Subsystem> subsystems_;
+    double regularization_distance_ {0.0};
+    int regularization_substeps_ {16};
+    std::size_t regularized_pairs_ {0};
+    // Pairs of the current step: the subsystems, then the regularised
+    // encounters (see 'plan_step').
+    std::vector<Subsystem> planned_;
+    // Scratch state of 'advance_hierarchical'.
+    std::vector<Body> outer_;
+    std::vector<Body> sources_;
+    std::vector<Vec2> start_pos_;
+    std::vector<Vec2> start_vel_;
+    std::vector<Vec2> probes_;
+    std::vector<Vec2> tidal_;
 };
 
 } // namespace orbitsimlite
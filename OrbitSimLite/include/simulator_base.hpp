@@ -0,0 +1,386 @@
+// OrbitSimLite - Simulator state shared by all simulator front-ends
+//
+// SimulatorBase owns the collection of bodies and is responsible for:
+//  - storing global simulation parameters (G, dt, substeps)
+//  - driving the substep loop and accumulating simulation time
+//  - exposing read/write access to the current bodies
+//  - reporting conserved quantities (energy, momentum, centre of mass)
+//
+// The actual numerical work is delegated to two hooks implemented by the
+// concrete simulators: BasicSimulator binds them to a compile-time Pipeline,
+// while the Simulator facade dispatches them to a runtime-selected one. The
+// hooks are called once per step, never per body or per pair.
+//
+// It deliberately stays agnostic of any rendering or input concerns.
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "body.hpp"
+#include "body_handle.hpp"
+#include "diagnostics.hpp"
+#include "events.hpp"
+#include "physics.hpp"
+#include "execution.hpp"
+#include "test_particles.hpp"
+
+namespace orbitsimlite {
+
+class StatePublisher;
+class Transport;
+
+class SimulatorBase {
+public:
+    virtual ~SimulatorBase() = default;
+
+    // Body management -------------------------------------------------------
+
+    // Append a new body to the simulation. The returned handle keeps
+    // referring to this body while others are added or removed.
+    BodyHandle add_body(const Body& b);
+
+    // Replace the entire body set with 'bs'. Existing handles become stale.
+    void set_bodies(const std::vector<Body>& bs);
+
+    // Remove all bodies (test particles are kept; see 'clear_test_particles').
+    void clear();
+
+    // Stable handles ---------------------------------------------------------
+    //
+    // Removal is O(1): the last body moves into the freed index, so body
+    // order is not preserved. Handles of removed bodies become stale; all
+    // other handles stay valid. Bodies appended through 'access_bodies()'
+    // receive handles on the next handle query, but erasing through it
+    // invalidates every handle - use 'remove_body' instead.
+    bool remove_body(BodyHandle h);
+    void remove_body_at(std::size_t index);
+    bool contains(BodyHandle h) const;
+    std::size_t index_of(BodyHandle h) const; // HandleTable::npos if stale
+    BodyHandle handle_at(std::size_t index) const;
+    const Body* find_body(BodyHandle h) const;
+    Body* find_body(BodyHandle h);
+
+    // Spatial ordering -------------------------------------------------------
+    //
+    // Bodies are stored in the order they were added, so neighbours in space
+    // are scattered in memory. 'reorder_bodies()' sorts them along a Morton
+    // curve (spatial_order.hpp); handles follow their bodies, indices do
+    // not. With 'set_spatial_reordering(n)' every n-th 'step()' does this
+    // first (0 disables, the default). The direct-sum force pass reads every
+    // source anyway and gains nothing; passes over spatial neighbours
+    // (grid collision checks, density binning) do.
+    void reorder_bodies();
+    void set_spatial_reordering(int steps);
+    int get_spatial_reordering() const;
+
+    // Test particles -------------------------------------------------------
+    //
+    // Massless tracers (ring particles, spacecraft, debris) stored in bulk and
+    // integrated with the same scheme as the bodies. They feel the active
+    // bodies but never act as sources, so a million tracers around a handful
+    // of planets cost O(N_active) each per force pass. Single bodies can be
+    // made passive instead via Body::is_test_particle.
+    void add_test_particle(const Vec2& pos, const Vec2& vel);
+    void set_test_particles(const TestParticles& tracers);
+    void clear_test_particles();
+    const TestParticles& get_test_particles() const;
+
+    // Time step (seconds) ---------------------------------------------------
+
+    void set_dt(double dt_);
+    double get_dt() const;
+
+    // Gravitational constant (SI units) ------------------------------------
+
+    void set_gravity(double G_);
+    double get_gravity() const;
+
+    // Substepping -----------------------------------------------------------
+    //
+    // Each call to 'step()' advances the simulation by dt_. Internally this
+    // can be subdivided into 'n' smaller steps of size dt_/n to improve
+    // stability for tight orbits (e.g., Earth–Moon) without changing the
+    // externally visible timestep.
+    void set_substeps(int n);
+    int get_substeps() const;
+
+    // Automatic substeps. With 'eta' > 0, every 'step()' picks the substep
+    // count so that a substep spans at most 'eta' times the shortest
+    // dynamical timescale of the current configuration (see below), between
+    // 'get_substeps()' and 'max_substeps'. The cost of a step then follows
+    // the closest pair instead of a worst-case guess: an eccentric orbit
+    // takes many substeps near periapsis and few near apoapsis. 'eta' is
+    // roughly the error knob; 0.01 resolves a circular orbit with ~630
+    // substeps. Zero or negative disables it (the default).
+    void set_auto_substeps(double eta, int max_substeps = 1024);
+    double get_auto_substeps() const;
+    // Substeps used by the last 'step()'.
+    int get_last_substeps() const;
+
+    // Shortest dynamical timescale over all pairs of bodies of which at
+    // least one is a source: min(sqrt(r^3 / (G (m_i + m_j))), r / |v_ij|),
+    // i.e. the orbital time (period / 2 pi) or, for fast encounters, the
+    // crossing time. Per-body softening lengths are added to r. Test
+    // particles in the bulk store are not considered, nor are the pairs the
+    // last step integrated by other means (see 'pair_resolved'). O(N^2);
+    // +inf with fewer than two bodies. With a transport it is collective and
+    // covers the pairs across ranks too, so every rank gets the value of the
+    // whole system.
+    double dynamical_timescale() const;
+
+    // Simulation time -------------------------------------------------------
+
+    // Return the accumulated simulation time in seconds since construction
+    // or the last call to 'reset_time()'.
+    double get_time() const;
+
+    // Reset the accumulated simulation time to zero. Does not modify bodies.
+    void reset_time();
+
+    // Overwrite the accumulated simulation time (e.g. when restoring state).
+    void set_time(double t);
+
+    // Advance the whole system by one external step of size dt_. Depending
+    // on the configured substeps, this may internally perform multiple
+    // smaller integration steps.
+    void step();
+
+    // Access the current bodies. The non-const accessor is intended for
+    // components such as the renderer that need to remove bodies (e.g. on
+    // collision). External users should prefer the const view where possible.
+    //
+    // Calling 'access_bodies()' invalidates the cached accelerations and
+    // potential energy; they are recomputed on the next 'step()'.
+    const std::vector<Body>& get_bodies() const;
+    std::vector<Body>& access_bodies();
+
+    // Diagnostics -----------------------------------------------------------
+    //
+    // Conserved quantities of the current state. The potential energy is
+    // accumulated during the force pass that 'step()' already performs, so
+    // this call is O(N) after a step. Before the first step (or after the
+    // bodies were modified) the potential is computed on demand, except on
+    // a rank of a decomposed simulation (set_transport), where the potential
+    // and total energy are NaN until the next step.
+    Diagnostics diagnostics() const;
+
+    // Energy drift alert. When enabled, the total energy at the time the
+    // alert is armed (or at the last 'reset_energy_reference()') is used as
+    // reference. After each 'step()' the relative drift |E - E0| / |E0| is
+    // checked and 'callback' is invoked once when it first exceeds
+    // 'max_relative_drift'. The alert stays latched until the reference is
+    // reset, so a run that has gone unstable does not spam the callback.
+    using DriftCallback = std::function<void(const Diagnostics& d, double relative_drift)>;
+    void set_energy_drift_alert(double max_relative_drift, DriftCallback callback);
+    void clear_energy_drift_alert();
+    void reset_energy_reference();
+    double get_energy_reference() const;
+    bool energy_drift_exceeded() const;
+
+    // Parallel force evaluation --------------------------------------------
+    //
+    // Split the per-body loops of each force pass across 'n' threads (1, the
+    // default, runs serially; 0 uses all hardware threads). Accelerations
+    // and trajectories are identical for every thread count. In reproducible
+    // mode the potential energy (and thus diagnostics and the drift alert)
+    // is reduced in a fixed pairwise order as well, so the complete state is
+    // bit-identical across thread counts; across ISAs this additionally
+    // requires building with ORBITSIMLITE_STRICT_FP=ON (no FMA contraction).
+    void set_threads(unsigned n);
+    unsigned get_threads() const;
+    void set_reproducible(bool on);
+    bool is_reproducible() const;
+
+    // High-accuracy mode for long integrations ------------------------------
+    //
+    // Over millions of steps the rounding of 'pos += vel * h' (and of the
+    // accumulated time) dominates the truncation error of the integrator.
+    // In compensated mode the Euler and RK4 updates and the simulation clock
+    // keep TwoSum error terms (Body::pos_carry / vel_carry), which recovers
+    // most of the lost digits at the cost of a few extra additions per body
+    // and step; see the bench suite for the measured overhead.
+    void set_compensated(bool on);
+    bool is_compensated() const;
+
+    // Events ------------------------------------------------------------------
+    //
+    // Register 'callback' for the zero crossings of 'condition' (see
+    // events.hpp). Each 'step()' samples every condition at 'samples'
+    // points along the interpolated trajectory of the step (more samples
+    // catch crossings that come and go within one step, at the cost of
+    // extra condition evaluations; no extra force passes are needed),
+    // locates each crossing by regula falsi and, once the step is complete,
+    // calls the callbacks in time order. Returns the event id. Copies of a
+    // simulator, and simulators assigned from one, start without events
+    // but keep the sample count.
+    std::size_t add_event(const EventCondition& condition, EventCallback callback);
+    bool remove_event(std::size_t id);
+    void clear_events();
+    void set_event_samples(int samples);
+    int get_event_samples() const;
+
+    // Dense output ------------------------------------------------------------
+    //
+    // With dense output enabled, each 'step()' keeps the state it started
+    // from, so positions at any time within the last step can be recovered
+    // from the quintic Hermite interpolant through both ends (see
+    // dense_output.hpp) without further force evaluations. This works the
+    // same for every integrator; it is enabled implicitly while events are
+    // registered. 'state_at' fills 'out' with the bodies at time 't' and
+    // returns false when 't' lies outside the last step or the bodies were
+    // changed since (added, removed or modified via access_bodies()).
+    void set_dense_output(bool on);
+    bool has_dense_output() const;
+    bool state_at(double t, std::vector<Body>& out) const;
+    // Start time of the interval covered by 'state_at' (it ends at
+    // get_time()); NaN when there is none.
+    double dense_output_begin() const;
+
+    // Domain decomposition --------------------------------------------------
+    //
+    // With a transport attached (not owned; nullptr detaches), this simulator
+    // is one rank of a simulation spread over several processes (or threads,
+    // see LoopbackGroup): it holds and integrates only the bodies and test
+    // particles of its domain, while its force passes see the active bodies
+    // of every rank (domain.hpp). All ranks must be configured alike and call
+    // 'step()' and 'rebalance()' equally often; both are collective.
+    //
+    // 'rebalance()' hands every body and test particle to the rank whose
+    // stretch of the Morton curve contains it, with the curve split so that
+    // the ranks hold about equal numbers; it returns false without a
+    // transport. Handles of bodies that leave become stale, and the
+    // receiving rank issues new ones. With 'set_rebalancing(n)' every n-th
+    // 'step()' starts with a rebalance (0 disables, the default).
+    //
+    // After a step, 'diagnostics()' covers the local bodies and the rank's
+    // share of the potential energy (see 'reduce_diagnostics'). The drift
+    // alert watches the whole system, so arming it and resetting its
+    // reference are collective too. Events, dense output and snapshots only
+    // see local bodies. Automatic substeps use the shortest local timescale
+    // over all ranks. Copies of a simulator start without a transport.
+    //
+    // Schemes that need every body in one place (the Wisdom–Holman
+    // integrator, Simulator's subsystems and regularisation) cannot run
+    // decomposed: 'set_transport' returns false and leaves the simulator
+    // alone while one is configured, and configuring one fails while a
+    // transport is set.
+    bool set_transport(Transport* transport);
+    Transport* get_transport() const;
+    bool rebalance();
+    void set_rebalancing(int steps);
+    int get_rebalancing() const;
+
+    // Snapshot publication --------------------------------------------------
+    //
+    // With a publisher attached (not owned; nullptr detaches), every 'step()'
+    // ends by publishing the new state, so concurrent readers in this or
+    // other processes can follow the run without locks (see
+    // state_publisher.hpp). Copies of a simulator, and simulators assigned
+    // from one, start without a publisher.
+    void set_state_publisher(StatePublisher* publisher);
+    StatePublisher* get_state_publisher() const;
+
+protected:
+    SimulatorBase(double G, double dt);
+    // Copies get their own thread pool of the same size.
+    SimulatorBase(const SimulatorBase& other);
+    SimulatorBase& operator=(const SimulatorBase& other);
+
+    // Compute the accelerations of bodies and test particles for the current
+    // state; return the potential energy of the bodies.
+    virtual double refresh_forces(std::vector<Body>& bodies, TestParticles& tracers, double G) = 0;
+
+    // Advance bodies and test particles by 'n' substeps of size 'h'. On entry
+    // the accelerations are valid; on exit they must be refreshed for the
+    // final state, and the potential energy of that state is returned.
+    virtual double advance(std::vector<Body>& bodies, TestParticles& tracers, double G, double h, int n) = 0;
+
+    // Potential energy of 'bodies' without side effects.
+    virtual double compute_potential(const std::vector<Body>& bodies, double G) const = 0;
+
+    // Hand the execution options (thread pool, reproducible and compensated
+    // modes) to the force kernel. Called whenever any of them changes.
+    virtual void apply_execution(const ExecutionOptions& options) = 0;
+
+    // Called by 'step()' before the substep count is chosen, with the span
+    // of the step: pick the pairs that 'advance' will integrate by other
+    // means (e.g. in relative coordinates).
+    virtual void plan_step(double span);
+
+    // Whether 'plan_step' picked the pair of bodies 'i' and 'j'. Such pairs
+    // do not limit the automatic substep count.
+    virtual bool pair_resolved(std::size_t i, std::size_t j) const;
+
+    // Whether the configured scheme can run as one rank of a decomposed
+    // simulation (see 'set_transport').
+    virtual bool supports_transport() const;
+
+    const ExecutionOptions& execution() const;
+
+    // Drop the cached force pass (e.g. after the force law changed).
+    void invalidate_forces();
+
+private:
+    // Diagnostics of the whole system: reduced over all ranks (collective)
+    // when a transport is attached.
+    Diagnostics system_diagnostics() const;
+    // 'dynamical_timescale' over the bodies of all ranks (collective).
+    double domain_timescale(Transport& transport) const;
+    void check_energy_drift();
+    // Locate and report the events of the step that started at 't0'.
+    void detect_events(double t0);
+    // Bring the handle table in line with bodies changed via access_bodies().
+    void sync_handles() const;
+
+    double G_;
+    double dt_;
+    std::vector<Body> bodies_;
+    mutable HandleTable handles_;
+    TestParticles tracers_;
+    int substeps_ {1};
+    int reorder_interval_ {0};
+    int steps_since_reorder_ {0};
+    std::vector<std::size_t> reorder_;
+    int rebalance_interval_ {0};
+    int steps_since_rebalance_ {0};
+    double auto_eta_ {0.0};
+    int auto_max_substeps_ {1024};
+    int last_substeps_ {1};
+    double time_ {0.0};
+    double time_carry_ {0.0};
+
+    // Cached force pass results; valid while bodies are only changed by step().
+    bool forces_valid_ {false};
+    double potential_ {0.0};
+
+    // Energy drift monitoring
+    DriftCallback drift_callback_;
+    double max_drift_ {0.0};
+    double energy_ref_ {0.0};
+    bool energy_ref_valid_ {false};
+    bool drift_alerted_ {false};
+
+    // Parallel execution
+    std::unique_ptr<ThreadPool> pool_;
+    ExecutionOptions exec_;
+
+    StatePublisher* publisher_ {nullptr};
+
+    struct EventSlot {
+        std::size_t id;
+        EventCondition condition;
+        EventCallback callback;
+    };
+    std::vector<EventSlot> events_;
+    std::size_t next_event_id_ {1};
+    int event_samples_ {4};
+    // Start of the last step, kept for events and dense output.
+    bool dense_output_ {false};
+    bool step_start_valid_ {false};
+    double step_start_time_ {0.0};
+    std::vector<Body> step_start_;
+    std::vector<Body> event_state_;
+};
+
+} // namespace orbitsimlite
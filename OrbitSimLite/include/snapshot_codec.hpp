@@ -0,0 +1,109 @@
+// OrbitSimLite - Quantized, delta-encoded state snapshots
+//
+// A raw state frame costs 56 bytes per body (mass, position, velocity,
+// acceleration as doubles). For recording long histories or streaming every
+// frame, SnapshotEncoder shrinks that in three stages:
+//
+//  1. Quantization: positions and velocities are rounded to a fixed grid
+//     ('position_step' metres, 'velocity_step' m/s) relative to a reference
+//     frame, the centre of mass and its velocity at the last keyframe. The
+//     decoded values are within half a step of the originals.
+//  2. Prediction: each quantized value is extrapolated from the three
+//     previous snapshots (a quadratic through them), and only the integer
+//     residual is kept; for smooth orbits most residuals fit into a byte.
+//  3. Compression: residuals are zigzag/varint coded channel by channel and
+//     the result is packed with the built-in LZ codec (lz_codec.hpp).
+//
+// Keyframes carry masses, the reference frame and the grid steps, and are
+// decodable on their own. They are emitted every 'keyframe_interval'
+// snapshots and whenever the body count or a mass changes. A delta snapshot
+// is only decodable after all snapshots since its keyframe, so the format
+// suits files and reliable streams, not lossy "latest frame" channels such as
+// TelemetryServer. Names and other static attributes are not encoded; bodies
+// are identified by their index, as in get_bodies().
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "body.hpp"
+#include "simulator_base.hpp"
+#include "vec2.hpp"
+
+namespace orbitsimlite {
+
+struct SnapshotCodecOptions {
+    double position_step {1.0e3};       // metres; max position error is half of this
+    double velocity_step {1.0e-3};      // m/s; max velocity error is half of this
+    bool include_acceleration {false};
+    double acceleration_step {1.0e-9};  // m/s^2, used when accelerations are included
+    std::uint32_t keyframe_interval {256};
+};
+
+// One decoded snapshot.
+struct Snapshot {
+    double time {0.0};
+    bool keyframe {false};
+    std::vector<double> mass;
+    std::vector<Vec2> pos;
+    std::vector<Vec2> vel;
+    std::vector<Vec2> acc; // empty unless accelerations were encoded
+};
+
+class SnapshotEncoder {
+public:
+    explicit SnapshotEncoder(const SnapshotCodecOptions& options = SnapshotCodecOptions{});
+
+    // Grid steps and the keyframe interval take effect at the next keyframe.
+    void set_options(const SnapshotCodecOptions& options);
+    const SnapshotCodecOptions& options() const;
+
+    // Append one encoded snapshot of 'bodies' at time 'time' to 'out'.
+    void encode(const std::vector<Body>& bodies, double time, std::vector<std::uint8_t>& out);
+    void encode(const SimulatorBase& sim, std::vector<std::uint8_t>& out);
+
+    // Make the next snapshot a keyframe (e.g. when starting a new file).
+    void force_keyframe();
+
+private:
+    SnapshotCodecOptions options_;
+    SnapshotCodecOptions active_; // options of the current keyframe run
+    std::uint32_t since_keyframe_ {0};
+    bool need_keyframe_ {true};
+
+    std::vector<double> mass_;
+    Vec2 ref_pos_, ref_vel_;
+    // Quantized values of the previous three snapshots, channel-major.
+    std::vector<std::int64_t> prev_, prev2_, prev3_;
+    std::uint32_t history_ {0};
+
+    std::vector<std::int64_t> quantized_;
+    std::vector<std::uint8_t> raw_;
+    std::vector<std::uint8_t> packed_;
+};
+
+class SnapshotDecoder {
+public:
+    // Decode the snapshot starting at data[offset] and advance 'offset' past
+    // it. Returns false on malformed input or on a delta snapshot whose
+    // predecessors have not been decoded.
+    bool decode(const std::uint8_t* data, std::size_t size, std::size_t& offset, Snapshot& out);
+
+    // Forget the decoding history; the next snapshot must be a keyframe.
+    void reset();
+
+private:
+    bool synced_ {false};
+    std::size_t count_ {0};
+    bool has_acc_ {false};
+    double steps_[3] {0.0, 0.0, 0.0};
+    std::vector<double> mass_;
+    Vec2 ref_pos_, ref_vel_;
+    std::vector<std::int64_t> prev_, prev2_, prev3_;
+    std::uint32_t history_ {0};
+
+    std::vector<std::uint8_t> raw_;
+};
+
+} // namespace orbitsimlite
@@ -0,0 +1,149 @@
+// OrbitSimLite - Lock-free snapshot publication for concurrent readers
+//
+// get_bodies() returns the live std::vector<Body>. Body is trivially
+// copyable, but the vector is not safe to read from another thread while
+// the simulation steps, and another process cannot read it at all: it
+// lives in this process, and its names are ids into the process-wide name
+// table (name_table.hpp). StatePublisher writes a self-contained
+// plain-old-data image of the state, names included, after each step into
+// a small ring of slots, each guarded by a sequence counter (a seqlock):
+//
+//  - the writer never waits: it fills the oldest slot, making its sequence
+//    odd while writing and even again when done, then advances 'latest';
+//  - readers never block the writer and take no locks: they look at the
+//    newest slot in place and confirm afterwards that its sequence did not
+//    change. A view stays valid until the writer has published 'slots - 1'
+//    further snapshots, so a reader that keeps up never copies or retries.
+//
+// The region is self-describing and position-independent, so the same layout
+// is used in-process (heap) and across processes (a POSIX shm_open segment
+// created by 'create_shared' and mapped read-only by 'open_shared').
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "body.hpp"
+
+namespace orbitsimlite {
+
+class SimulatorBase;
+
+inline constexpr std::uint32_t kPublishedStar = 1u << 0;
+inline constexpr std::uint32_t kPublishedSatellite = 1u << 1;
+inline constexpr std::uint32_t kPublishedPassive = 1u << 2;
+
+// Fixed-size, trivially copyable image of one Body (96 bytes).
+struct PublishedBody {
+    double mass;
+    double pos[2];
+    double vel[2];
+    double acc[2];
+    double radius;
+    std::uint32_t color;
+    std::uint32_t flags;  // kPublishedStar | kPublishedSatellite | kPublishedPassive
+    char name[24];        // NUL-terminated, truncated if longer
+};
+
+// Layout of the shared region: a StateRegionHeader, then 'slots' slots of
+// 'slot_stride' bytes, each a StateSlotHeader followed by 'capacity'
+// PublishedBody records.
+struct StateRegionHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t slots;
+    std::uint32_t capacity;
+    std::uint64_t slot_stride;
+    std::atomic<std::uint64_t> latest; // generation of the newest snapshot, 0 = none
+};
+
+struct StateSlotHeader {
+    std::atomic<std::uint64_t> sequence; // odd while being written
+    std::uint64_t generation;
+    double time;
+    std::uint64_t count;
+};
+
+class StatePublisher {
+public:
+    // In-process region for up to 'capacity' bodies.
+    explicit StatePublisher(std::size_t capacity, unsigned slots = 3);
+
+    // Region in the POSIX shared memory object 'name' (e.g. "/orbitsimlite"),
+    // created or replaced. Returns nullptr and fills 'error' on failure.
+    static std::unique_ptr<StatePublisher> create_shared(const std::string& name, std::size_t capacity,
+                                                         unsigned slots = 3, std::string* error = nullptr);
+
+    // Unmaps the region; a shared object is also unlinked.
+    ~StatePublisher();
+
+    StatePublisher(const StatePublisher&) = delete;
+    StatePublisher& operator=(const StatePublisher&) = delete;
+
+    std::size_t capacity() const;
+    unsigned slots() const;
+
+    // Publish the current state. Returns false (and publishes nothing) when
+    // there are more bodies than 'capacity'.
+    bool publish(const SimulatorBase& sim);
+    bool publish(const std::vector<Body>& bodies, double time);
+
+private:
+    friend class StateReader;
+    StatePublisher() = default;
+    void init(std::size_t capacity, unsigned slots);
+
+    unsigned char* base_ {nullptr};
+    std::size_t size_ {0};
+    std::string shm_name_; // empty for heap regions
+};
+
+class StateReader {
+public:
+    // Zero-copy view of one snapshot; check 'still_valid' after using it.
+    struct View {
+        const PublishedBody* bodies {nullptr};
+        std::size_t count {0};
+        double time {0.0};
+        std::uint64_t generation {0};
+        std::uint64_t sequence {0};
+        const StateSlotHeader* slot {nullptr};
+    };
+
+    // Reader of an in-process publisher (which must outlive it).
+    explicit StateReader(const StatePublisher& publisher);
+
+    // Map the shared memory object 'name' read-only. Returns nullptr and
+    // fills 'error' on failure.
+    static std::unique_ptr<StateReader> open_shared(const std::string& name, std::string* error = nullptr);
+
+    ~StateReader();
+
+    StateReader(const StateReader&) = delete;
+    StateReader& operator=(const StateReader&) = delete;
+
+    // Point 'view' at the newest snapshot. Returns false if nothing has been
+    // published yet.
+    bool acquire(View& view) const;
+
+    // True if the data behind 'view' has not been overwritten since
+    // 'acquire'. Anything read from the view before this check is consistent.
+    bool still_valid(const View& view) const;
+
+    // Copy the newest snapshot into 'out', retrying until the copy is
+    // consistent. Returns false if nothing has been published yet.
+    bool read(std::vector<PublishedBody>& out, double* time = nullptr, std::uint64_t* generation = nullptr) const;
+
+private:
+    StateReader() = default;
+
+    const unsigned char* base_ {nullptr};
+    std::size_t size_ {0};
+    bool mapped_ {false};
+};
+
+} // namespace orbitsimlite
@@ -0,0 +1,111 @@
+// OrbitSimLite - Asynchronous stepping for event-driven hosts
+//
+// 'SimulatorBase::step()' blocks for as long as the step takes, and a long
+// advance is thousands of them. StepExecutor runs such advances on its own
+// worker threads so that an event loop never blocks on the simulation:
+//
+//  - 'advance_until(sim, t)' queues a job and returns at once with an
+//    AdvanceHandle holding a std::future of the outcome;
+//  - jobs run in chunks of 'chunk_steps' steps. After each chunk the job's
+//    progress callback is invoked and the job goes to the back of the
+//    queue, so any number of simulators share the workers round-robin and a
+//    long advance cannot starve a short one;
+//  - 'AdvanceHandle::cancel()' stops a job at its next chunk boundary.
+//
+// A simulator must not be touched by anything else (including a second job)
+// from 'advance_until' until its future is ready. Callbacks run on a worker
+// thread; an exception thrown by one ends the job and is rethrown by the
+// future.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace orbitsimlite {
+
+class SimulatorBase;
+
+enum class AdvanceStatus { Completed, Cancelled };
+
+struct AdvanceResult {
+    AdvanceStatus status {AdvanceStatus::Completed};
+    double time {0.0};        // simulation time when the job ended
+    std::uint64_t steps {0};  // steps taken by the job
+};
+
+struct AdvanceProgress {
+    double time {0.0};
+    double target {0.0};
+    std::uint64_t steps {0};  // steps taken so far
+    std::uint64_t total {0};  // steps the job will take unless cancelled
+};
+
+using ProgressCallback = std::function<void(const AdvanceProgress&)>;
+
+class AdvanceHandle {
+public:
+    AdvanceHandle() = default;
+
+    // Ask the job to stop at its next chunk boundary. The future then holds
+    // AdvanceStatus::Cancelled (unless the job had already completed).
+    void cancel();
+
+    std::future<AdvanceResult>& future() { return future_; }
+
+    // True once the outcome is available (never blocks).
+    bool ready() const;
+
+private:
+    friend class StepExecutor;
+    std::shared_ptr<std::atomic<bool>> cancel_;
+    std::future<AdvanceResult> future_;
+};
+
+class StepExecutor {
+public:
+    // 'workers' == 0 uses std::thread::hardware_concurrency().
+    explicit StepExecutor(unsigned workers = 0, std::uint64_t chunk_steps = 64);
+
+    // Cancels the queued jobs (their futures report Cancelled), lets running
+    // chunks finish, then joins the workers.
+    ~StepExecutor();
+
+    StepExecutor(const StepExecutor&) = delete;
+    StepExecutor& operator=(const StepExecutor&) = delete;
+
+    unsigned workers() const;
+    std::uint64_t chunk_steps() const;
+
+    // Advance 'sim' in whole steps of its dt until its time reaches 't'
+    // (a target at or before the current time takes no steps).
+    AdvanceHandle advance_until(SimulatorBase& sim, double t, ProgressCallback progress = nullptr);
+
+    // Jobs queued or running.
+    std::size_t pending() const;
+
+private:
+    struct Job;
+
+    void worker_loop();
+    // Run one chunk of 'job'; returns true when the job has ended.
+    bool run_chunk(Job& job);
+
+    std::uint64_t chunk_steps_;
+    std::vector<std::thread> threads_;
+    std::deque<std::unique_ptr<Job>> ready_;
+    std::size_t running_ {0};
+    bool stop_ {false};
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+};
+
+} // namespace orbitsimlite
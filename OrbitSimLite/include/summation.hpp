@@ -0,0 +1,57 @@
+// OrbitSimLite - Deterministic floating-point summation helpers
+//
+// Floating-point addition is not associative, so the result of a reduction
+// depends on the order in which its terms are combined. The helpers here fix
+// that order independently of how the terms were produced (serially, by a
+// thread pool of any size, or with SIMD), which keeps regression outputs
+// bit-identical across machines.
+#pragma once
+
+#include <cstddef>
+#include "vec2.hpp"
+
+namespace orbitsimlite {
+
+// Block length of 'pairwise_sum': blocks are summed left to right, block
+// sums are combined in a balanced binary tree.
+inline constexpr std::size_t kPairwiseBlock = 64;
+
+// Pairwise (cascade) summation of v[0 .. n). The combination tree only
+// depends on 'n'; the error grows as O(log n) instead of O(n).
+inline double pairwise_sum(const double* v, std::size_t n) {
+    if (n <= kPairwiseBlock) {
+        double s = 0.0;
+        for (std::size_t i = 0; i < n; ++i) s += v[i];
+        return s;
+    }
+    // Split on a block boundary so the leaves are always whole blocks.
+    const std::size_t blocks = (n + kPairwiseBlock - 1) / kPairwiseBlock;
+    const std::size_t half = (blocks / 2) * kPairwiseBlock;
+    return pairwise_sum(v, half) + pairwise_sum(v + half, n - half);
+}
+
+// Error-free transformation (Knuth's TwoSum): s + e == a + b exactly, with
+// s = fl(a + b). Valid for any magnitudes of a and b.
+inline void two_sum(double a, double b, double& s, double& e) {
+    s = a + b;
+    const double bp = s - a;
+    e = (a - (s - bp)) + (b - bp);
+}
+
+// Compensated accumulation: add 'inc' to the running value 'sum' whose
+// low-order part is kept in 'carry'. Over many small increments the error
+// stays at the level of a few ulps of 'sum' instead of growing with the
+// number of additions.
+inline void compensated_add(double& sum, double& carry, double inc) {
+    double s, e;
+    two_sum(sum, inc + carry, s, e);
+    sum = s;
+    carry = e;
+}
+
+inline void compensated_add(Vec2& sum, Vec2& carry, const Vec2& inc) {
+    compensated_add(sum.x, carry.x, inc.x);
+    compensated_add(sum.y, carry.y, inc.y);
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,64 @@
+// OrbitSimLite - Bounded task queue on a set of worker threads
+//
+// ThreadPool runs one data-parallel job at a time and blocks the caller.
+// TaskQueue is its asynchronous counterpart: independent tasks (encoding a
+// captured frame, writing a file) are pushed from a producer loop and run
+// in FIFO order on the workers while the producer continues. The queue is
+// bounded, so a producer that outpaces the workers blocks in 'push' instead
+// of buffering without limit.
+//
+// A task that throws does not take its worker down: the first exception is
+// kept, the remaining tasks still run, and 'wait_idle' rethrows it.
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace orbitsimlite {
+
+class TaskQueue {
+public:
+    using Task = std::function<void()>;
+
+    // 'workers' == 0 uses std::thread::hardware_concurrency(); 'capacity'
+    // == 0 allows two queued tasks per worker.
+    explicit TaskQueue(unsigned workers = 0, std::size_t capacity = 0);
+
+    // Runs the remaining tasks, then joins the workers. An exception no
+    // 'wait_idle' collected is dropped.
+    ~TaskQueue();
+
+    TaskQueue(const TaskQueue&) = delete;
+    TaskQueue& operator=(const TaskQueue&) = delete;
+
+    unsigned workers() const;
+
+    // Enqueue 'task'; blocks while the queue is full.
+    void push(Task task);
+
+    // Block until every pushed task has finished. Rethrows the first
+    // exception a task threw since the previous call, if any.
+    void wait_idle();
+
+private:
+    void worker_loop();
+
+    std::vector<std::thread> threads_;
+    std::deque<Task> tasks_;
+    std::size_t capacity_;
+    std::size_t running_ {0};
+    bool stop_ {false};
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::condition_variable idle_;
+};
+
+} // namespace orbitsimlite
@@ -0,0 +1,156 @@
+// OrbitSimLite - Streaming telemetry over a Unix domain socket
+//
+// An alternative to polling the JSON file written by the renderer: the
+// simulation thread calls 'publish(sim)' as often as it likes, and at most
+// 'rate_hz' times per second the current state is packed into a compact
+// binary frame. A background thread accepts local subscribers on a
+// SOCK_STREAM Unix socket and fans the frames out to them.
+//
+// The simulation thread never waits for a consumer. Every subscriber gets
+// the newest frame once it has drained the previous one; frames published
+// while it is still busy are skipped for that subscriber only, so a slow
+// dashboard sees a lower frame rate instead of stalling the run.
+//
+// Wire format (native byte order, all messages start with a
+// TelemetryHeader whose 'size' covers the whole message):
+//  - Catalog: sent to each new subscriber and whenever the body set changes;
+//    'count' TelemetryCatalogEntry records, each followed by 'name_length'
+//    bytes of the body's name.
+//  - State: 'count' TelemetryBodyState records (56 bytes per body), in the
+//    order of the catalog whose revision is given in 'catalog'.
+//
+// Only available on POSIX systems; elsewhere 'start' fails.
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulator_base.hpp"
+
+namespace orbitsimlite {
+
+inline constexpr std::uint32_t kTelemetryMagic = 0x544C534Fu; // "OSLT"
+inline constexpr std::uint16_t kTelemetryVersion = 1;
+
+enum class TelemetryMessage : std::uint16_t {
+    Catalog = 1,
+    State = 2
+};
+
+struct TelemetryHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t type;     // TelemetryMessage
+    std::uint32_t size;     // bytes, header included
+    std::uint32_t count;    // number of bodies
+    std::uint64_t sequence; // publish counter (State) or catalog revision (Catalog)
+    double time;            // simulation time in seconds
+    std::uint64_t catalog;  // catalog revision the message refers to
+};
+
+struct TelemetryCatalogEntry {
+    std::uint32_t color;
+    float radius;
+    std::uint32_t flags; // kTelemetryStar | kTelemetrySatellite | kTelemetryPassive
+    std::uint32_t name_length;
+};
+
+inline constexpr std::uint32_t kTelemetryStar = 1u << 0;
+inline constexpr std::uint32_t kTelemetrySatellite = 1u << 1;
+inline constexpr std::uint32_t kTelemetryPassive = 1u << 2;
+
+struct TelemetryBodyState {
+    double mass;
+    double pos[2];
+    double vel[2];
+    double acc[2];
+};
+
+struct TelemetryOptions {
+    double rate_hz {30.0};         // maximum frames per second; 0 publishes every call
+    std::size_t max_clients {16};  // further connections are refused
+};
+
+class TelemetryServer {
+public:
+    TelemetryServer() = default;
+    explicit TelemetryServer(const TelemetryOptions& options);
+    ~TelemetryServer();
+
+    TelemetryServer(const TelemetryServer&) = delete;
+    TelemetryServer& operator=(const TelemetryServer&) = delete;
+
+    // Bind 'socket_path' (an existing socket file is replaced) and start the
+    // delivery thread. Returns false and sets 'last_error' on failure.
+    bool start(const std::string& socket_path);
+
+    // Disconnect all subscribers, stop the thread and remove the socket file.
+    void stop();
+
+    bool is_running() const;
+    const std::string& last_error() const;
+
+    // Pack and hand over the current state if the rate limit allows it.
+    // Returns true when a frame was published. Cheap to call every step.
+    bool publish(const SimulatorBase& sim);
+
+    // Number of connected subscribers.
+    std::size_t client_count() const;
+
+private:
+    struct Shared;
+
+    // What the last catalog said about one body.
+    struct CatalogRecord {
+        TelemetryCatalogEntry entry;
+        NameId name_id;
+    };
+
+    static void serve(std::shared_ptr<Shared> shared, std::size_t max_clients);
+    bool catalog_changed(const std::vector<Body>& bodies) const;
+
+    TelemetryOptions options_;
+    std::string path_;
+    std::string error_;
+    std::shared_ptr<Shared> shared_;
+    std::thread thread_;
+
+    // Publisher-side state (simulation thread only)
+    std::chrono::steady_clock::time_point last_publish_ {};
+    bool published_once_ {false};
+    std::uint64_t sequence_ {0};
+    std::uint64_t catalog_revision_ {0};
+    std::vector<CatalogRecord> catalog_;
+};
+
+// Minimal blocking subscriber, for tools and tests.
+class TelemetryClient {
+public:
+    TelemetryClient() = default;
+    ~TelemetryClient();
+
+    TelemetryClient(const TelemetryClient&) = delete;
+    TelemetryClient& operator=(const TelemetryClient&) = delete;
+
+    bool connect(const std::string& socket_path);
+    void close();
+
+    // Read the next complete message into 'message' (header included).
+    // Returns false when the server closed the connection.
+    bool read(std::vector<char>& message);
+
+    // Helpers to interpret a message returned by 'read'.
+    static TelemetryHeader header(const std::vector<char>& message);
+    static std::vector<TelemetryBodyState> states(const std::vector<char>& message);
+    static std::vector<std::string> names(const std::vector<char>& message);
+
+private:
+    int fd_ {-1};
+};
+
+} // namespace orbitsimlite
@@ -0,0 +1,61 @@
+// OrbitSimLite - Bulk storage for massless test particles
+//
+// Ring particles, debris tracers and spacecraft feel gravity but do not
+// produce it. Storing them as full Body objects wastes memory (names,
+// rendering attributes) and, more importantly, would make them sources in
+// the pairwise force sum. TestParticles keeps only their kinematics in flat
+// structure-of-arrays form so the integrators can update them in bulk:
+// the force cost becomes O(N_active * N_tracers) instead of O(N^2).
+//
+// Individual bodies can also be made passive via Body::is_test_particle;
+// that keeps them in the regular body list (e.g. for rendering) while
+// still excluding them as sources.
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "vec2.hpp"
+
+namespace orbitsimlite {
+
+struct TestParticles {
+    std::vector<double> x, y;   // Positions (metres).
+    std::vector<double> vx, vy; // Velocities (metres / second).
+    std::vector<double> ax, ay; // Accelerations (metres / second^2), updated per step.
+
+    std::size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+
+    void add(const Vec2& pos, const Vec2& vel) {
+        x.push_back(pos.x);
+        y.push_back(pos.y);
+        vx.push_back(vel.x);
+        vy.push_back(vel.y);
+        ax.push_back(0.0);
+        ay.push_back(0.0);
+    }
+
+    void reserve(std::size_t n) {
+        x.reserve(n);
+        y.reserve(n);
+        vx.reserve(n);
+        vy.reserve(n);
+        ax.reserve(n);
+        ay.reserve(n);
+    }
+
+    void clear() {
+        x.clear();
+        y.clear();
+        vx.clear();
+        vy.clear();
+        ax.clear();
+        ay.clear();
+    }
+
+    Vec2 pos(std::size_t i) const { return Vec2{x[i], y[i]}; }
+    Vec2 vel(std::size_t i) const { return Vec2{vx[i], vy[i]}; }
+    Vec2 acc(std::size_t i) const { return Vec2{ax[i], ay[i]}; }
+};
+
+} // namespace orbitsimlite
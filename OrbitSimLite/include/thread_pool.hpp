@@ -0,0 +1,66 @@
+// OrbitSimLite - Minimal fork/join thread pool
+//
+// A fixed set of worker threads that execute one data-parallel job at a
+// time. 'parallel_for(n, fn)' splits the index range [0, n) into one
+// contiguous chunk per thread and blocks until all chunks are done; the
+// calling thread works on the first chunk itself.
+//
+// The partition only depends on 'n' and the thread count, so a given pool
+// size always hands the same indices to the same chunk.
+//
+// A chunk that throws does not take its thread down: 'parallel_for' still
+// waits for every other chunk and then rethrows the first exception on the
+// calling thread.
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace orbitsimlite {
+
+class ThreadPool {
+public:
+    using Job = std::function<void(std::size_t begin, std::size_t end)>;
+
+    // Create a pool running 'threads' chunks in parallel (including the
+    // caller). Zero selects std::thread::hardware_concurrency().
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of chunks a job is split into.
+    unsigned size() const;
+
+    // Run 'fn(begin, end)' over [0, n) split into at most size() contiguous
+    // chunks. Returns (or rethrows the first exception of a chunk) when
+    // every chunk has finished. Not re-entrant.
+    void parallel_for(std::size_t n, const Job& fn);
+
+    // Bounds of chunk 'k' of 'chunks' over [0, n).
+    static std::size_t chunk_begin(std::size_t n, unsigned k, unsigned chunks);
+
+private:
+    void worker_loop(unsigned index);
+    // Run one chunk, recording its exception for 'parallel_for'.
+    void run_chunk(const Job& fn, std::size_t begin, std::size_t end);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const Job* job_ {nullptr};
+    std::size_t job_size_ {0};
+    unsigned generation_ {0};
+    unsigned pending_ {0};
+    std::exception_ptr error_;
+    bool stop_ {false};
+};
+
+} // namespace orbitsimlite
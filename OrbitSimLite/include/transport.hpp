@@ -0,0 +1,142 @@
+// OrbitSimLite - Collective exchanges between the ranks of a domain
+//
+// A simulation too large for one process is split into 'size()' ranks, each
+// running its own simulator over the bodies of its spatial domain (see
+// SimulatorBase::set_transport). The ranks only talk to each other through
+// a Transport, which provides two collective operations:
+//
+//  - 'allgather': every rank contributes a byte block and receives the
+//    blocks of all ranks, in rank order (MPI_Allgatherv);
+//  - 'alltoall': every rank sends one block to each rank and receives the
+//    blocks addressed to it, in rank order (MPI_Alltoallv).
+//
+// Every rank must make the same sequence of collective calls. A transport
+// that cannot complete an exchange must not return from it (MPI's default
+// error handler aborts the job), so callers never see partial results.
+//
+// LoopbackGroup connects ranks that run as threads of one process, for
+// tests. SocketTransport connects ranks that run as separate processes on
+// one machine through Unix domain sockets. A transport across nodes
+// implements the same interface on top of MPI or TCP.
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace orbitsimlite {
+
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    virtual int rank() const = 0;
+    virtual int size() const = 0;
+
+    // Collective: afterwards 'out' holds the blocks of all ranks back to
+    // back, block r in [offsets[r], offsets[r + 1]).
+    virtual void allgather(const void* data, std::size_t bytes, std::vector<unsigned char>& out,
+                           std::vector<std::size_t>& offsets) = 0;
+
+    // Collective: 'send' holds the block for rank r in [send_offsets[r],
+    // send_offsets[r + 1]); 'recv' receives the block each rank addressed to
+    // this one, laid out the same way. The default implementation is built
+    // on 'allgather', so every rank also reads the blocks meant for others.
+    virtual void alltoall(const std::vector<unsigned char>& send, const std::vector<std::size_t>& send_offsets,
+                          std::vector<unsigned char>& recv, std::vector<std::size_t>& recv_offsets);
+
+    // Reductions of one value over all ranks (collective). The result is the
+    // same on every rank: values are combined in rank order.
+    double sum(double value);
+    double min(double value);
+    double max(double value);
+};
+
+// Ranks 0 .. ranks-1 of one process, each driven by its own thread.
+class LoopbackGroup {
+public:
+    explicit LoopbackGroup(int ranks);
+    ~LoopbackGroup();
+
+    LoopbackGroup(const LoopbackGroup&) = delete;
+    LoopbackGroup& operator=(const LoopbackGroup&) = delete;
+
+    int size() const;
+
+    // Endpoint of rank 'r'; owned by the group.
+    Transport& rank(int r);
+
+private:
+    class Endpoint;
+
+    void allgather(int rank, const void* data, std::size_t bytes, std::vector<unsigned char>& out,
+                   std::vector<std::size_t>& offsets);
+
+    std::vector<std::unique_ptr<Endpoint>> endpoints_;
+    // Two sets of blocks used by alternate exchanges: a rank can write its
+    // next block while slower ranks are still reading the previous one.
+    std::vector<std::vector<unsigned char>> slots_[2];
+    std::vector<int> parity_;
+    std::mutex mutex_;
+    std::condition_variable arrived_cv_;
+    int arrived_ {0};
+    unsigned long generation_ {0};
+};
+
+// One rank of a group of processes on this machine: a full mesh of Unix
+// domain stream sockets, one per pair of ranks. Every exchange sends one
+// length-prefixed block to each peer and reads one from each, multiplexed
+// with poll() so that large blocks cannot deadlock on full socket buffers;
+// 'alltoall' only sends each rank its own block. A peer that goes away in
+// the middle of an exchange aborts the process (see the contract above).
+//
+// Until 'connect' succeeds the transport is a group of one. Only available
+// on POSIX systems; elsewhere 'connect' fails.
+class SocketTransport final : public Transport {
+public:
+    SocketTransport() = default;
+    ~SocketTransport() override;
+
+    SocketTransport(const SocketTransport&) = delete;
+    SocketTransport& operator=(const SocketTransport&) = delete;
+
+    // Collective: join the group of 'size' processes whose rank r listens on
+    // 'path_prefix' + "." + r. Every process calls this with the same prefix
+    // and size and its own rank, in any order; it blocks until connected to
+    // every other rank, or fails after 'timeout_seconds'. The socket files
+    // are removed once the mesh is up. Returns false and sets 'last_error'
+    // on failure.
+    bool connect(const std::string& path_prefix, int rank, int size, double timeout_seconds = 30.0);
+
+    // Leave the group (not collective: peers notice at their next exchange).
+    void close();
+
+    bool is_connected() const;
+    const std::string& last_error() const;
+
+    int rank() const override;
+    int size() const override;
+
+    void allgather(const void* data, std::size_t bytes, std::vector<unsigned char>& out,
+                   std::vector<std::size_t>& offsets) override;
+    void alltoall(const std::vector<unsigned char>& send, const std::vector<std::size_t>& send_offsets,
+                  std::vector<unsigned char>& recv, std::vector<std::size_t>& recv_offsets) override;
+
+private:
+    // Send 'blocks[r]' (pointer, size) to every peer r, receive theirs, and
+    // lay all blocks out in rank order as 'allgather' does.
+    void exchange(const std::vector<std::pair<const unsigned char*, std::size_t>>& blocks,
+                  std::vector<unsigned char>& out, std::vector<std::size_t>& offsets);
+
+    int rank_ {0};
+    int size_ {1};
+    std::vector<int> fds_; // stream to each rank; -1 for this one
+    std::vector<std::vector<unsigned char>> inbox_;
+    std::string error_;
+};
+
+} // namespace orbitsimlite
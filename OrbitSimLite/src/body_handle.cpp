@@ -0,0 +1,64 @@
+// OrbitSimLite - HandleTable implementation
+#include "body_handle.hpp"
+
+namespace orbitsimlite {
+
+BodyHandle HandleTable::insert() {
+    std::uint32_t slot;
+    if (free_.empty()) {
+        slot = static_cast<std::uint32_t>(slots_.size());
+        slots_.push_back(Slot{0, 0});
+    } else {
+        slot = free_.back();
+        free_.pop_back();
+    }
+    slots_[slot].dense = static_cast<std::uint32_t>(dense_.size());
+    dense_.push_back(slot);
+    return BodyHandle{slot, slots_[slot].generation};
+}
+
+void HandleTable::erase_at(std::size_t index) {
+    const std::uint32_t slot = dense_[index];
+    const std::uint32_t moved = dense_.back();
+    dense_[index] = moved;
+    slots_[moved].dense = static_cast<std::uint32_t>(index);
+    dense_.pop_back();
+
+    ++slots_[slot].generation;
+    free_.push_back(slot);
+}
+
+std::size_t HandleTable::index_of(BodyHandle h) const {
+    if (h.slot >= slots_.size()) return npos;
+    const Slot& s = slots_[h.slot];
+    // A free slot's generation has already moved on, and the dense entry
+    // check rejects slots that were never handed out with this generation.
+    if (s.generation != h.generation || s.dense >= dense_.size() || dense_[s.dense] != h.slot) return npos;
+    return s.dense;
+}
+
+BodyHandle HandleTable::handle_at(std::size_t index) const {
+    const std::uint32_t slot = dense_[index];
+    return BodyHandle{slot, slots_[slot].generation};
+}
+
+void HandleTable::permute(const std::vector<std::size_t>& order) {
+    std::vector<std::uint32_t> dense(dense_.size());
+    for (std::size_t k = 0; k < dense.size(); ++k) {
+        dense[k] = dense_[order[k]];
+        slots_[dense[k]].dense = static_cast<std::uint32_t>(k);
+    }
+    dense_.swap(dense);
+}
+
+void HandleTable::reset(std::size_t n) {
+    for (std::uint32_t slot : dense_) {
+        ++slots_[slot].generation;
+        free_.push_back(slot);
+    }
+    dense_.clear();
+    dense_.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) insert();
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,46 @@
+// OrbitSimLite - Quintic Hermite interpolation
+#include "dense_output.hpp"
+
+namespace orbitsimlite {
+
+// Basis on [0, 1] for p(0) = x0, p'(0) = v0, p''(0) = a0 and the same at 1
+// (derivatives with respect to f, i.e. scaled by h and h^2).
+void interpolate_state(const Body& start, const Body& end, double h, double f, Vec2& pos, Vec2& vel, Vec2& acc) {
+    const double s = f;
+    const double s2 = s * s;
+    const double s3 = s2 * s;
+    const double s4 = s3 * s;
+    const double s5 = s4 * s;
+
+    const Vec2 x0 = start.pos;
+    const Vec2 v0 = h * start.vel;
+    const Vec2 a0 = (h * h) * start.acc;
+    const Vec2 x1 = end.pos;
+    const Vec2 v1 = h * end.vel;
+    const Vec2 a1 = (h * h) * end.acc;
+
+    pos = (1.0 - 10.0 * s3 + 15.0 * s4 - 6.0 * s5) * x0 + (s - 6.0 * s3 + 8.0 * s4 - 3.0 * s5) * v0 +
+          (0.5 * s2 - 1.5 * s3 + 1.5 * s4 - 0.5 * s5) * a0 + (0.5 * s3 - s4 + 0.5 * s5) * a1 +
+          (-4.0 * s3 + 7.0 * s4 - 3.0 * s5) * v1 + (10.0 * s3 - 15.0 * s4 + 6.0 * s5) * x1;
+
+    const Vec2 dp = (-30.0 * s2 + 60.0 * s3 - 30.0 * s4) * x0 + (1.0 - 18.0 * s2 + 32.0 * s3 - 15.0 * s4) * v0 +
+                    (s - 4.5 * s2 + 6.0 * s3 - 2.5 * s4) * a0 + (1.5 * s2 - 4.0 * s3 + 2.5 * s4) * a1 +
+                    (-12.0 * s2 + 28.0 * s3 - 15.0 * s4) * v1 + (30.0 * s2 - 60.0 * s3 + 30.0 * s4) * x1;
+
+    const Vec2 ddp = (-60.0 * s + 180.0 * s2 - 120.0 * s3) * x0 + (-36.0 * s + 96.0 * s2 - 60.0 * s3) * v0 +
+                     (1.0 - 9.0 * s + 18.0 * s2 - 10.0 * s3) * a0 + (3.0 * s - 12.0 * s2 + 10.0 * s3) * a1 +
+                     (-24.0 * s + 84.0 * s2 - 60.0 * s3) * v1 + (60.0 * s - 180.0 * s2 + 120.0 * s3) * x1;
+
+    vel = (h > 0.0) ? dp / h : start.vel;
+    acc = (h > 0.0) ? ddp / (h * h) : start.acc;
+}
+
+void interpolate_bodies(const std::vector<Body>& start, const std::vector<Body>& end, double h, double f,
+                        std::vector<Body>& out) {
+    out = end;
+    for (std::size_t i = 0; i < out.size() && i < start.size(); ++i) {
+        interpolate_state(start[i], end[i], h, f, out[i].pos, out[i].vel, out[i].acc);
+    }
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,78 @@
+// OrbitSimLite - DensityMap implementation
+#include "density_map.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace orbitsimlite {
+
+void DensityMap::reset(unsigned cols, unsigned rows, std::size_t items, unsigned threshold) {
+    cols_ = cols;
+    rows_ = rows;
+    threshold_ = std::max(1u, threshold);
+    counts_.assign(static_cast<std::size_t>(cols) * rows, 0);
+    cell_of_.assign(items, kOutside);
+    pixels_.assign(counts_.size() * 4, 0);
+    // Everything changed.
+    dirty_x0_ = 0;
+    dirty_y0_ = 0;
+    dirty_x1_ = cols;
+    dirty_y1_ = rows;
+}
+
+int DensityMap::cell_at(int cx, int cy) const {
+    if (cx < 0 || cy < 0 || cx >= static_cast<int>(cols_) || cy >= static_cast<int>(rows_)) return kOutside;
+    return cy * static_cast<int>(cols_) + cx;
+}
+
+void DensityMap::place(std::size_t item, int cell) {
+    const int old = cell_of_[item];
+    if (old == cell) return;
+    if (old != kOutside) {
+        --counts_[static_cast<std::size_t>(old)];
+        touch(old);
+    }
+    if (cell != kOutside) {
+        ++counts_[static_cast<std::size_t>(cell)];
+        touch(cell);
+    }
+    cell_of_[item] = cell;
+}
+
+void DensityMap::clear_dirty() {
+    dirty_x0_ = dirty_y0_ = 0;
+    dirty_x1_ = dirty_y1_ = 0;
+}
+
+// Recolour one cell and grow the dirty box. Cells below the threshold stay
+// transparent (their items are drawn individually); above it the colour runs
+// from dim blue to white with the logarithm of the count.
+void DensityMap::touch(int cell) {
+    const std::uint32_t n = counts_[static_cast<std::size_t>(cell)];
+    std::uint8_t* px = &pixels_[static_cast<std::size_t>(cell) * 4];
+    if (n < threshold_) {
+        px[0] = px[1] = px[2] = px[3] = 0;
+    } else {
+        const double t = std::min(1.0, std::log2(1.0 + n - threshold_) / 8.0);
+        px[0] = static_cast<std::uint8_t>(60 + 195 * t);
+        px[1] = static_cast<std::uint8_t>(90 + 165 * t);
+        px[2] = 255;
+        px[3] = static_cast<std::uint8_t>(120 + 135 * t);
+    }
+
+    const unsigned x = static_cast<unsigned>(cell) % cols_;
+    const unsigned y = static_cast<unsigned>(cell) / cols_;
+    if (!dirty()) {
+        dirty_x0_ = x;
+        dirty_y0_ = y;
+        dirty_x1_ = x + 1;
+        dirty_y1_ = y + 1;
+        return;
+    }
+    dirty_x0_ = std::min(dirty_x0_, x);
+    dirty_y0_ = std::min(dirty_y0_, y);
+    dirty_x1_ = std::max(dirty_x1_, x + 1);
+    dirty_y1_ = std::max(dirty_y1_, y + 1);
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,37 @@
+// OrbitSimLite - Diagnostics implementation
+#include "diagnostics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace orbitsimlite {
+
+Diagnostics compute_diagnostics(const std::vector<Body>& bodies, double potential_energy) {
+    Diagnostics d;
+    Vec2 mass_pos{0.0, 0.0};
+
+    for (const auto& b : bodies) {
+        d.total_mass += b.mass;
+        d.kinetic_energy += 0.5 * b.mass * b.vel.length_squared();
+        d.linear_momentum += b.mass * b.vel;
+        // 2D cross product r x (m v) gives the z-component of L.
+        d.angular_momentum += b.mass * (b.pos.x * b.vel.y - b.pos.y * b.vel.x);
+        mass_pos += b.mass * b.pos;
+    }
+
+    d.potential_energy = potential_energy;
+    d.total_energy = d.kinetic_energy + d.potential_energy;
+
+    if (d.total_mass > 0.0) {
+        d.center_of_mass = mass_pos / d.total_mass;
+        d.center_of_mass_velocity = d.linear_momentum / d.total_mass;
+    }
+    return d;
+}
+
+double relative_drift(double value, double reference) {
+    const double denom = std::max(std::abs(reference), 1e-300);
+    return std::abs(value - reference) / denom;
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,231 @@
+// OrbitSimLite - Domain decomposition
+#include "domain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "spatial_order.hpp"
+
+namespace orbitsimlite {
+
+namespace {
+
+// The decomposition works on the top 14 bits of the 32-bit Morton key: a
+// 128 x 128 grid over the bounding box, 64 KiB of counts per rank.
+constexpr int kHistogramBits = 14;
+constexpr std::size_t kBins = std::size_t {1} << kHistogramBits;
+constexpr std::size_t kNoBin = kBins;
+
+// Gathered blocks of plain values, read back with memcpy.
+template <class T>
+void gather(Transport& transport, const std::vector<T>& mine, std::vector<unsigned char>& all,
+            std::vector<std::size_t>& offsets) {
+    transport.allgather(mine.data(), mine.size() * sizeof(T), all, offsets);
+}
+
+template <class T>
+T read(const unsigned char* at) {
+    T value;
+    std::memcpy(&value, at, sizeof(T));
+    return value;
+}
+
+template <class T>
+void append(std::vector<unsigned char>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+struct Box {
+    double x0, x1, y0, y1;
+
+    void add(double x, double y) {
+        if (!std::isfinite(x) || !std::isfinite(y)) return;
+        x0 = std::min(x0, x);
+        x1 = std::max(x1, x);
+        y0 = std::min(y0, y);
+        y1 = std::max(y1, y);
+    }
+};
+
+// Histogram bin of a position, quantised in 'box' as spatial_order does.
+std::size_t bin_of(const Box& box, double scale, double x, double y) {
+    if (!std::isfinite(x) || !std::isfinite(y)) return kNoBin;
+    const double cx = std::clamp((x - box.x0) * scale, 0.0, 65535.0);
+    const double cy = std::clamp((y - box.y0) * scale, 0.0, 65535.0);
+    return morton_key(static_cast<std::uint32_t>(cx), static_cast<std::uint32_t>(cy)) >> (32 - kHistogramBits);
+}
+
+} // namespace
+
+void assign_domains(const std::vector<Body>& bodies, const TestParticles& tracers, Transport& transport,
+                    std::vector<int>& body_rank, std::vector<int>& tracer_rank) {
+    const int ranks = transport.size();
+    const int me = transport.rank();
+    body_rank.assign(bodies.size(), me);
+    tracer_rank.assign(tracers.size(), me);
+
+    // 1. Bounding box of the whole system.
+    constexpr double inf = std::numeric_limits<double>::infinity();
+    Box local {inf, -inf, inf, -inf};
+    for (const Body& b : bodies) local.add(b.pos.x, b.pos.y);
+    for (std::size_t k = 0; k < tracers.size(); ++k) local.add(tracers.x[k], tracers.y[k]);
+    std::vector<unsigned char> all;
+    std::vector<std::size_t> offsets;
+    gather(transport, std::vector<Box> {local}, all, offsets);
+    Box box = local;
+    for (int r = 0; r < ranks; ++r) {
+        const Box other = read<Box>(all.data() + offsets[static_cast<std::size_t>(r)]);
+        box.x0 = std::min(box.x0, other.x0);
+        box.x1 = std::max(box.x1, other.x1);
+        box.y0 = std::min(box.y0, other.y0);
+        box.y1 = std::max(box.y1, other.y1);
+    }
+    if (!(box.x0 <= box.x1)) return; // nothing with a finite position anywhere
+    const double extent = std::max(box.x1 - box.x0, box.y1 - box.y0);
+    const double scale = (extent > 0.0) ? 65535.0 / extent : 0.0;
+
+    // 2. Global histogram along the curve.
+    std::vector<std::size_t> body_bin(bodies.size());
+    std::vector<std::size_t> tracer_bin(tracers.size());
+    std::vector<std::uint32_t> counts(kBins, 0);
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        body_bin[i] = bin_of(box, scale, bodies[i].pos.x, bodies[i].pos.y);
+        if (body_bin[i] != kNoBin) ++counts[body_bin[i]];
+    }
+    for (std::size_t k = 0; k < tracers.size(); ++k) {
+        tracer_bin[k] = bin_of(box, scale, tracers.x[k], tracers.y[k]);
+        if (tracer_bin[k] != kNoBin) ++counts[tracer_bin[k]];
+    }
+    gather(transport, counts, all, offsets);
+    std::vector<std::uint64_t> total(kBins, 0);
+    for (int r = 0; r < ranks; ++r) {
+        const unsigned char* from = all.data() + offsets[static_cast<std::size_t>(r)];
+        for (std::size_t b = 0; b < kBins; ++b) total[b] += read<std::uint32_t>(from + b * sizeof(std::uint32_t));
+    }
+
+    // 3. Rank r owns the bins from first_bin[r]: the first bin with at least
+    // r / ranks of all targets before it.
+    std::uint64_t count = 0;
+    for (std::uint64_t c : total) count += c;
+    std::vector<std::size_t> first_bin(static_cast<std::size_t>(ranks) + 1, kBins);
+    first_bin[0] = 0;
+    std::uint64_t before = 0;
+    std::size_t r = 1;
+    for (std::size_t b = 0; b < kBins && r < static_cast<std::size_t>(ranks); ++b) {
+        while (r < static_cast<std::size_t>(ranks) && before * static_cast<std::uint64_t>(ranks) >= r * count) {
+            first_bin[r++] = b;
+        }
+        before += total[b];
+    }
+    auto owner = [&](std::size_t bin) {
+        if (bin == kNoBin) return me;
+        return static_cast<int>(std::upper_bound(first_bin.begin() + 1, first_bin.end() - 1, bin) -
+                                (first_bin.begin() + 1));
+    };
+    for (std::size_t i = 0; i < bodies.size(); ++i) body_rank[i] = owner(body_bin[i]);
+    for (std::size_t k = 0; k < tracers.size(); ++k) tracer_rank[k] = owner(tracer_bin[k]);
+}
+
+// Message to each rank: tracer count, body count, the tracers as six
+// doubles each, then every body as its bytes followed by its name.
+void migrate_to_domains(const std::vector<Body>& bodies, const TestParticles& tracers,
+                        const std::vector<int>& body_rank, const std::vector<int>& tracer_rank, Transport& transport,
+                        std::vector<Body>& arrived, TestParticles& arrived_tracers) {
+    const int ranks = transport.size();
+    const int me = transport.rank();
+    std::vector<unsigned char> send;
+    std::vector<std::size_t> send_offsets(1, 0);
+    for (int dest = 0; dest < ranks; ++dest) {
+        std::uint64_t tracer_count = 0, body_count = 0;
+        if (dest != me) {
+            tracer_count = static_cast<std::uint64_t>(std::count(tracer_rank.begin(), tracer_rank.end(), dest));
+            body_count = static_cast<std::uint64_t>(std::count(body_rank.begin(), body_rank.end(), dest));
+        }
+        append(send, tracer_count);
+        append(send, body_count);
+        for (std::size_t k = 0; k < tracers.size() && tracer_count > 0; ++k) {
+            if (tracer_rank[k] != dest) continue;
+            for (double v : {tracers.x[k], tracers.y[k], tracers.vx[k], tracers.vy[k], tracers.ax[k], tracers.ay[k]}) {
+                append(send, v);
+            }
+        }
+        for (std::size_t i = 0; i < bodies.size() && body_count > 0; ++i) {
+            if (body_rank[i] != dest) continue;
+            append(send, bodies[i]);
+            const std::string& name = bodies[i].name();
+            append(send, static_cast<std::uint32_t>(name.size()));
+            send.insert(send.end(), name.begin(), name.end());
+        }
+        send_offsets.push_back(send.size());
+    }
+
+    std::vector<unsigned char> recv;
+    std::vector<std::size_t> recv_offsets;
+    transport.alltoall(send, send_offsets, recv, recv_offsets);
+
+    for (int from = 0; from < ranks; ++from) {
+        const unsigned char* at = recv.data() + recv_offsets[static_cast<std::size_t>(from)];
+        const auto tracer_count = read<std::uint64_t>(at);
+        const auto body_count = read<std::uint64_t>(at + sizeof(std::uint64_t));
+        at += 2 * sizeof(std::uint64_t);
+        for (std::uint64_t k = 0; k < tracer_count; ++k) {
+            double v[6];
+            std::memcpy(v, at, sizeof(v));
+            at += sizeof(v);
+            arrived_tracers.add(Vec2{v[0], v[1]}, Vec2{v[2], v[3]});
+            arrived_tracers.ax.back() = v[4];
+            arrived_tracers.ay.back() = v[5];
+        }
+        for (std::uint64_t i = 0; i < body_count; ++i) {
+            Body b = read<Body>(at);
+            at += sizeof(Body);
+            const auto length = read<std::uint32_t>(at);
+            at += sizeof(std::uint32_t);
+            b.set_name(std::string(reinterpret_cast<const char*>(at), length));
+            at += length;
+            arrived.push_back(b);
+        }
+    }
+}
+
+Diagnostics reduce_diagnostics(const Diagnostics& local, Transport& transport) {
+    const double m = local.total_mass;
+    const std::vector<double> mine {local.total_mass,
+                                    local.kinetic_energy,
+                                    local.potential_energy,
+                                    local.linear_momentum.x,
+                                    local.linear_momentum.y,
+                                    local.angular_momentum,
+                                    m * local.center_of_mass.x,
+                                    m * local.center_of_mass.y,
+                                    m * local.center_of_mass_velocity.x,
+                                    m * local.center_of_mass_velocity.y};
+    std::vector<unsigned char> all;
+    std::vector<std::size_t> offsets;
+    gather(transport, mine, all, offsets);
+    std::vector<double> sum(mine.size(), 0.0);
+    for (int r = 0; r < transport.size(); ++r) {
+        const unsigned char* from = all.data() + offsets[static_cast<std::size_t>(r)];
+        for (std::size_t k = 0; k < sum.size(); ++k) sum[k] += read<double>(from + k * sizeof(double));
+    }
+
+    Diagnostics d;
+    d.total_mass = sum[0];
+    d.kinetic_energy = sum[1];
+    d.potential_energy = sum[2];
+    d.total_energy = d.kinetic_energy + d.potential_energy;
+    d.linear_momentum = Vec2{sum[3], sum[4]};
+    d.angular_momentum = sum[5];
+    if (d.total_mass > 0.0) {
+        d.center_of_mass = Vec2{sum[6], sum[7]} / d.total_mass;
+        d.center_of_mass_velocity = Vec2{sum[8], sum[9]} / d.total_mass;
+    }
+    return d;
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,321 @@
+// OrbitSimLite - Ensemble implementation
+//
+// The lane kernels below mirror ForceKernel / EulerIntegration /
+// RK4Integration operation for operation (same summation order, same
+// expression grouping), so every member reproduces the corresponding
+// Simulator run exactly. Only the loop nesting differs: the member loop is
+// innermost.
+#include "ensemble.hpp"
+
+#include "pipeline.hpp"
+
+namespace orbitsimlite {
+
+Ensemble::Ensemble(const std::vector<Body>& prototype, std::size_t members,
+                   double G, double dt, Integrator integrator, unsigned threads)
+    : prototype_(prototype), members_(members), G_(G), dt_(dt), integrator_(integrator) {
+    const std::size_t n = prototype_.size();
+    mass_.resize(n * members_);
+    x_.resize(n * members_);
+    y_.resize(n * members_);
+    vx_.resize(n * members_);
+    vy_.resize(n * members_);
+    ax_.assign(n * members_, 0.0);
+    ay_.assign(n * members_, 0.0);
+    e2_.resize(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const Body& b = prototype_[i];
+        e2_[i] = b.softening * b.softening;
+        for (std::size_t m = 0; m < members_; ++m) {
+            mass_[at(m, i)] = b.mass;
+            x_[at(m, i)] = b.pos.x;
+            y_[at(m, i)] = b.pos.y;
+            vx_[at(m, i)] = b.vel.x;
+            vy_[at(m, i)] = b.vel.y;
+        }
+    }
+    set_threads(threads);
+}
+
+std::size_t Ensemble::member_count() const { return members_; }
+std::size_t Ensemble::body_count() const { return prototype_.size(); }
+
+// Per-member state -----------------------------------------------------------
+
+double Ensemble::mass(std::size_t member, std::size_t body) const { return mass_[at(member, body)]; }
+
+Vec2 Ensemble::position(std::size_t member, std::size_t body) const {
+    return Vec2{x_[at(member, body)], y_[at(member, body)]};
+}
+
+Vec2 Ensemble::velocity(std::size_t member, std::size_t body) const {
+    return Vec2{vx_[at(member, body)], vy_[at(member, body)]};
+}
+
+Vec2 Ensemble::acceleration(std::size_t member, std::size_t body) const {
+    return Vec2{ax_[at(member, body)], ay_[at(member, body)]};
+}
+
+void Ensemble::set_mass(std::size_t member, std::size_t body, double m) {
+    mass_[at(member, body)] = m;
+    forces_valid_ = false;
+}
+
+void Ensemble::set_position(std::size_t member, std::size_t body, const Vec2& p) {
+    x_[at(member, body)] = p.x;
+    y_[at(member, body)] = p.y;
+    forces_valid_ = false;
+}
+
+void Ensemble::set_velocity(std::size_t member, std::size_t body, const Vec2& v) {
+    vx_[at(member, body)] = v.x;
+    vy_[at(member, body)] = v.y;
+    forces_valid_ = false;
+}
+
+void Ensemble::set_member(std::size_t member, const std::vector<Body>& bodies) {
+    for (std::size_t i = 0; i < prototype_.size() && i < bodies.size(); ++i) {
+        mass_[at(member, i)] = bodies[i].mass;
+        x_[at(member, i)] = bodies[i].pos.x;
+        y_[at(member, i)] = bodies[i].pos.y;
+        vx_[at(member, i)] = bodies[i].vel.x;
+        vy_[at(member, i)] = bodies[i].vel.y;
+    }
+    forces_valid_ = false;
+}
+
+std::vector<Body> Ensemble::member_bodies(std::size_t member) const {
+    std::vector<Body> bodies = prototype_;
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        bodies[i].mass = mass(member, i);
+        bodies[i].pos = position(member, i);
+        bodies[i].vel = velocity(member, i);
+        bodies[i].acc = acceleration(member, i);
+    }
+    return bodies;
+}
+
+Diagnostics Ensemble::diagnostics(std::size_t member) const {
+    const std::vector<Body> bodies = member_bodies(member);
+    return compute_diagnostics(bodies, ForceKernel<NewtonianGravity>{}.potential(bodies, G_));
+}
+
+// Parameters -----------------------------------------------------------------
+
+void Ensemble::set_dt(double dt) { dt_ = dt; }
+double Ensemble::get_dt() const { return dt_; }
+
+void Ensemble::set_substeps(int n) { substeps_ = (n > 0) ? n : 1; }
+int Ensemble::get_substeps() const { return substeps_; }
+
+void Ensemble::set_integrator(Integrator i) { integrator_ = i; }
+Integrator Ensemble::get_integrator() const { return integrator_; }
+
+void Ensemble::set_threads(unsigned threads) { pool_ = std::make_unique<ThreadPool>(threads); }
+unsigned Ensemble::get_threads() const { return pool_->size(); }
+
+double Ensemble::get_time() const { return time_; }
+
+// Stepping -------------------------------------------------------------------
+
+void Ensemble::step() { run(1); }
+
+void Ensemble::run(int steps) {
+    if (steps <= 0) return;
+    const int n = (substeps_ > 0) ? substeps_ : 1;
+    const double h = dt_ / static_cast<double>(n);
+    const bool refresh = !forces_valid_;
+    if (integrator_ == Integrator::RK4) rk4_.resize(x_.size(), members_);
+
+    if (members_ > 0 && !prototype_.empty()) {
+        pool_->parallel_for(members_, [&](std::size_t m0, std::size_t m1) {
+            switch (integrator_) {
+            case Integrator::Euler:
+                if (refresh) compute_accelerations(m0, m1);
+                for (int s = 0; s < steps; ++s) advance_euler(m0, m1, h, n);
+                break;
+            case Integrator::RK4:
+                for (int s = 0; s < steps; ++s) advance_rk4(m0, m1, h, n);
+                break;
+            default:
+                advance_scalar(m0, m1, h, n, steps, refresh);
+                break;
+            }
+        });
+    }
+    forces_valid_ = true;
+
+    for (int s = 0; s < steps; ++s) time_ += dt_;
+}
+
+void Ensemble::field(std::size_t self, std::size_t m0, std::size_t len,
+                     const double* px, const double* py, double* ax, double* ay) const {
+    const NewtonianGravity law;
+    for (std::size_t j = 0; j < prototype_.size(); ++j) {
+        if (j == self || prototype_[j].is_test_particle) continue;
+        const double eps2 = 0.5 * (e2_[self] + e2_[j]);
+        const double* xj = &x_[at(m0, j)];
+        const double* yj = &y_[at(m0, j)];
+        const double* mj = &mass_[at(m0, j)];
+        // Branch-free lane loop: one iteration per member.
+        for (std::size_t k = 0; k < len; ++k) {
+            const double dx = xj[k] - px[k];
+            const double dy = yj[k] - py[k];
+            double a, pot;
+            law(dx * dx + dy * dy, eps2, a, pot);
+            const double gm = G_ * mj[k];
+            ax[k] += gm * (dx * a);
+            ay[k] += gm * (dy * a);
+        }
+    }
+}
+
+void Ensemble::compute_accelerations(std::size_t m0, std::size_t m1) {
+    const std::size_t len = m1 - m0;
+    for (std::size_t i = 0; i < prototype_.size(); ++i) {
+        double* ax = &ax_[at(m0, i)];
+        double* ay = &ay_[at(m0, i)];
+        for (std::size_t k = 0; k < len; ++k) {
+            ax[k] = 0.0;
+            ay[k] = 0.0;
+        }
+        field(i, m0, len, &x_[at(m0, i)], &y_[at(m0, i)], ax, ay);
+    }
+}
+
+// Symplectic Euler, as EulerIntegration.
+void Ensemble::advance_euler(std::size_t m0, std::size_t m1, double h, int n) {
+    const std::size_t len = m1 - m0;
+    for (int s = 0; s < n; ++s) {
+        for (std::size_t i = 0; i < prototype_.size(); ++i) {
+            const std::size_t base = at(m0, i);
+            for (std::size_t k = base; k < base + len; ++k) {
+                vx_[k] += ax_[k] * h;
+                vy_[k] += ay_[k] * h;
+                x_[k] += vx_[k] * h;
+                y_[k] += vy_[k] * h;
+            }
+        }
+        compute_accelerations(m0, m1);
+    }
+}
+
+void Ensemble::RK4Scratch::resize(std::size_t state, std::size_t members) {
+    for (auto* v : {&next_x, &next_y, &next_vx, &next_vy}) v->resize(state);
+    for (auto* v : {&sx, &sy, &k1vx, &k1vy, &k2vx, &k2vy, &k3vx, &k3vy, &k4vx, &k4vy}) v->resize(members);
+}
+
+// Frozen-others RK4, as RK4Integration.
+void Ensemble::advance_rk4(std::size_t m0, std::size_t m1, double h, int n) {
+    const std::size_t count = prototype_.size();
+    const std::size_t len = m1 - m0;
+
+    // This block's slices of the scratch buffers: probe position and the
+    // four stage slopes.
+    double* sx = &rk4_.sx[m0];
+    double* sy = &rk4_.sy[m0];
+    double* k1vx = &rk4_.k1vx[m0];
+    double* k1vy = &rk4_.k1vy[m0];
+    double* k2vx = &rk4_.k2vx[m0];
+    double* k2vy = &rk4_.k2vy[m0];
+    double* k3vx = &rk4_.k3vx[m0];
+    double* k3vy = &rk4_.k3vy[m0];
+    double* k4vx = &rk4_.k4vx[m0];
+    double* k4vy = &rk4_.k4vy[m0];
+
+    auto slope = [&](std::size_t i, double* kx, double* ky) {
+        for (std::size_t k = 0; k < len; ++k) {
+            kx[k] = 0.0;
+            ky[k] = 0.0;
+        }
+        field(i, m0, len, sx, sy, kx, ky);
+    };
+
+    for (int s = 0; s < n; ++s) {
+        for (std::size_t i = 0; i < count; ++i) {
+            const double* x0 = &x_[at(m0, i)];
+            const double* y0 = &y_[at(m0, i)];
+            const double* vx0 = &vx_[at(m0, i)];
+            const double* vy0 = &vy_[at(m0, i)];
+            double* next_x = &rk4_.next_x[at(m0, i)];
+            double* next_y = &rk4_.next_y[at(m0, i)];
+            double* next_vx = &rk4_.next_vx[at(m0, i)];
+            double* next_vy = &rk4_.next_vy[at(m0, i)];
+
+            for (std::size_t k = 0; k < len; ++k) {
+                sx[k] = x0[k];
+                sy[k] = y0[k];
+            }
+            slope(i, k1vx, k1vy);
+
+            for (std::size_t k = 0; k < len; ++k) {
+                sx[k] = x0[k] + vx0[k] * (0.5 * h);
+                sy[k] = y0[k] + vy0[k] * (0.5 * h);
+            }
+            slope(i, k2vx, k2vy);
+
+            for (std::size_t k = 0; k < len; ++k) {
+                sx[k] = x0[k] + (vx0[k] + k1vx[k] * (0.5 * h)) * (0.5 * h);
+                sy[k] = y0[k] + (vy0[k] + k1vy[k] * (0.5 * h)) * (0.5 * h);
+            }
+            slope(i, k3vx, k3vy);
+
+            for (std::size_t k = 0; k < len; ++k) {
+                sx[k] = x0[k] + (vx0[k] + k2vx[k] * (0.5 * h)) * h;
+                sy[k] = y0[k] + (vy0[k] + k2vy[k] * (0.5 * h)) * h;
+            }
+            slope(i, k4vx, k4vy);
+
+            const double w = h / 6.0;
+            for (std::size_t k = 0; k < len; ++k) {
+                const double k2x = vx0[k] + k1vx[k] * (0.5 * h);
+                const double k2y = vy0[k] + k1vy[k] * (0.5 * h);
+                const double k3x = vx0[k] + k2vx[k] * (0.5 * h);
+                const double k3y = vy0[k] + k2vy[k] * (0.5 * h);
+                const double k4x = vx0[k] + k3vx[k] * h;
+                const double k4y = vy0[k] + k3vy[k] * h;
+                next_vx[k] = vx0[k] + (k1vx[k] + k2vx[k] * 2.0 + k3vx[k] * 2.0 + k4vx[k]) * w;
+                next_vy[k] = vy0[k] + (k1vy[k] + k2vy[k] * 2.0 + k3vy[k] * 2.0 + k4vy[k]) * w;
+                next_x[k] = x0[k] + (vx0[k] + k2x * 2.0 + k3x * 2.0 + k4x) * w;
+                next_y[k] = y0[k] + (vy0[k] + k2y * 2.0 + k3y * 2.0 + k4y) * w;
+            }
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::size_t base = at(m0, i);
+            for (std::size_t k = base; k < base + len; ++k) {
+                x_[k] = rk4_.next_x[k];
+                y_[k] = rk4_.next_y[k];
+                vx_[k] = rk4_.next_vx[k];
+                vy_[k] = rk4_.next_vy[k];
+            }
+        }
+    }
+    compute_accelerations(m0, m1);
+}
+
+// Members that need the general pipeline are stepped one at a time.
+void Ensemble::advance_scalar(std::size_t m0, std::size_t m1, double h, int n, int steps, bool refresh) {
+    Pipeline<WisdomHolmanIntegration> pipeline;
+    TestParticles none;
+    std::vector<Body> bodies = prototype_;
+    for (std::size_t m = m0; m < m1; ++m) {
+        for (std::size_t i = 0; i < bodies.size(); ++i) {
+            bodies[i].mass = mass_[at(m, i)];
+            bodies[i].pos = Vec2{x_[at(m, i)], y_[at(m, i)]};
+            bodies[i].vel = Vec2{vx_[at(m, i)], vy_[at(m, i)]};
+            bodies[i].acc = Vec2{ax_[at(m, i)], ay_[at(m, i)]};
+        }
+        if (refresh) pipeline.refresh(bodies, none, G_);
+        for (int s = 0; s < steps; ++s) pipeline.advance(bodies, none, G_, h, n);
+        for (std::size_t i = 0; i < bodies.size(); ++i) {
+            x_[at(m, i)] = bodies[i].pos.x;
+            y_[at(m, i)] = bodies[i].pos.y;
+            vx_[at(m, i)] = bodies[i].vel.x;
+            vy_[at(m, i)] = bodies[i].vel.y;
+            ax_[at(m, i)] = bodies[i].acc.x;
+            ay_[at(m, i)] = bodies[i].acc.y;
+        }
+    }
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,61 @@
+// OrbitSimLite - Event condition helpers
+#include "events.hpp"
+
+#include <cmath>
+#include <limits>
+
+#include "simulator_base.hpp"
+
+namespace orbitsimlite {
+
+namespace {
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+// Radial velocity of 'body' relative to 'other', scaled by the distance.
+EventFunction radial_velocity(const SimulatorBase& sim, BodyHandle body, BodyHandle other) {
+    const SimulatorBase* s = &sim;
+    return [s, body, other](const std::vector<Body>& bodies) {
+        const std::size_t i = s->index_of(body);
+        const std::size_t j = s->index_of(other);
+        if (i >= bodies.size() || j >= bodies.size()) return kNaN;
+        return Vec2::dot(bodies[i].pos - bodies[j].pos, bodies[i].vel - bodies[j].vel);
+    };
+}
+
+} // namespace
+
+EventCondition distance_minimum(const SimulatorBase& sim, BodyHandle body, BodyHandle other) {
+    return EventCondition{radial_velocity(sim, body, other), EventDirection::Rising};
+}
+
+EventCondition distance_maximum(const SimulatorBase& sim, BodyHandle body, BodyHandle other) {
+    return EventCondition{radial_velocity(sim, body, other), EventDirection::Falling};
+}
+
+EventCondition escape(const SimulatorBase& sim, BodyHandle body, BodyHandle primary) {
+    const SimulatorBase* s = &sim;
+    auto energy = [s, body, primary](const std::vector<Body>& bodies) {
+        const std::size_t i = s->index_of(body);
+        const std::size_t j = s->index_of(primary);
+        if (i >= bodies.size() || j >= bodies.size()) return kNaN;
+        const double r = (bodies[i].pos - bodies[j].pos).length();
+        const double mu = s->get_gravity() * (bodies[i].mass + bodies[j].mass);
+        return 0.5 * (bodies[i].vel - bodies[j].vel).length_squared() - ((r > 0.0) ? mu / r : 0.0);
+    };
+    return EventCondition{energy, EventDirection::Rising};
+}
+
+EventCondition line_crossing(const SimulatorBase& sim, BodyHandle body, const Vec2& point, const Vec2& direction,
+                             EventDirection which) {
+    const SimulatorBase* s = &sim;
+    auto side = [s, body, point, direction](const std::vector<Body>& bodies) {
+        const std::size_t i = s->index_of(body);
+        if (i >= bodies.size()) return kNaN;
+        const Vec2 d = bodies[i].pos - point;
+        return direction.x * d.y - direction.y * d.x;
+    };
+    return EventCondition{side, which};
+}
+
+} // namespace orbitsimlite
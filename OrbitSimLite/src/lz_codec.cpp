@@ -0,0 +1,123 @@
+// OrbitSimLite - LZ77 block codec implementation
+#include "lz_codec.hpp"
+
+#include <cstring>
+#include <limits>
+
+namespace orbitsimlite {
+
+namespace {
+
+constexpr std::size_t kMinMatch = 4;
+constexpr unsigned kHashBits = 14;
+constexpr std::size_t kMaxOffset = 1u << 16;
+constexpr std::size_t kMaxMatch = 1u << 16;
+
+std::uint32_t load32(const std::uint8_t* p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+std::uint32_t hash4(std::uint32_t v) { return (v * 2654435761u) >> (32 - kHashBits); }
+
+} // namespace
+
+void put_varint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+bool get_varint(const std::uint8_t* src, std::size_t size, std::size_t& at, std::uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (at >= size) return false;
+        const std::uint8_t byte = src[at++];
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+void lz_compress(const std::uint8_t* src, std::size_t size, std::vector<std::uint8_t>& out) {
+    // Positions are stored + 1 so that zero means "empty".
+    std::vector<std::uint32_t> table(std::size_t(1) << kHashBits, 0);
+
+    std::size_t anchor = 0; // first byte not yet emitted
+    std::size_t i = 0;
+    while (size >= kMinMatch && i + kMinMatch <= size) {
+        const std::uint32_t seq = load32(src + i);
+        const std::uint32_t h = hash4(seq);
+        const std::size_t cand = table[h];
+        table[h] = static_cast<std::uint32_t>(i + 1);
+
+        if (cand == 0 || i + 1 - cand > kMaxOffset || load32(src + cand - 1) != seq) {
+            ++i;
+            continue;
+        }
+
+        const std::size_t from = cand - 1;
+        std::size_t len = kMinMatch;
+        while (i + len < size && len < kMaxMatch && src[from + len] == src[i + len]) ++len;
+
+        put_varint(out, i - anchor);
+        out.insert(out.end(), src + anchor, src + i);
+        put_varint(out, i - from);
+        put_varint(out, len - kMinMatch);
+
+        // Seed the table inside the match sparsely; enough for runs.
+        const std::size_t end = i + len;
+        for (std::size_t k = i + 1; k + kMinMatch <= size && k < end; k += 2) {
+            table[hash4(load32(src + k))] = static_cast<std::uint32_t>(k + 1);
+        }
+        i = anchor = end;
+    }
+
+    put_varint(out, size - anchor);
+    out.insert(out.end(), src + anchor, src + size);
+    put_varint(out, 0);
+}
+
+// Every token takes at least three bytes (literal count, offset, length)
+// and adds its literals plus at most kMaxMatch bytes.
+std::size_t lz_max_decompressed_size(std::size_t size) {
+    const std::size_t tokens = size / 3 + 1;
+    constexpr std::size_t unbounded = std::numeric_limits<std::size_t>::max();
+    if (tokens > (unbounded - size) / kMaxMatch) return unbounded;
+    return size + tokens * kMaxMatch;
+}
+
+bool lz_decompress(const std::uint8_t* src, std::size_t size, std::size_t expected_size,
+                   std::vector<std::uint8_t>& out) {
+    out.clear();
+    if (expected_size > lz_max_decompressed_size(size)) return false;
+    out.reserve(expected_size);
+    std::size_t at = 0;
+    for (;;) {
+        std::uint64_t literals = 0;
+        if (!get_varint(src, size, at, literals)) return false;
+        if (literals > size - at || literals > expected_size - out.size()) return false;
+        out.insert(out.end(), src + at, src + at + literals);
+        at += static_cast<std::size_t>(literals);
+
+        std::uint64_t offset = 0;
+        if (!get_varint(src, size, at, offset)) return false;
+        if (offset == 0) break;
+
+        std::uint64_t extra = 0;
+        if (!get_varint(src, size, at, extra)) return false;
+        if (extra > kMaxMatch - kMinMatch) return false;
+        const std::uint64_t len = extra + kMinMatch;
+        if (offset > out.size() || len > expected_size - out.size()) return false;
+
+        // Overlapping copies (offset < len) repeat the tail byte by byte.
+        std::size_t from = out.size() - static_cast<std::size_t>(offset);
+        for (std::uint64_t k = 0; k < len; ++k) out.push_back(out[from++]);
+    }
+    return at == size && out.size() == expected_size;
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,57 @@
+// OrbitSimLite - Interned name table implementation
+#include "name_table.hpp"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace orbitsimlite {
+
+namespace {
+
+// std::deque never moves its elements on push_back, so references handed
+// out by 'name_of' and the views used as map keys stay valid.
+struct NameTable {
+    std::shared_mutex mutex;
+    std::deque<std::string> names {std::string()};
+    std::unordered_map<std::string_view, NameId> ids;
+};
+
+NameTable& table() {
+    static NameTable t;
+    return t;
+}
+
+} // namespace
+
+NameId intern_name(std::string_view name) {
+    if (name.empty()) return kNoName;
+    NameTable& t = table();
+    {
+        std::shared_lock<std::shared_mutex> lock(t.mutex);
+        auto it = t.ids.find(name);
+        if (it != t.ids.end()) return it->second;
+    }
+    std::unique_lock<std::shared_mutex> lock(t.mutex);
+    auto it = t.ids.find(name);
+    if (it != t.ids.end()) return it->second;
+    const auto id = static_cast<NameId>(t.names.size());
+    t.names.emplace_back(name);
+    t.ids.emplace(t.names.back(), id);
+    return id;
+}
+
+const std::string& name_of(NameId id) {
+    NameTable& t = table();
+    std::shared_lock<std::shared_mutex> lock(t.mutex);
+    return (id < t.names.size()) ? t.names[id] : t.names[kNoName];
+}
+
+std::size_t interned_name_count() {
+    NameTable& t = table();
+    std::shared_lock<std::shared_mutex> lock(t.mutex);
+    return t.names.size() - 1;
+}
+
+} // namespace orbitsimlite
@@ -4,19 +4,21 @@
 //  - Newtonian gravitational acceleration between point masses
 //  - a symplectic Euler integrator
 //  - an educational Runge–Kutta 4 (RK4) step
+//  - a universal-variable Kepler drift
 //
 // All calculations are performed in double precision using SI units
 // (metres, kilograms, seconds).
 #include "physics.hpp"
 
 #include <algorithm>
+#include <cmath>
+
+#include "force_law.hpp"
 
 namespace orbitsimlite {
 
-// Softening term to avoid numerical singularities when two positions become
-// extremely close. This is intentionally small compared to the astronomical
-// distances used in the demos but prevents division-by-zero.
-static constexpr double kEps2 = 1e-9;
+// Singularity guard shared with NewtonianGravity (see force_law.hpp).
+static constexpr double kEps2 = kSingularityEps2;
 
 Vec2 Physics::acceleration(const Body& target, const std::vector<Body>& others, double G) {
     Vec2 acc{0.0, 0.0};
@@ -78,4 +80,73 @@ void Physics::step_rk4(Body& body, const std::vector<Body>& others, double G, do
     body.acc = acc_at(body.pos);
 }
 
+// Stumpff functions c2(z) = (1 - cos sqrt z) / z and c3(z) = (sqrt z -
+// sin sqrt z) / sqrt(z)^3, continued analytically to z <= 0. A short series
+// is used near zero where the closed forms cancel badly.
+static void stumpff_c2_c3(double z, double& c2, double& c3) {
+    if (std::abs(z) < 1e-2) {
+        c2 = 1.0 / 2.0 - z * (1.0 / 24.0 - z * (1.0 / 720.0 - z * (1.0 / 40320.0 - z / 3628800.0)));
+        c3 = 1.0 / 6.0 - z * (1.0 / 120.0 - z * (1.0 / 5040.0 - z * (1.0 / 362880.0 - z / 39916800.0)));
+    } else if (z > 0.0) {
+        const double sz = std::sqrt(z);
+        c2 = (1.0 - std::cos(sz)) / z;
+        c3 = (sz - std::sin(sz)) / (z * sz);
+    } else {
+        const double sz = std::sqrt(-z);
+        c2 = (std::cosh(sz) - 1.0) / (-z);
+        c3 = (std::sinh(sz) - sz) / (-z * sz);
+    }
+}
+
+void Physics::kepler_drift(Vec2& pos, Vec2& vel, double mu, double dt) {
+    const double r0 = pos.length();
+    if (r0 == 0.0 || mu <= 0.0 || dt == 0.0) {
+        pos += vel * dt;
+        return;
+    }
+
+    const double sqrt_mu = std::sqrt(mu);
+    const double eta0 = Vec2::dot(pos, vel) / sqrt_mu;   // r0 * vr0 / sqrt(mu)
+    const double alpha = 2.0 / r0 - vel.length_squared() / mu; // 1 / a
+    const double zeta0 = 1.0 - alpha * r0;
+
+    // Solve  sqrt(mu) dt = r0 chi + eta0 chi^2 c2 + zeta0 chi^3 c3  for the
+    // universal anomaly chi. F'(chi) is the radius at chi.
+    double chi = sqrt_mu * dt / r0;
+    double c2 = 0.5;
+    double c3 = 1.0 / 6.0;
+    for (int it = 0; it < 50; ++it) {
+        const double chi2 = chi * chi;
+        const double z = alpha * chi2;
+        stumpff_c2_c3(z, c2, c3);
+        const double F = r0 * chi + eta0 * chi2 * c2 + zeta0 * chi2 * chi * c3 - sqrt_mu * dt;
+        const double dF = r0 + eta0 * chi * (1.0 - z * c3) + zeta0 * chi2 * c2;
+        const double ddF = eta0 * (1.0 - z * c2) + zeta0 * chi * (1.0 - z * c3);
+
+        // Laguerre–Conway step (n = 5); converges from poor initial guesses
+        // where plain Newton may oscillate.
+        const double n = 5.0;
+        const double disc = std::sqrt(std::abs((n - 1.0) * (n - 1.0) * dF * dF - n * (n - 1.0) * F * ddF));
+        const double denom = dF + (dF >= 0.0 ? disc : -disc);
+        const double delta = n * F / denom;
+        chi -= delta;
+        if (std::abs(delta) <= 1e-15 * std::max(1.0, std::abs(chi))) break;
+    }
+
+    const double chi2 = chi * chi;
+    stumpff_c2_c3(alpha * chi2, c2, c3);
+    const double r = r0 + eta0 * chi * (1.0 - alpha * chi2 * c3) + zeta0 * chi2 * c2;
+
+    // Gauss f and g functions and their time derivatives.
+    const double f = 1.0 - chi2 * c2 / r0;
+    const double g = dt - chi2 * chi * c3 / sqrt_mu;
+    const double fdot = -sqrt_mu * chi * (1.0 - alpha * chi2 * c3) / (r * r0);
+    const double gdot = 1.0 - chi2 * c2 / r;
+
+    const Vec2 p0 = pos;
+    const Vec2 v0 = vel;
+    pos = f * p0 + g * v0;
+    vel = fdot * p0 + gdot * v0;
+}
+
 } // namespace orbitsimlite
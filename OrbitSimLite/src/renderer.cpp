@@ -1,32 +1,445 @@
 // OrbitSimLite - Renderer implementation (SFML)
 #include "renderer.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <iomanip>
 
+#include "task_queue.hpp"
+
 namespace orbitsimlite {
 
 Renderer::Renderer(unsigned width, unsigned height, double meters_to_pixels)
-    : width_(width), height_(height), scale_(meters_to_pixels) {}
+    : width_(width), height_(height), base_scale_(meters_to_pixels), scale_(meters_to_pixels) {}
+
+// View ----------------------------------------------------------------------
 
 sf::Vector2f Renderer::world_to_screen(const Vec2& p) const {
-    // Place world origin at screen center, +y upwards (SFML y is downwards)
+    // Place 'center_' at screen center, +y upwards (SFML y is downwards)
     float cx = static_cast<float>(width_ / 2.0);
     float cy = static_cast<float>(height_ / 2.0);
-    float x = static_cast<float>(meters_to_pixels(p.x, scale_));
-    float y = static_cast<float>(meters_to_pixels(p.y, scale_));
+    float x = static_cast<float>(meters_to_pixels(p.x - center_.x, scale_));
+    float y = static_cast<float>(meters_to_pixels(p.y - center_.y, scale_));
     return sf::Vector2f{cx + x, cy - y};
 }
 
+Vec2 Renderer::screen_to_world(float sx, float sy) const {
+    const double x = pixels_to_meters(sx - width_ / 2.0, scale_);
+    const double y = pixels_to_meters(height_ / 2.0 - sy, scale_);
+    return Vec2{center_.x + x, center_.y + y};
+}
+
+Renderer::WorldRect Renderer::visible_world(double margin_px) const {
+    const double half_w = pixels_to_meters(width_ / 2.0 + margin_px, scale_);
+    const double half_h = pixels_to_meters(height_ / 2.0 + margin_px, scale_);
+    return WorldRect{center_.x - half_w, center_.y - half_h, center_.x + half_w, center_.y + half_h};
+}
+
+void Renderer::zoom_at(float sx, float sy, double factor) {
+    const Vec2 anchor = screen_to_world(sx, sy);
+    scale_ *= factor;
+    const Vec2 moved = screen_to_world(sx, sy);
+    center_ += anchor - moved;
+}
+
+void Renderer::pan_pixels(float dx, float dy) {
+    center_.x -= pixels_to_meters(dx, scale_);
+    center_.y += pixels_to_meters(dy, scale_);
+}
+
+void Renderer::reset_view() {
+    scale_ = base_scale_;
+    center_ = Vec2{};
+}
+
+bool Renderer::handle_view_event(const sf::Event& event) {
+    const float mid_x = static_cast<float>(width_ / 2.0);
+    const float mid_y = static_cast<float>(height_ / 2.0);
+    switch (event.type) {
+    case sf::Event::MouseWheelScrolled:
+        if (event.mouseWheelScroll.wheel != sf::Mouse::VerticalWheel) return false;
+        zoom_at(static_cast<float>(event.mouseWheelScroll.x), static_cast<float>(event.mouseWheelScroll.y),
+                std::pow(1.2, static_cast<double>(event.mouseWheelScroll.delta)));
+        return true;
+    case sf::Event::MouseButtonPressed:
+        if (event.mouseButton.button != sf::Mouse::Left && event.mouseButton.button != sf::Mouse::Middle) {
+            return false;
+        }
+        dragging_ = true;
+        drag_x_ = event.mouseButton.x;
+        drag_y_ = event.mouseButton.y;
+        return true;
+    case sf::Event::MouseButtonReleased:
+        dragging_ = false;
+        return true;
+    case sf::Event::MouseMoved:
+        if (!dragging_) return false;
+        pan_pixels(static_cast<float>(event.mouseMove.x - drag_x_), static_cast<float>(event.mouseMove.y - drag_y_));
+        drag_x_ = event.mouseMove.x;
+        drag_y_ = event.mouseMove.y;
+        return true;
+    case sf::Event::KeyPressed:
+        switch (event.key.code) {
+        case sf::Keyboard::Add:
+        case sf::Keyboard::Equal:
+            zoom_at(mid_x, mid_y, 1.25);
+            return true;
+        case sf::Keyboard::Subtract:
+        case sf::Keyboard::Hyphen:
+            zoom_at(mid_x, mid_y, 0.8);
+            return true;
+        case sf::Keyboard::Left:
+            pan_pixels(0.1f * width_, 0.f);
+            return true;
+        case sf::Keyboard::Right:
+            pan_pixels(-0.1f * width_, 0.f);
+            return true;
+        case sf::Keyboard::Up:
+            pan_pixels(0.f, 0.1f * height_);
+            return true;
+        case sf::Keyboard::Down:
+            pan_pixels(0.f, -0.1f * height_);
+            return true;
+        case sf::Keyboard::Home:
+            reset_view();
+            return true;
+        default:
+            return false;
+        }
+    default:
+        return false;
+    }
+}
+
+// Level of detail -------------------------------------------------------------
+
+void Renderer::set_level_of_detail(bool enabled, std::size_t min_items, unsigned density_threshold) {
+    lod_enabled_ = enabled;
+    lod_min_items_ = min_items;
+    lod_density_threshold_ = density_threshold;
+    density_scale_ = 0.0; // force a rebuild
+}
+
+bool Renderer::lod_active(const SimulatorBase& sim) const {
+    return lod_enabled_ && sim.get_bodies().size() + sim.get_test_particles().size() >= lod_min_items_;
+}
+
+int Renderer::density_cell(const sf::Vector2f& screen) const {
+    if (screen.x < 0.f || screen.y < 0.f) return DensityMap::kOutside;
+    return density_.cell_at(static_cast<int>(screen.x) / static_cast<int>(kDensityCellPx),
+                            static_cast<int>(screen.y) / static_cast<int>(kDensityCellPx));
+}
+
+// Re-bin every non-crisp body and test particle. Items that stay in their
+// cell cost nothing beyond the transform; only changed cells are recoloured
+// and uploaded. A view change (zoom, pan, resize) or a different item count
+// invalidates the binning and rebuilds it.
+void Renderer::update_density(const SimulatorBase& sim) {
+    const auto& bodies = sim.get_bodies();
+    const auto& tracers = sim.get_test_particles();
+    const std::size_t items = bodies.size() + tracers.size();
+    const unsigned cols = (width_ + kDensityCellPx - 1) / kDensityCellPx;
+    const unsigned rows = (height_ + kDensityCellPx - 1) / kDensityCellPx;
+
+    if (density_.items() != items || density_.cols() != cols || density_.rows() != rows ||
+        density_.threshold() != lod_density_threshold_ || density_scale_ != scale_ ||
+        density_center_.x != center_.x || density_center_.y != center_.y) {
+        density_.reset(cols, rows, items, lod_density_threshold_);
+        density_scale_ = scale_;
+        density_center_ = center_;
+    }
+
+    auto cell_of = [&](const Vec2& p) { return density_cell(world_to_screen(p)); };
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        density_.place(i, is_crisp(bodies[i]) ? DensityMap::kOutside : cell_of(bodies[i].pos));
+    }
+    for (std::size_t k = 0; k < tracers.size(); ++k) {
+        density_.place(bodies.size() + k, cell_of(tracers.pos(k)));
+    }
+
+    if (density_width_ != cols || density_height_ != rows) {
+        heat_texture_.create(cols, rows);
+        density_width_ = cols;
+        density_height_ = rows;
+        heat_texture_.update(density_.pixels().data());
+    } else if (density_.dirty()) {
+        // Upload only the bounding box of the changed cells.
+        const unsigned x0 = density_.dirty_x0();
+        const unsigned y0 = density_.dirty_y0();
+        const unsigned w = density_.dirty_x1() - x0;
+        const unsigned h = density_.dirty_y1() - y0;
+        heat_upload_.resize(static_cast<std::size_t>(w) * h * 4);
+        for (unsigned y = 0; y < h; ++y) {
+            const auto* row = &density_.pixels()[(static_cast<std::size_t>(y0 + y) * cols + x0) * 4];
+            std::copy(row, row + static_cast<std::size_t>(w) * 4, &heat_upload_[static_cast<std::size_t>(y) * w * 4]);
+        }
+        heat_texture_.update(heat_upload_.data(), w, h, x0, y0);
+    }
+    density_.clear_dirty();
+}
+
+// Trails ----------------------------------------------------------------------
+
+void Renderer::set_trail_subdivisions(int n) { trail_subdivisions_ = std::max(n, 1); }
+
 void Renderer::rebuild_trails(std::size_t count) {
     trails_.clear();
     trails_.resize(count);
+    trail_owners_.clear();
 }
 
-void Renderer::write_state_json(const Simulator& sim, const std::string& filename) const {
+void Renderer::sync_trails(const SimulatorBase& sim) {
+    const std::size_t n = sim.get_bodies().size();
+    bool same = trail_owners_.size() == n && trails_.size() == n;
+    for (std::size_t i = 0; same && i < n; ++i) same = trail_owners_[i] == sim.handle_at(i);
+    if (same) return;
+
+    std::vector<std::deque<Vec2>> moved(n);
+    for (std::size_t k = 0; k < trail_owners_.size() && k < trails_.size(); ++k) {
+        const std::size_t idx = sim.index_of(trail_owners_[k]);
+        if (idx < n) moved[idx] = std::move(trails_[k]);
+    }
+    trails_.swap(moved);
+    trail_owners_.resize(n);
+    for (std::size_t i = 0; i < n; ++i) trail_owners_[i] = sim.handle_at(i);
+}
+
+// In level-of-detail mode only crisp bodies keep trails. The interpolated
+// points are only inserted when the simulator's last step started where the
+// trails end, i.e. exactly one step was taken since the previous frame.
+void Renderer::update_trails(const SimulatorBase& sim) {
+    const auto& bodies = sim.get_bodies();
+    const bool lod = lod_active(sim);
+    const std::size_t limit = max_trail_ * static_cast<std::size_t>(trail_subdivisions_);
+
+    const double t0 = sim.dense_output_begin();
+    const double t1 = sim.get_time();
+    const bool smooth = trail_subdivisions_ > 1 && t0 == trail_time_ && t1 > t0;
+    for (int k = 1; smooth && k < trail_subdivisions_; ++k) {
+        const double t = t0 + (t1 - t0) * k / trail_subdivisions_;
+        if (!sim.state_at(t, trail_state_)) break;
+        for (std::size_t i = 0; i < bodies.size() && i < trail_state_.size(); ++i) {
+            auto& trail = trails_[i];
+            if (trail.empty() || (lod && !is_crisp(bodies[i]))) continue;
+            trail.push_back(trail_state_[i].pos);
+        }
+    }
+    trail_time_ = t1;
+
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        auto& trail = trails_[i];
+        if (lod && !is_crisp(bodies[i])) {
+            trail.clear();
+            continue;
+        }
+        trail.push_back(bodies[i].pos);
+        while (trail.size() > limit) trail.pop_front();
+    }
+}
+
+// Collisions ------------------------------------------------------------------
+
+// Bodies are swap-removed (the last body takes the freed index), and the
+// trails follow the same permutation.
+void Renderer::remove_body(SimulatorBase& sim, std::size_t idx) {
+    sim.remove_body_at(idx);
+    if (idx < trails_.size()) {
+        if (idx + 1 < trails_.size()) trails_[idx] = std::move(trails_.back());
+        trails_.pop_back();
+    }
+    if (idx < trail_owners_.size()) {
+        trail_owners_[idx] = trail_owners_.back();
+        trail_owners_.pop_back();
+    }
+}
+
+// Collision detection uses the visual touch of the pixel radii at the
+// initial zoom, so zooming does not change which bodies collide. Bodies that
+// touch a star are removed at once. A collision between two regular bodies
+// pauses an interactive session until the user decides; otherwise the
+// lighter body is removed straight away.
+void Renderer::handle_collisions(SimulatorBase& sim, bool interactive) {
+    const auto& bodies = sim.get_bodies();
+
+    // Collect bodies that fell into the sun this frame
+    std::vector<std::size_t> to_remove;
+
+    if (!collision_active_) {
+        bool found = false;
+        for (std::size_t i = 0; i < bodies.size() && !found; ++i) {
+            for (std::size_t j = i + 1; j < bodies.size(); ++j) {
+                const auto& a = bodies[i];
+                const auto& b = bodies[j];
+
+                float dx = static_cast<float>(meters_to_pixels(a.pos.x - b.pos.x, base_scale_));
+                float dy = static_cast<float>(meters_to_pixels(a.pos.y - b.pos.y, base_scale_));
+                float dist2 = dx * dx + dy * dy;
+
+                float ra = static_cast<float>(a.radius);
+                float rb = static_cast<float>(b.radius);
+                float rsum = ra + rb;
+
+                if (dist2 <= rsum * rsum) {
+                    // If exactly one is a star (e.g., Sun), remove the other instantly
+                    bool aStar = a.is_star;
+                    bool bStar = b.is_star;
+                    if (aStar ^ bStar) {
+                        std::size_t idx_remove = aStar ? j : i;
+                        to_remove.push_back(idx_remove);
+                        std::cout << "Body " << idx_remove << " collided with the Sun and was removed.\n";
+                        continue;
+                    }
+
+                    // Ignore collisions between satellites and non-stars
+                    if (a.is_satellite || b.is_satellite) {
+                        continue;
+                    }
+
+                    // Decide which body to remove: smaller mass
+                    const std::size_t lighter = (a.mass <= b.mass) ? i : j;
+                    found = true;
+
+                    if (!interactive) {
+                        to_remove.push_back(lighter);
+                        std::cout << "Collision between bodies " << i << " and " << j
+                                  << ": removed body " << lighter << ".\n";
+                        break;
+                    }
+
+                    // Regular bodies in an interactive session: pause and let the user decide
+                    collision_active_ = true;
+                    paused_ = true;
+                    collision_idx_remove_ = lighter;
+                    collision_idx_keep_ = (lighter == i) ? j : i;
+
+                    std::cout << "Collision detected between bodies " << i
+                              << " and " << j
+                              << ". Press C to continue without the smaller body, or ESC to exit.\n";
+                    break;
+                }
+            }
+        }
+    }
+
+    // Remove any bodies that collided this frame. Highest index first, so
+    // the body swapped into a freed index is never one still to be removed.
+    if (!to_remove.empty()) {
+        std::sort(to_remove.begin(), to_remove.end());
+        to_remove.erase(std::unique(to_remove.begin(), to_remove.end()), to_remove.end());
+        for (auto it = to_remove.rbegin(); it != to_remove.rend(); ++it) {
+            remove_body(sim, *it);
+        }
+    }
+}
+
+// Drawing ---------------------------------------------------------------------
+
+void Renderer::draw_scene(sf::RenderTarget& target, const SimulatorBase& sim) {
+    const auto& bodies = sim.get_bodies();
+    const WorldRect view = visible_world(2.0);
+    const bool lod = lod_active(sim);
+
+    // Aggregated regions go underneath everything else.
+    if (lod) {
+        update_density(sim);
+        sf::Sprite heat(heat_texture_);
+        heat.setScale(static_cast<float>(kDensityCellPx), static_cast<float>(kDensityCellPx));
+        target.draw(heat);
+    }
+
+    // Trails first, as one batch of line segments. A segment is only
+    // transformed when its bounding box meets the view.
+    sf::VertexArray lines(sf::Lines);
+    for (std::size_t i = 0; i < bodies.size() && i < trails_.size(); ++i) {
+        const auto& trail = trails_[i];
+        if (trail.size() < 2) continue;
+
+        std::uint8_t r, g, bl;
+        unpack_rgb(bodies[i].color, r, g, bl);
+        // Fade older segments
+        auto faded = [&](std::size_t idx) {
+            float t = static_cast<float>(idx) / static_cast<float>(trail.size());
+            return sf::Color(r, g, bl, static_cast<sf::Uint8>(50 + 200 * t));
+        };
+
+        for (std::size_t k = 1; k < trail.size(); ++k) {
+            const Vec2& a = trail[k - 1];
+            const Vec2& b = trail[k];
+            if (!view.overlaps(std::min(a.x, b.x), std::min(a.y, b.y), std::max(a.x, b.x), std::max(a.y, b.y))) {
+                continue;
+            }
+            lines.append(sf::Vertex(world_to_screen(a), faded(k - 1)));
+            lines.append(sf::Vertex(world_to_screen(b), faded(k)));
+        }
+    }
+    if (lines.getVertexCount() > 0) target.draw(lines);
+
+    // Test particles as single points in one batch (no trails)
+    const auto& tracers = sim.get_test_particles();
+    if (!tracers.empty()) {
+        sf::VertexArray points(sf::Points);
+        for (std::size_t k = 0; k < tracers.size(); ++k) {
+            const Vec2 p = tracers.pos(k);
+            if (!view.contains(p)) continue;
+            const sf::Vector2f sp = world_to_screen(p);
+            if (lod && density_.aggregated(density_cell(sp))) continue;
+            points.append(sf::Vertex(sp, sf::Color(200, 200, 220, 160)));
+        }
+        target.draw(points);
+    }
+
+    // Level of detail: non-crisp bodies as points (tiny) or quads, skipping
+    // those already represented by the heatmap.
+    if (lod) {
+        sf::VertexArray points(sf::Points);
+        sf::VertexArray quads(sf::Quads);
+        for (const auto& b : bodies) {
+            if (is_crisp(b) || !view.contains(b.pos)) continue;
+            const sf::Vector2f p = world_to_screen(b.pos);
+            if (density_.aggregated(density_cell(p))) continue;
+            std::uint8_t r, g, bl;
+            unpack_rgb(b.color, r, g, bl);
+            const sf::Color c(r, g, bl);
+            const float rad = static_cast<float>(b.radius);
+            if (rad <= 1.5f) {
+                points.append(sf::Vertex(p, c));
+            } else {
+                quads.append(sf::Vertex(sf::Vector2f(p.x - rad, p.y - rad), c));
+                quads.append(sf::Vertex(sf::Vector2f(p.x + rad, p.y - rad), c));
+                quads.append(sf::Vertex(sf::Vector2f(p.x + rad, p.y + rad), c));
+                quads.append(sf::Vertex(sf::Vector2f(p.x - rad, p.y + rad), c));
+            }
+        }
+        if (quads.getVertexCount() > 0) target.draw(quads);
+        if (points.getVertexCount() > 0) target.draw(points);
+    }
+
+    // Draw bodies on top (radii are in pixels, independent of zoom)
+    for (const auto& b : bodies) {
+        if (lod && !is_crisp(b)) continue;
+        const double rw = pixels_to_meters(b.radius, scale_);
+        if (!view.overlaps(b.pos.x - rw, b.pos.y - rw, b.pos.x + rw, b.pos.y + rw)) continue;
+        sf::CircleShape circle(static_cast<float>(b.radius));
+        std::uint8_t r, g, bl;
+        unpack_rgb(b.color, r, g, bl);
+        circle.setFillColor(sf::Color(r, g, bl));
+        auto p = world_to_screen(b.pos);
+        circle.setPosition(p.x - circle.getRadius(), p.y - circle.getRadius());
+        target.draw(circle);
+    }
+}
+
+void Renderer::set_state_file(const std::string& filename) { state_filename_ = filename; }
+
+void Renderer::set_telemetry(TelemetryServer* server) { telemetry_ = server; }
+
+void Renderer::write_state_json(const SimulatorBase& sim, const std::string& filename) const {
     std::ofstream out(filename);
     if (!out) {
         return;
@@ -38,9 +451,12 @@ void Renderer::write_state_json(const Simulator& sim, const std::string& filenam
     out << "  \"bodies\": [\n";
     for (std::size_t i = 0; i < bodies.size(); ++i) {
         const auto& b = bodies[i];
-        std::string name = b.name.empty() ? ("body_" + std::to_string(i)) : b.name;
         out << "    {\n";
-        out << "      \"name\": \"" << name << "\",\n";
+        if (b.has_name()) {
+            out << "      \"name\": \"" << b.name() << "\",\n";
+        } else {
+            out << "      \"name\": \"body_" << i << "\",\n";
+        }
         out << "      \"mass\": " << b.mass << ",\n";
         out << "      \"radius\": " << b.radius << ",\n";
         out << "      \"color\": " << b.color << ",\n";
@@ -57,19 +473,25 @@ void Renderer::write_state_json(const Simulator& sim, const std::string& filenam
     out << "}\n";
 }
 
-void Renderer::run(Simulator& sim) {
+void Renderer::run(SimulatorBase& sim) {
     sf::RenderWindow window(sf::VideoMode(width_, height_), "OrbitSimLite");
     window.setFramerateLimit(60);
 
     // Capture initial bodies for reset
     const std::vector<Body> initial_bodies = sim.get_bodies();
     rebuild_trails(initial_bodies.size());
+    const bool dense_output = sim.has_dense_output();
+    sim.set_dense_output(dense_output || trail_subdivisions_ > 1);
+    trail_time_ = sim.get_time();
 
     sf::Clock clock;
 
     while (window.isOpen()) {
         sf::Event event;
         while (window.pollEvent(event)) {
+            if (handle_view_event(event)) {
+                continue;
+            }
             if (event.type == sf::Event::Closed) {
                 window.close();
             } else if (event.type == sf::Event::Resized) {
@@ -98,17 +520,7 @@ void Renderer::run(Simulator& sim) {
                 } else if (event.key.code == sf::Keyboard::C) {
                     // Resolve collision: remove smaller body and continue
                     if (collision_active_) {
-                        auto& bodies_nc = sim.access_bodies();
-                        if (collision_idx_remove_ < bodies_nc.size()) {
-                            bodies_nc.erase(
-                                bodies_nc.begin()
-                                + static_cast<std::ptrdiff_t>(collision_idx_remove_));
-                        }
-                        if (collision_idx_remove_ < trails_.size()) {
-                            trails_.erase(
-                                trails_.begin()
-                                + static_cast<std::ptrdiff_t>(collision_idx_remove_));
-                        }
+                        remove_body(sim, collision_idx_remove_);
                         collision_active_ = false;
                         paused_ = false;
                         std::cout << "Collision resolved: removed smaller body.\n";
@@ -122,8 +534,13 @@ void Renderer::run(Simulator& sim) {
             sim.step();
         }
 
-        // Write current state to JSON each frame (no history)
-        write_state_json(sim, state_filename_);
+        // Export the current state (JSON rewritten each frame, no history)
+        if (!state_filename_.empty()) {
+            write_state_json(sim, state_filename_);
+        }
+        if (telemetry_) {
+            telemetry_->publish(sim);
+        }
 
         // Update window title with simulation time in Earth years
         {
@@ -136,134 +553,112 @@ void Renderer::run(Simulator& sim) {
         // Draw
         window.clear(sf::Color(10, 10, 20));
 
-        const auto& bodies = sim.get_bodies();
-        if (trails_.size() != bodies.size()) {
-            rebuild_trails(bodies.size());
-        }
+        sync_trails(sim);
+        handle_collisions(sim, true);
 
-        // Collect bodies that fell into the sun this frame
-        std::vector<std::size_t> to_remove;
-
-        // Collision detection (visual touch using screen positions and radii)
-        if (!collision_active_) {
-            for (std::size_t i = 0; i < bodies.size(); ++i) {
-                for (std::size_t j = i + 1; j < bodies.size(); ++j) {
-                    const auto& a = bodies[i];
-                    const auto& b = bodies[j];
-
-                    auto pa = world_to_screen(a.pos);
-                    auto pb = world_to_screen(b.pos);
-
-                    float dx = pa.x - pb.x;
-                    float dy = pa.y - pb.y;
-                    float dist2 = dx * dx + dy * dy;
-
-                    float ra = static_cast<float>(a.radius);
-                    float rb = static_cast<float>(b.radius);
-                    float rsum = ra + rb;
-
-                    if (dist2 <= rsum * rsum) {
-                        // If exactly one is a star (e.g., Sun), remove the other instantly
-                        bool aStar = a.is_star;
-                        bool bStar = b.is_star;
-                        if (aStar ^ bStar) {
-                            std::size_t idx_remove = aStar ? j : i;
-                            to_remove.push_back(idx_remove);
-                            std::cout << "Body " << idx_remove << " collided with the Sun and was removed.\n";
-                            continue;
-                        }
-
-                        // Ignore collisions between satellites and non-stars
-                        if (a.is_satellite || b.is_satellite) {
-                            continue;
-                        }
-
-                        // Collision detected between regular bodies: pause and let user decide
-                        collision_active_ = true;
-                        paused_ = true;
-
-                        // Decide which body to remove: smaller mass
-                        if (a.mass <= b.mass) {
-                            collision_idx_remove_ = i;
-                            collision_idx_keep_ = j;
-                        } else {
-                            collision_idx_remove_ = j;
-                            collision_idx_keep_ = i;
-                        }
-
-                        std::cout << "Collision detected between bodies " << i
-                                  << " and " << j
-                                  << ". Press C to continue without the smaller body, or ESC to exit.\n";
-                        break;
-                    }
-                }
-                if (collision_active_) {
-                    break;
-                }
+        update_trails(sim);
+        draw_scene(window, sim);
+
+        window.display();
+    }
+    sim.set_dense_output(dense_output);
+}
+
+// Offscreen capture -------------------------------------------------------------
+
+namespace {
+
+bool write_ppm(const sf::Image& image, const std::string& filename) {
+    const sf::Vector2u size = image.getSize();
+    const sf::Uint8* rgba = image.getPixelsPtr();
+    if (!rgba) return false;
+
+    std::vector<char> rgb(static_cast<std::size_t>(size.x) * size.y * 3);
+    for (std::size_t p = 0, n = static_cast<std::size_t>(size.x) * size.y; p < n; ++p) {
+        rgb[3 * p + 0] = static_cast<char>(rgba[4 * p + 0]);
+        rgb[3 * p + 1] = static_cast<char>(rgba[4 * p + 1]);
+        rgb[3 * p + 2] = static_cast<char>(rgba[4 * p + 2]);
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) return false;
+    out << "P6\n" << size.x << ' ' << size.y << "\n255\n";
+    out.write(rgb.data(), static_cast<std::streamsize>(rgb.size()));
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+// The render thread owns the OpenGL context, so drawing and the pixel
+// readback stay on it; the readback yields a CPU-side sf::Image that is
+// handed to the queue, where PNG/PPM encoding and the file write happen while
+// the next frame is simulated and drawn. The bounded queue throttles the
+// loop when the disk or the encoder cannot keep up.
+std::size_t Renderer::render_offscreen(SimulatorBase& sim, const CaptureOptions& options) {
+    sf::RenderTexture target;
+    if (!target.create(width_, height_)) {
+        std::cerr << "Offscreen capture: could not create a " << width_ << "x" << height_
+                  << " render texture.\n";
+        return 0;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(options.directory, ec);
+    if (ec) {
+        std::cerr << "Offscreen capture: cannot create '" << options.directory << "': " << ec.message() << "\n";
+        return 0;
+    }
+
+    const bool png = options.format == CaptureOptions::Format::Png;
+    const std::string stem = (std::filesystem::path(options.directory) / options.prefix).string();
+    const int steps = std::max(options.steps_per_frame, 1);
+
+    rebuild_trails(sim.get_bodies().size());
+    collision_active_ = false;
+    paused_ = false;
+    const bool dense_output = sim.has_dense_output();
+    sim.set_dense_output(dense_output || trail_subdivisions_ > 1);
+    trail_time_ = sim.get_time();
+
+    std::atomic<std::size_t> written {0};
+    {
+        TaskQueue queue(options.workers, options.max_pending);
+
+        for (std::size_t frame = 0; frame < options.frames; ++frame) {
+            for (int s = 0; s < steps; ++s) {
+                sim.step();
             }
-        }
 
-        // Remove any bodies that collided with the Sun this frame
-        if (!to_remove.empty()) {
-            auto& bodies_nc = sim.access_bodies();
-            std::sort(to_remove.begin(), to_remove.end());
-            to_remove.erase(std::unique(to_remove.begin(), to_remove.end()), to_remove.end());
-            for (auto it = to_remove.rbegin(); it != to_remove.rend(); ++it) {
-                std::size_t idx = *it;
-                if (idx < bodies_nc.size()) {
-                    bodies_nc.erase(bodies_nc.begin() + static_cast<std::ptrdiff_t>(idx));
-                }
-                if (idx < trails_.size()) {
-                    trails_.erase(trails_.begin() + static_cast<std::ptrdiff_t>(idx));
-                }
+            sync_trails(sim);
+            handle_collisions(sim, false);
+            update_trails(sim);
+            if (telemetry_) {
+                telemetry_->publish(sim);
             }
-        }
 
-        // Draw trails first
-        for (std::size_t i = 0; i < bodies.size(); ++i) {
-            const auto& b = bodies[i];
-            auto screenPos = world_to_screen(b.pos);
+            target.clear(sf::Color(10, 10, 20));
+            draw_scene(target, sim);
+            target.display();
 
-            // Update trail
-            auto& trail = trails_[i];
-            trail.push_back(screenPos);
-            if (trail.size() > max_trail_) trail.pop_front();
+            auto image = std::make_shared<sf::Image>(target.getTexture().copyToImage());
 
-            // Convert color
-            std::uint8_t r, g, bl;
-            unpack_rgb(b.color, r, g, bl);
-            sf::Color c(r, g, bl, 180);
-
-            // Draw trail as line strip
-            if (trail.size() >= 2) {
-                sf::VertexArray lines(sf::LineStrip, trail.size());
-                std::size_t idx = 0;
-                for (const auto& tp : trail) {
-                    lines[idx].position = tp;
-                    // Fade older segments
-                    float t = static_cast<float>(idx) / static_cast<float>(trail.size());
-                    lines[idx].color = sf::Color(
-                        c.r, c.g, c.b,
-                        static_cast<sf::Uint8>(50 + 200 * t));
-                    ++idx;
-                }
-                window.draw(lines);
-            }
-        }
+            std::ostringstream name;
+            name << stem << std::setw(6) << std::setfill('0') << frame << (png ? ".png" : ".ppm");
 
-        // Draw bodies on top
-        for (const auto& b : bodies) {
-            sf::CircleShape circle(static_cast<float>(b.radius));
-            std::uint8_t r, g, bl;
-            unpack_rgb(b.color, r, g, bl);
-            circle.setFillColor(sf::Color(r, g, bl));
-            auto p = world_to_screen(b.pos);
-            circle.setPosition(p.x - circle.getRadius(), p.y - circle.getRadius());
-            window.draw(circle);
+            queue.push([image, filename = name.str(), png, &written] {
+                const bool ok = png ? image->saveToFile(filename) : write_ppm(*image, filename);
+                if (ok) {
+                    written.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    std::cerr << "Offscreen capture: failed to write " << filename << "\n";
+                }
+            });
         }
-
-        window.display();
+        queue.wait_idle(); // rethrows a failure in a writer task
     }
+
+    sim.set_dense_output(dense_output);
+    return written.load();
 }
 
 } // namespace orbitsimlite
@@ -1,71 +1,395 @@
 // OrbitSimLite - Simulator implementation
 #include "simulator.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "pipeline.hpp"
+
 namespace orbitsimlite {
 
-Simulator::Simulator(double G, double dt, Integrator integrator)
-    : G_(G), dt_(dt), integrator_(integrator), substeps_(1), time_(0.0) {}
+namespace {
+
+template <class IntegratorPolicy, class ForceLaw>
+class PipelineModel final : public detail::AnyPipeline {
+public:
+    explicit PipelineModel(const ForceLaw& law) : pipeline_(law) {}
+
+    double refresh(std::vector<Body>& bodies, TestParticles& tracers, double G) override {
+        return pipeline_.refresh(bodies, tracers, G);
+    }
+    double advance(std::vector<Body>& bodies, TestParticles& tracers, double G, double h, int n) override {
+        return pipeline_.advance(bodies, tracers, G, h, n);
+    }
+    double potential(const std::vector<Body>& bodies, double G) const override {
+        return pipeline_.potential(bodies, G);
+    }
+    void field(const std::vector<Body>& sources, double G, std::size_t exclude,
+               const std::vector<Vec2>& points, std::vector<Vec2>& out) override {
+        pipeline_.field(sources, G, exclude, points, out);
+    }
+    void set_extra_forces(const ExtraForces& extra) override {
+        pipeline_.set_extra_forces(extra);
+    }
+    void set_execution(const ExecutionOptions& options) override {
+        pipeline_.set_execution(options);
+    }
+
+private:
+    Pipeline<IntegratorPolicy, ForceLaw> pipeline_;
+};
+
+template <class IntegratorPolicy>
+std::unique_ptr<detail::AnyPipeline> make_pipeline(double softening, SofteningKernel kernel) {
+    if (softening > 0.0 && kernel == SofteningKernel::Spline) {
+        return std::make_unique<PipelineModel<IntegratorPolicy, SplineGravity>>(SplineGravity{softening});
+    }
+    if (softening > 0.0) {
+        return std::make_unique<PipelineModel<IntegratorPolicy, PlummerGravity>>(PlummerGravity{softening});
+    }
+    return std::make_unique<PipelineModel<IntegratorPolicy, NewtonianGravity>>(NewtonianGravity{});
+}
+
+// Smallest squared separation of a pair with relative position 'r' and
+// velocity 'v' over the next 'span' seconds, assuming straight-line motion.
+double closest_approach2(const Vec2& r, const Vec2& v, double span) {
+    const double v2 = v.length_squared();
+    const double t = (v2 > 0.0) ? std::clamp(-Vec2::dot(r, v) / v2, 0.0, span) : 0.0;
+    return (r + t * v).length_squared();
+}
+
+// Cubic Hermite interpolation of a trajectory known at both ends of a step
+// of length 'span': (x0, v0) at f = 0 and (x1, v1) at f = 1.
+Vec2 hermite(const Vec2& x0, const Vec2& v0, const Vec2& x1, const Vec2& v1, double span, double f) {
+    const double f2 = f * f;
+    const double f3 = f2 * f;
+    return (2.0 * f3 - 3.0 * f2 + 1.0) * x0 + ((f3 - 2.0 * f2 + f) * span) * v0 +
+           (3.0 * f2 - 2.0 * f3) * x1 + ((f3 - f2) * span) * v1;
+}
 
-void Simulator::add_body(const Body& b) { bodies_.push_back(b); }
+} // namespace
 
-void Simulator::set_bodies(const std::vector<Body>& bs) { bodies_ = bs; }
+Simulator::Simulator(double G, double dt, Integrator integrator)
+    : SimulatorBase(G, dt), integrator_(integrator) {
+    rebuild_pipeline();
+}
+
+// The pipeline only holds scratch buffers and the force law parameters, so a
+// copy simply builds a fresh one from the configuration.
+Simulator::Simulator(const Simulator& other)
+    : SimulatorBase(other), integrator_(other.integrator_), softening_(other.softening_),
+      softening_kernel_(other.softening_kernel_), extra_(other.extra_), subsystems_(other.subsystems_),
+      regularization_distance_(other.regularization_distance_),
+      regularization_substeps_(other.regularization_substeps_) {
+    rebuild_pipeline();
+}
 
-void Simulator::clear() { bodies_.clear(); }
+Simulator& Simulator::operator=(const Simulator& other) {
+    if (this != &other) {
+        SimulatorBase::operator=(other);
+        integrator_ = other.integrator_;
+        softening_ = other.softening_;
+        softening_kernel_ = other.softening_kernel_;
+        extra_ = other.extra_;
+        subsystems_ = other.subsystems_;
+        regularization_distance_ = other.regularization_distance_;
+        regularization_substeps_ = other.regularization_substeps_;
+        rebuild_pipeline();
+    }
+    return *this;
+}
 
-void Simulator::set_dt(double dt__) { dt_ = dt__; }
-double Simulator::get_dt() const { return dt_; }
+void Simulator::rebuild_pipeline() {
+    if (integrator_ == Integrator::Euler) {
+        pipeline_ = make_pipeline<EulerIntegration>(softening_, softening_kernel_);
+    } else if (integrator_ == Integrator::WisdomHolman) {
+        pipeline_ = make_pipeline<WisdomHolmanIntegration>(softening_, softening_kernel_);
+    } else {
+        pipeline_ = make_pipeline<RK4Integration>(softening_, softening_kernel_);
+    }
+    pipeline_->set_extra_forces(extra_);
+    pipeline_->set_execution(execution());
+}
 
-void Simulator::set_integrator(Integrator i) { integrator_ = i; }
+bool Simulator::set_integrator(Integrator i) {
+    if (i == Integrator::WisdomHolman && get_transport() != nullptr) return false;
+    integrator_ = i;
+    rebuild_pipeline();
+    return true;
+}
 Integrator Simulator::get_integrator() const { return integrator_; }
 
-void Simulator::set_gravity(double G__) { G_ = G__; }
-double Simulator::get_gravity() const { return G_; }
+void Simulator::set_softening(double eps) {
+    softening_ = (eps > 0.0) ? eps : 0.0;
+    rebuild_pipeline();
+    invalidate_forces();
+}
+double Simulator::get_softening() const { return softening_; }
 
-void Simulator::step() {
-    if (bodies_.empty()) return;
+void Simulator::set_softening_kernel(SofteningKernel kernel) {
+    softening_kernel_ = kernel;
+    rebuild_pipeline();
+    invalidate_forces();
+}
+SofteningKernel Simulator::get_softening_kernel() const { return softening_kernel_; }
 
-    const int n = (substeps_ > 0) ? substeps_ : 1;
-    const double h = dt_ / static_cast<double>(n);
+void Simulator::set_extra_forces(const ExtraForces& extra) {
+    extra_ = extra;
+    pipeline_->set_extra_forces(extra_);
+    invalidate_forces();
+}
+const ExtraForces& Simulator::get_extra_forces() const { return extra_; }
 
-    for (int s = 0; s < n; ++s) {
-        if (integrator_ == Integrator::Euler) {
-            // Compute accelerations at current positions
-            std::vector<Vec2> accs(bodies_.size());
-            for (std::size_t i = 0; i < bodies_.size(); ++i) {
-                accs[i] = Physics::acceleration(bodies_[i], bodies_, G_);
-            }
-            // Update bodies
-            for (std::size_t i = 0; i < bodies_.size(); ++i) {
-                Physics::step_euler(bodies_[i], accs[i], h);
-            }
-        } else { // RK4
-            // Compute new states into a copy to avoid order dependence
-            std::vector<Body> next = bodies_;
-            for (std::size_t i = 0; i < bodies_.size(); ++i) {
-                // For RK4, exclude self from the accelerations used in intermediate stages
-                std::vector<Body> others;
-                others.reserve(bodies_.size() - 1);
-                for (std::size_t j = 0; j < bodies_.size(); ++j) {
-                    if (j == i) continue;
-                    others.push_back(bodies_[j]);
-                }
-                Physics::step_rk4(next[i], others, G_, h);
+// Subsystems ------------------------------------------------------------------
+
+bool Simulator::in_subsystem(BodyHandle h) const {
+    for (const Subsystem& sub : subsystems_) {
+        if (sub.primary == h || sub.secondary == h) return true;
+    }
+    return false;
+}
+
+bool Simulator::pair_resolved(std::size_t i, std::size_t j) const {
+    if (planned_.empty()) return false;
+    const BodyHandle a = handle_at(i);
+    const BodyHandle b = handle_at(j);
+    for (const Subsystem& pair : planned_) {
+        if ((pair.primary == a && pair.secondary == b) || (pair.primary == b && pair.secondary == a)) return true;
+    }
+    return false;
+}
+
+bool Simulator::add_subsystem(BodyHandle primary, BodyHandle secondary, int inner_substeps) {
+    const Body* a = find_body(primary);
+    const Body* b = find_body(secondary);
+    if (!a || !b || primary == secondary || a->is_test_particle || b->is_test_particle) return false;
+    if (get_transport() != nullptr) return false;
+    if (a->mass + b->mass <= 0.0 || in_subsystem(primary) || in_subsystem(secondary)) return false;
+    subsystems_.push_back(Subsystem{primary, secondary, (inner_substeps > 0) ? inner_substeps : 1});
+    return true;
+}
+
+// A satellite belongs to the nearest heavier body whose Hill sphere around
+// the central body contains it and to which it is gravitationally bound.
+std::size_t Simulator::detect_subsystems(int inner_substeps) {
+    const std::vector<Body>& bodies = get_bodies();
+    const std::size_t c = central_body_index(bodies);
+    if (c == bodies.size() || bodies[c].mass <= 0.0) return 0;
+    const Body& central = bodies[c];
+    const double G = get_gravity();
+
+    std::size_t added = 0;
+    for (std::size_t s = 0; s < bodies.size(); ++s) {
+        const Body& moon = bodies[s];
+        if (s == c || !moon.is_satellite || moon.is_test_particle) continue;
+
+        std::size_t best = bodies.size();
+        double best_d2 = 0.0;
+        for (std::size_t j = 0; j < bodies.size(); ++j) {
+            const Body& host = bodies[j];
+            if (j == s || j == c || host.is_test_particle || host.mass <= moon.mass) continue;
+            const double hill = (host.pos - central.pos).length() * std::cbrt(host.mass / (3.0 * central.mass));
+            const double d2 = (moon.pos - host.pos).length_squared();
+            if (d2 >= hill * hill) continue;
+            const double energy = 0.5 * (moon.vel - host.vel).length_squared() -
+                                  G * (host.mass + moon.mass) / std::sqrt(d2);
+            if (energy >= 0.0) continue;
+            if (best == bodies.size() || d2 < best_d2) {
+                best = j;
+                best_d2 = d2;
             }
-            bodies_ = std::move(next);
         }
+        if (best != bodies.size() && add_subsystem(handle_at(best), handle_at(s), inner_substeps)) ++added;
+    }
+    return added;
+}
+
+void Simulator::clear_subsystems() { subsystems_.clear(); }
+
+const std::vector<Subsystem>& Simulator::get_subsystems() const { return subsystems_; }
+
+bool Simulator::set_regularization(double distance, int inner_substeps) {
+    if (distance > 0.0 && get_transport() != nullptr) return false;
+    regularization_distance_ = (distance > 0.0) ? distance : 0.0;
+    regularization_substeps_ = (inner_substeps > 0) ? inner_substeps : 1;
+    return true;
+}
+double Simulator::get_regularization_distance() const { return regularization_distance_; }
+std::size_t Simulator::get_regularized_pair_count() const { return regularized_pairs_; }
+
+bool Simulator::supports_transport() const {
+    return integrator_ != Integrator::WisdomHolman && subsystems_.empty() && regularization_distance_ <= 0.0;
+}
+
+double Simulator::refresh_forces(std::vector<Body>& bodies, TestParticles& tracers, double G) {
+    return pipeline_->refresh(bodies, tracers, G);
+}
+
+// The pairs are chosen once per step, before the substep count, so the
+// automatic substeps skip exactly the pairs that 'advance' takes out of the
+// outer integration. Encounters are the pairs of remaining massive bodies
+// that come within the regularisation distance during the step, closest
+// first, each body in at most one pair.
+void Simulator::plan_step(double span) {
+    planned_.clear();
+    regularized_pairs_ = 0;
+    subsystems_.erase(std::remove_if(subsystems_.begin(), subsystems_.end(),
+                                     [&](const Subsystem& sub) {
+                                         const Body* a = find_body(sub.primary);
+                                         const Body* b = find_body(sub.secondary);
+                                         return !a || !b || a->is_test_particle || b->is_test_particle ||
+                                                a->mass + b->mass <= 0.0;
+                                     }),
+                      subsystems_.end());
+    planned_ = subsystems_;
+    if (regularization_distance_ <= 0.0) return;
+
+    const std::vector<Body>& bodies = get_bodies();
+    std::vector<char> taken(bodies.size(), 0);
+    for (const Subsystem& sub : subsystems_) taken[index_of(sub.primary)] = taken[index_of(sub.secondary)] = 1;
+    const double d2_max = regularization_distance_ * regularization_distance_;
+    std::vector<std::pair<double, std::pair<std::size_t, std::size_t>>> close;
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        if (taken[i] || bodies[i].is_test_particle) continue;
+        for (std::size_t j = i + 1; j < bodies.size(); ++j) {
+            if (taken[j] || bodies[j].is_test_particle || bodies[i].mass + bodies[j].mass <= 0.0) continue;
+            const double d2 = closest_approach2(bodies[j].pos - bodies[i].pos, bodies[j].vel - bodies[i].vel, span);
+            if (d2 < d2_max) close.push_back({d2, {i, j}});
+        }
+    }
+    std::sort(close.begin(), close.end());
+    for (const auto& c : close) {
+        std::size_t a = c.second.first, b = c.second.second;
+        if (taken[a] || taken[b]) continue;
+        if (bodies[b].mass > bodies[a].mass) std::swap(a, b);
+        taken[a] = taken[b] = 1;
+        planned_.push_back(Subsystem{handle_at(a), handle_at(b), regularization_substeps_});
+        ++regularized_pairs_;
     }
+}
 
-    // Advance simulation time by one full step
-    time_ += dt_;
+double Simulator::advance(std::vector<Body>& bodies, TestParticles& tracers, double G, double h, int n) {
+    if (planned_.empty()) return pipeline_->advance(bodies, tracers, G, h, n);
+    return advance_hierarchical(bodies, tracers, G, h, n);
 }
 
-const std::vector<Body>& Simulator::get_bodies() const { return bodies_; }
-std::vector<Body>& Simulator::access_bodies() { return bodies_; }
+// One step with the pairs of 'plan_step':
+//  1. replace every pair by its centre of mass and advance this outer set
+//     with the selected pipeline, remembering where it started;
+//  2. advance each relative orbit r = x_secondary - x_primary over the same
+//     interval with kick-drift-kick pieces: Kepler drifts under the pair's
+//     own mass and kicks by the tidal field a(x_secondary) - a(x_primary)
+//     of the other outer bodies, whose positions during the step are
+//     interpolated from both ends of their outer trajectories;
+//  3. put the pairs back around their new centres of mass.
+double Simulator::advance_hierarchical(std::vector<Body>& bodies, TestParticles& tracers, double G, double h,
+                                       int n) {
+    struct Pair {
+        std::size_t primary, secondary, slot;
+        double m1, m2;
+        Vec2 r, v;
+        int pieces;
+    };
+    std::vector<Pair> pairs;
+    std::vector<char> is_secondary(bodies.size(), 0);
+    for (const Subsystem& planned : planned_) {
+        Pair q {};
+        q.primary = index_of(planned.primary);
+        q.secondary = index_of(planned.secondary);
+        q.pieces = planned.inner_substeps * n;
+        is_secondary[q.secondary] = 1;
+        pairs.push_back(q);
+    }
+
+    std::vector<std::size_t> slot(bodies.size(), 0);
+    outer_.clear();
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        if (is_secondary[i]) continue;
+        slot[i] = outer_.size();
+        outer_.push_back(bodies[i]);
+    }
+    for (Pair& q : pairs) {
+        const Body& a = bodies[q.primary];
+        const Body& b = bodies[q.secondary];
+        q.slot = slot[q.primary];
+        q.m1 = a.mass;
+        q.m2 = b.mass;
+        q.r = b.pos - a.pos;
+        q.v = b.vel - a.vel;
+        Body& com = outer_[q.slot];
+        com.mass = a.mass + b.mass;
+        com.pos = (a.mass * a.pos + b.mass * b.pos) / com.mass;
+        com.vel = (a.mass * a.vel + b.mass * b.vel) / com.mass;
+        // The pair's mutual forces cancel, so the cached accelerations of
+        // the current state give that of its centre of mass.
+        com.acc = (a.mass * a.acc + b.mass * b.acc) / com.mass;
+        com.pos_carry = Vec2{};
+        com.vel_carry = Vec2{};
+    }
 
-void Simulator::set_substeps(int n) { substeps_ = (n > 0) ? n : 1; }
-int Simulator::get_substeps() const { return substeps_; }
+    // 1. Outer integration.
+    start_pos_.resize(outer_.size());
+    start_vel_.resize(outer_.size());
+    for (std::size_t k = 0; k < outer_.size(); ++k) {
+        start_pos_[k] = outer_[k].pos;
+        start_vel_[k] = outer_[k].vel;
+    }
+    pipeline_->advance(outer_, tracers, G, h, n);
 
-double Simulator::get_time() const { return time_; }
-void Simulator::reset_time() { time_ = 0.0; }
+    // 2. Relative orbits.
+    const double span = h * n;
+    sources_ = outer_;
+    for (Pair& q : pairs) {
+        const double m = q.m1 + q.m2;
+        const double tau = span / q.pieces;
+        auto tidal = [&](double f) {
+            for (std::size_t k = 0; k < outer_.size(); ++k) {
+                sources_[k].pos = hermite(start_pos_[k], start_vel_[k], outer_[k].pos, outer_[k].vel, span, f);
+            }
+            const Vec2 com = sources_[q.slot].pos;
+            probes_.assign({com - (q.m2 / m) * q.r, com + (q.m1 / m) * q.r});
+            pipeline_->field(sources_, G, q.slot, probes_, tidal_);
+            return tidal_[1] - tidal_[0];
+        };
+        q.v += (0.5 * tau) * tidal(0.0);
+        for (int j = 0; j < q.pieces; ++j) {
+            Physics::kepler_drift(q.r, q.v, G * m, tau);
+            const double f = static_cast<double>(j + 1) / q.pieces;
+            q.v += ((j + 1 < q.pieces) ? tau : 0.5 * tau) * tidal(f);
+        }
+    }
+
+    // 3. Back to individual bodies.
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        if (is_secondary[i]) continue;
+        const Body& o = outer_[slot[i]];
+        bodies[i].pos = o.pos;
+        bodies[i].vel = o.vel;
+        bodies[i].pos_carry = o.pos_carry;
+        bodies[i].vel_carry = o.vel_carry;
+    }
+    for (const Pair& q : pairs) {
+        const Body& com = outer_[q.slot];
+        const double m = q.m1 + q.m2;
+        Body& a = bodies[q.primary];
+        Body& b = bodies[q.secondary];
+        a.pos = com.pos - (q.m2 / m) * q.r;
+        a.vel = com.vel - (q.m2 / m) * q.v;
+        b.pos = com.pos + (q.m1 / m) * q.r;
+        b.vel = com.vel + (q.m1 / m) * q.v;
+        a.pos_carry = a.vel_carry = Vec2{};
+        b.pos_carry = b.vel_carry = Vec2{};
+    }
+    return pipeline_->refresh(bodies, tracers, G);
+}
+
+double Simulator::compute_potential(const std::vector<Body>& bodies, double G) const {
+    return pipeline_->potential(bodies, G);
+}
+
+void Simulator::apply_execution(const ExecutionOptions& options) {
+    pipeline_->set_execution(options);
+}
 
 } // namespace orbitsimlite
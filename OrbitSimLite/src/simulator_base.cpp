@@ -0,0 +1,631 @@
+// OrbitSimLite - SimulatorBase implementation
+#include "simulator_base.hpp"
+
+#include "dense_output.hpp"
+#include "domain.hpp"
+#include "spatial_order.hpp"
+#include "state_publisher.hpp"
+#include "summation.hpp"
+#include "transport.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace orbitsimlite {
+
+SimulatorBase::SimulatorBase(double G, double dt)
+    : G_(G), dt_(dt), substeps_(1), time_(0.0) {}
+
+SimulatorBase::SimulatorBase(const SimulatorBase& other)
+    : G_(other.G_), dt_(other.dt_), bodies_(other.bodies_), handles_(other.handles_), tracers_(other.tracers_),
+      substeps_(other.substeps_), reorder_interval_(other.reorder_interval_),
+      rebalance_interval_(other.rebalance_interval_), auto_eta_(other.auto_eta_),
+      auto_max_substeps_(other.auto_max_substeps_), last_substeps_(other.last_substeps_), time_(other.time_),
+      time_carry_(other.time_carry_),
+      forces_valid_(other.forces_valid_),
+      potential_(other.potential_), drift_callback_(other.drift_callback_),
+      max_drift_(other.max_drift_), energy_ref_(other.energy_ref_),
+      energy_ref_valid_(other.energy_ref_valid_), drift_alerted_(other.drift_alerted_),
+      pool_(other.pool_ ? std::make_unique<ThreadPool>(other.pool_->size()) : nullptr),
+      exec_(other.exec_), next_event_id_(other.next_event_id_), event_samples_(other.event_samples_),
+      dense_output_(other.dense_output_) {
+    exec_.pool = pool_.get();
+    // A copy joining the exchanges of the original's ranks would stall them.
+    exec_.transport = nullptr;
+}
+
+// The derived class re-applies the new pool to its kernel after assignment.
+// The target ends up like a fresh copy: without events, publisher or
+// transport.
+SimulatorBase& SimulatorBase::operator=(const SimulatorBase& other) {
+    if (this != &other) {
+        G_ = other.G_;
+        dt_ = other.dt_;
+        bodies_ = other.bodies_;
+        handles_ = other.handles_;
+        tracers_ = other.tracers_;
+        substeps_ = other.substeps_;
+        reorder_interval_ = other.reorder_interval_;
+        steps_since_reorder_ = 0;
+        rebalance_interval_ = other.rebalance_interval_;
+        steps_since_rebalance_ = 0;
+        auto_eta_ = other.auto_eta_;
+        auto_max_substeps_ = other.auto_max_substeps_;
+        last_substeps_ = other.last_substeps_;
+        time_ = other.time_;
+        time_carry_ = other.time_carry_;
+        forces_valid_ = other.forces_valid_;
+        potential_ = other.potential_;
+        drift_callback_ = other.drift_callback_;
+        max_drift_ = other.max_drift_;
+        energy_ref_ = other.energy_ref_;
+        energy_ref_valid_ = other.energy_ref_valid_;
+        drift_alerted_ = other.drift_alerted_;
+        if (get_threads() != other.get_threads()) {
+            pool_ = other.pool_ ? std::make_unique<ThreadPool>(other.pool_->size()) : nullptr;
+        }
+        exec_ = other.exec_;
+        exec_.pool = pool_.get();
+        exec_.transport = nullptr;
+        publisher_ = nullptr;
+        events_.clear();
+        next_event_id_ = other.next_event_id_;
+        event_samples_ = other.event_samples_;
+        dense_output_ = other.dense_output_;
+        step_start_valid_ = false;
+    }
+    return *this;
+}
+
+// Any external change to the body set invalidates the cached force pass and
+// the energy reference used by the drift alert.
+BodyHandle SimulatorBase::add_body(const Body& b) {
+    sync_handles();
+    bodies_.push_back(b);
+    invalidate_forces();
+    return handles_.insert();
+}
+
+void SimulatorBase::set_bodies(const std::vector<Body>& bs) {
+    bodies_ = bs;
+    handles_.reset(bodies_.size());
+    invalidate_forces();
+}
+
+void SimulatorBase::clear() {
+    bodies_.clear();
+    handles_.reset(0);
+    invalidate_forces();
+}
+
+// Handles -------------------------------------------------------------------
+
+void SimulatorBase::sync_handles() const {
+    if (handles_.size() < bodies_.size()) {
+        while (handles_.size() < bodies_.size()) handles_.insert();
+    } else if (handles_.size() > bodies_.size()) {
+        handles_.reset(bodies_.size());
+    }
+}
+
+bool SimulatorBase::remove_body(BodyHandle h) {
+    const std::size_t index = index_of(h);
+    if (index == HandleTable::npos) return false;
+    remove_body_at(index);
+    return true;
+}
+
+void SimulatorBase::remove_body_at(std::size_t index) {
+    sync_handles();
+    if (index >= bodies_.size()) return;
+    bodies_[index] = bodies_.back();
+    bodies_.pop_back();
+    handles_.erase_at(index);
+    invalidate_forces();
+}
+
+bool SimulatorBase::contains(BodyHandle h) const { return index_of(h) != HandleTable::npos; }
+
+std::size_t SimulatorBase::index_of(BodyHandle h) const {
+    sync_handles();
+    return handles_.index_of(h);
+}
+
+BodyHandle SimulatorBase::handle_at(std::size_t index) const {
+    sync_handles();
+    return (index < bodies_.size()) ? handles_.handle_at(index) : BodyHandle{};
+}
+
+// Spatial ordering ------------------------------------------------------------
+
+// Accelerations and carries travel with the bodies, so the cached force pass
+// stays valid; only the interpolation window refers to the old order.
+void SimulatorBase::reorder_bodies() {
+    sync_handles();
+    spatial_order(bodies_, reorder_);
+    std::vector<Body> sorted;
+    sorted.reserve(bodies_.size());
+    for (std::size_t k : reorder_) sorted.push_back(bodies_[k]);
+    bodies_.swap(sorted);
+    handles_.permute(reorder_);
+    step_start_valid_ = false;
+    steps_since_reorder_ = 0;
+}
+
+void SimulatorBase::set_spatial_reordering(int steps) {
+    reorder_interval_ = (steps > 0) ? steps : 0;
+    steps_since_reorder_ = 0;
+}
+int SimulatorBase::get_spatial_reordering() const { return reorder_interval_; }
+
+const Body* SimulatorBase::find_body(BodyHandle h) const {
+    const std::size_t index = index_of(h);
+    return (index == HandleTable::npos) ? nullptr : &bodies_[index];
+}
+
+Body* SimulatorBase::find_body(BodyHandle h) {
+    const std::size_t index = index_of(h);
+    return (index == HandleTable::npos) ? nullptr : &bodies_[index];
+}
+
+// Test particles do not contribute to the energy, so only the cached
+// accelerations need refreshing.
+void SimulatorBase::add_test_particle(const Vec2& pos, const Vec2& vel) {
+    tracers_.add(pos, vel);
+    forces_valid_ = false;
+}
+
+void SimulatorBase::set_test_particles(const TestParticles& tracers) {
+    tracers_ = tracers;
+    forces_valid_ = false;
+}
+
+void SimulatorBase::clear_test_particles() { tracers_.clear(); }
+
+const TestParticles& SimulatorBase::get_test_particles() const { return tracers_; }
+
+void SimulatorBase::set_dt(double dt__) { dt_ = dt__; }
+double SimulatorBase::get_dt() const { return dt_; }
+
+void SimulatorBase::set_gravity(double G__) {
+    G_ = G__;
+    invalidate_forces();
+}
+double SimulatorBase::get_gravity() const { return G_; }
+
+void SimulatorBase::invalidate_forces() {
+    forces_valid_ = false;
+    energy_ref_valid_ = false;
+    step_start_valid_ = false;
+}
+
+void SimulatorBase::step() {
+    // A rank with an empty domain still takes part in the exchanges.
+    Transport* transport = exec_.transport;
+    if (transport == nullptr && bodies_.empty() && tracers_.empty()) return;
+
+    if (rebalance_interval_ > 0 && ++steps_since_rebalance_ >= rebalance_interval_) rebalance();
+    // Force passes are collective: a pass forced by a local change runs on
+    // every rank.
+    if (transport != nullptr) forces_valid_ = transport->min(forces_valid_ ? 1.0 : 0.0) > 0.0;
+    if (!forces_valid_) {
+        potential_ = refresh_forces(bodies_, tracers_, G_);
+        forces_valid_ = true;
+    }
+    if (drift_callback_ && transport != nullptr) {
+        energy_ref_valid_ = transport->min(energy_ref_valid_ ? 1.0 : 0.0) > 0.0;
+    }
+    if (drift_callback_ && !energy_ref_valid_) reset_energy_reference();
+    if (reorder_interval_ > 0 && ++steps_since_reorder_ >= reorder_interval_) reorder_bodies();
+
+    const double t0 = time_;
+    const bool keep_start = dense_output_ || !events_.empty();
+    if (keep_start) step_start_ = bodies_;
+    step_start_valid_ = false;
+
+    plan_step(dt_);
+    int n = (substeps_ > 0) ? substeps_ : 1;
+    if (auto_eta_ > 0.0) {
+        const double tau = dynamical_timescale();
+        const double limit = auto_eta_ * tau;
+        const double want = (limit > 0.0) ? std::ceil(dt_ / limit) : static_cast<double>(auto_max_substeps_);
+        if (want > n) n = (want < auto_max_substeps_) ? static_cast<int>(want) : std::max(auto_max_substeps_, n);
+    }
+    last_substeps_ = n;
+    const double h = dt_ / static_cast<double>(n);
+    potential_ = advance(bodies_, tracers_, G_, h, n);
+
+    // Advance simulation time by one full step
+    if (exec_.compensated) {
+        compensated_add(time_, time_carry_, dt_);
+    } else {
+        time_ += dt_;
+    }
+
+    if (keep_start) {
+        step_start_time_ = t0;
+        step_start_valid_ = true;
+    }
+    if (!events_.empty()) detect_events(t0);
+    check_energy_drift();
+
+    if (publisher_) publisher_->publish(*this);
+}
+
+const std::vector<Body>& SimulatorBase::get_bodies() const { return bodies_; }
+
+std::vector<Body>& SimulatorBase::access_bodies() {
+    invalidate_forces();
+    return bodies_;
+}
+
+Diagnostics SimulatorBase::diagnostics() const {
+    if (forces_valid_) return compute_diagnostics(bodies_, potential_);
+
+    // No force pass available for the current state: evaluate it on demand
+    // without touching the cache. A rank cannot, since its share of the
+    // potential needs the sources of the others, which only arrive with the
+    // (collective) force pass of the next step.
+    if (exec_.transport != nullptr) {
+        return compute_diagnostics(bodies_, std::numeric_limits<double>::quiet_NaN());
+    }
+    return compute_diagnostics(bodies_, compute_potential(bodies_, G_));
+}
+
+Diagnostics SimulatorBase::system_diagnostics() const {
+    return exec_.transport ? reduce_diagnostics(diagnostics(), *exec_.transport) : diagnostics();
+}
+
+void SimulatorBase::set_energy_drift_alert(double max_relative_drift, DriftCallback callback) {
+    max_drift_ = max_relative_drift;
+    drift_callback_ = std::move(callback);
+    reset_energy_reference();
+}
+
+void SimulatorBase::clear_energy_drift_alert() {
+    drift_callback_ = nullptr;
+    drift_alerted_ = false;
+}
+
+// A rank without a force pass has no energy yet; its next step arms the
+// reference once the forces are known.
+void SimulatorBase::reset_energy_reference() {
+    energy_ref_ = system_diagnostics().total_energy;
+    energy_ref_valid_ = exec_.transport == nullptr || std::isfinite(energy_ref_);
+    drift_alerted_ = false;
+}
+
+double SimulatorBase::get_energy_reference() const { return energy_ref_; }
+
+bool SimulatorBase::energy_drift_exceeded() const { return drift_alerted_; }
+
+void SimulatorBase::check_energy_drift() {
+    if (!drift_callback_ || drift_alerted_ || !energy_ref_valid_) return;
+
+    const Diagnostics d = system_diagnostics();
+    const double drift = relative_drift(d.total_energy, energy_ref_);
+    if (drift > max_drift_) {
+        drift_alerted_ = true;
+        drift_callback_(d, drift);
+    }
+}
+
+void SimulatorBase::set_threads(unsigned n) {
+    if (n == 0) n = std::max(1u, std::thread::hardware_concurrency());
+    if (n == get_threads()) return;
+    pool_ = (n > 1) ? std::make_unique<ThreadPool>(n) : nullptr;
+    exec_.pool = pool_.get();
+    apply_execution(exec_);
+}
+unsigned SimulatorBase::get_threads() const { return pool_ ? pool_->size() : 1u; }
+
+// The potential is part of the cached force pass, so switching the reduction
+// order recomputes it.
+void SimulatorBase::set_reproducible(bool on) {
+    exec_.reproducible = on;
+    apply_execution(exec_);
+    forces_valid_ = false;
+}
+bool SimulatorBase::is_reproducible() const { return exec_.reproducible; }
+
+// Existing carries are kept when the mode is switched off and on again; they
+// are at most an ulp of the value they belong to.
+void SimulatorBase::set_compensated(bool on) {
+    exec_.compensated = on;
+    apply_execution(exec_);
+}
+bool SimulatorBase::is_compensated() const { return exec_.compensated; }
+
+// Domain decomposition ----------------------------------------------------------
+
+bool SimulatorBase::set_transport(Transport* transport) {
+    if (transport != nullptr && !supports_transport()) return false;
+    exec_.transport = transport;
+    apply_execution(exec_);
+    invalidate_forces();
+    steps_since_rebalance_ = 0;
+    return true;
+}
+Transport* SimulatorBase::get_transport() const { return exec_.transport; }
+
+// Departing bodies are removed from the back, so every swap moves a body
+// that stays. The accelerations travel along, but the rank's share of the
+// potential changes, so the force pass is redone. The system itself is
+// unchanged: the energy reference of the drift alert stays.
+bool SimulatorBase::rebalance() {
+    Transport* transport = exec_.transport;
+    if (transport == nullptr) return false;
+    sync_handles();
+    std::vector<int> body_rank, tracer_rank;
+    assign_domains(bodies_, tracers_, *transport, body_rank, tracer_rank);
+    std::vector<Body> arrived;
+    TestParticles arrived_tracers;
+    migrate_to_domains(bodies_, tracers_, body_rank, tracer_rank, *transport, arrived, arrived_tracers);
+
+    const int me = transport->rank();
+    for (std::size_t i = bodies_.size(); i-- > 0;) {
+        if (body_rank[i] == me) continue;
+        bodies_[i] = bodies_.back();
+        bodies_.pop_back();
+        handles_.erase_at(i);
+    }
+    for (const Body& b : arrived) {
+        bodies_.push_back(b);
+        handles_.insert();
+    }
+
+    TestParticles kept;
+    kept.reserve(tracers_.size() + arrived_tracers.size());
+    for (std::size_t k = 0; k < tracers_.size(); ++k) {
+        if (tracer_rank[k] != me) continue;
+        kept.add(tracers_.pos(k), tracers_.vel(k));
+        kept.ax.back() = tracers_.ax[k];
+        kept.ay.back() = tracers_.ay[k];
+    }
+    for (std::size_t k = 0; k < arrived_tracers.size(); ++k) {
+        kept.add(arrived_tracers.pos(k), arrived_tracers.vel(k));
+        kept.ax.back() = arrived_tracers.ax[k];
+        kept.ay.back() = arrived_tracers.ay[k];
+    }
+    tracers_ = std::move(kept);
+
+    forces_valid_ = false;
+    step_start_valid_ = false;
+    steps_since_rebalance_ = 0;
+    return true;
+}
+
+void SimulatorBase::set_rebalancing(int steps) {
+    rebalance_interval_ = (steps > 0) ? steps : 0;
+    steps_since_rebalance_ = 0;
+}
+int SimulatorBase::get_rebalancing() const { return rebalance_interval_; }
+
+// Dense output ----------------------------------------------------------------
+
+void SimulatorBase::set_dense_output(bool on) { dense_output_ = on; }
+bool SimulatorBase::has_dense_output() const { return dense_output_; }
+
+double SimulatorBase::dense_output_begin() const {
+    return step_start_valid_ ? step_start_time_ : std::numeric_limits<double>::quiet_NaN();
+}
+
+bool SimulatorBase::state_at(double t, std::vector<Body>& out) const {
+    if (!step_start_valid_ || step_start_.size() != bodies_.size()) return false;
+    const double h = time_ - step_start_time_;
+    if (!(t >= step_start_time_ && t <= time_) || h <= 0.0) return false;
+    interpolate_bodies(step_start_, bodies_, h, (t - step_start_time_) / h, out);
+    return true;
+}
+
+// Events ----------------------------------------------------------------------
+
+std::size_t SimulatorBase::add_event(const EventCondition& condition, EventCallback callback) {
+    const std::size_t id = next_event_id_++;
+    events_.push_back(EventSlot{id, condition, std::move(callback)});
+    return id;
+}
+
+bool SimulatorBase::remove_event(std::size_t id) {
+    const auto it = std::find_if(events_.begin(), events_.end(), [id](const EventSlot& e) { return e.id == id; });
+    if (it == events_.end()) return false;
+    events_.erase(it);
+    return true;
+}
+
+void SimulatorBase::clear_events() { events_.clear(); }
+
+void SimulatorBase::set_event_samples(int samples) { event_samples_ = (samples > 0) ? samples : 1; }
+int SimulatorBase::get_event_samples() const { return event_samples_; }
+
+// Each condition is sampled on a grid of fractions of the step; in every
+// interval with a crossing in the requested direction the root is refined
+// by the Illinois variant of regula falsi on the interpolated state.
+void SimulatorBase::detect_events(double t0) {
+    if (step_start_.size() != bodies_.size()) return;
+    const double h = time_ - t0;
+    const int samples = event_samples_;
+
+    auto state_at = [&](double f) -> const std::vector<Body>& {
+        if (f <= 0.0) return step_start_;
+        if (f >= 1.0) return bodies_;
+        interpolate_bodies(step_start_, bodies_, h, f, event_state_);
+        return event_state_;
+    };
+
+    struct Hit {
+        double f;
+        std::size_t slot;
+        bool rising;
+    };
+    std::vector<Hit> hits;
+    std::vector<double> g((events_.size()) * static_cast<std::size_t>(samples + 1));
+    for (int k = 0; k <= samples; ++k) {
+        const std::vector<Body>& state = state_at(static_cast<double>(k) / samples);
+        for (std::size_t e = 0; e < events_.size(); ++e) {
+            g[e * (samples + 1) + k] = events_[e].condition.function(state);
+        }
+    }
+
+    for (std::size_t e = 0; e < events_.size(); ++e) {
+        const EventCondition& c = events_[e].condition;
+        for (int k = 0; k < samples; ++k) {
+            double ga = g[e * (samples + 1) + k];
+            double gb = g[e * (samples + 1) + k + 1];
+            const bool rising = ga < 0.0 && gb >= 0.0;
+            const bool falling = ga > 0.0 && gb <= 0.0;
+            if (!(rising && c.direction != EventDirection::Falling) &&
+                !(falling && c.direction != EventDirection::Rising)) {
+                continue;
+            }
+
+            double a = static_cast<double>(k) / samples;
+            double b = static_cast<double>(k + 1) / samples;
+            int side = 0;
+            for (int it = 0; it < 100 && gb != 0.0 && b - a > 1e-15; ++it) {
+                const double m = (a * gb - b * ga) / (gb - ga);
+                const double gm = c.function(state_at(m));
+                if (!std::isfinite(gm)) break;
+                if ((gm < 0.0) == (gb < 0.0) && gm != 0.0) {
+                    b = m;
+                    gb = gm;
+                    if (side == 1) ga *= 0.5;
+                    side = 1;
+                } else {
+                    a = m;
+                    ga = gm;
+                    if (side == -1) gb *= 0.5;
+                    side = -1;
+                    if (gm == 0.0) {
+                        b = m;
+                        break;
+                    }
+                }
+            }
+            hits.push_back(Hit{b, e, rising});
+        }
+    }
+    if (hits.empty()) return;
+
+    std::sort(hits.begin(), hits.end(), [](const Hit& x, const Hit& y) { return x.f < y.f; });
+    // Callbacks may add or remove events, so the slots are copied first.
+    std::vector<EventSlot> slots = events_;
+    for (const Hit& hit : hits) {
+        const EventSlot& slot = slots[hit.slot];
+        if (!slot.callback) continue;
+        slot.callback(EventInfo{slot.id, t0 + hit.f * h, hit.rising}, state_at(hit.f));
+    }
+}
+
+void SimulatorBase::set_state_publisher(StatePublisher* publisher) { publisher_ = publisher; }
+
+StatePublisher* SimulatorBase::get_state_publisher() const { return publisher_; }
+
+const ExecutionOptions& SimulatorBase::execution() const { return exec_; }
+
+void SimulatorBase::set_substeps(int n) { substeps_ = (n > 0) ? n : 1; }
+int SimulatorBase::get_substeps() const { return substeps_; }
+
+void SimulatorBase::set_auto_substeps(double eta, int max_substeps) {
+    auto_eta_ = (eta > 0.0) ? eta : 0.0;
+    auto_max_substeps_ = (max_substeps > 0) ? max_substeps : 1;
+}
+double SimulatorBase::get_auto_substeps() const { return auto_eta_; }
+int SimulatorBase::get_last_substeps() const { return last_substeps_; }
+
+void SimulatorBase::plan_step(double) {}
+
+bool SimulatorBase::pair_resolved(std::size_t, std::size_t) const { return false; }
+
+bool SimulatorBase::supports_transport() const { return true; }
+
+namespace {
+
+// Squared timescale of a pair at squared (softened) distance 'r2' with
+// relative velocity 'dv' (see 'dynamical_timescale').
+double pair_timescale2(double r2, const Vec2& dv, double mu) {
+    double best2 = std::numeric_limits<double>::infinity();
+    if (mu > 0.0) best2 = r2 * std::sqrt(r2) / mu;
+    const double v2 = dv.length_squared();
+    if (v2 > 0.0) best2 = std::min(best2, r2 / v2);
+    return best2;
+}
+
+} // namespace
+
+double SimulatorBase::dynamical_timescale() const {
+    if (exec_.transport != nullptr) return domain_timescale(*exec_.transport);
+
+    double best2 = std::numeric_limits<double>::infinity(); // squared, to defer the sqrt
+    for (std::size_t i = 0; i < bodies_.size(); ++i) {
+        const Body& a = bodies_[i];
+        const bool a_source = !a.is_test_particle && a.mass > 0.0;
+        for (std::size_t j = i + 1; j < bodies_.size(); ++j) {
+            const Body& b = bodies_[j];
+            const bool b_source = !b.is_test_particle && b.mass > 0.0;
+            if (!a_source && !b_source) continue;
+            if (pair_resolved(i, j)) continue;
+
+            const double r2 = (b.pos - a.pos).length_squared() + a.softening * a.softening +
+                              b.softening * b.softening;
+            const double mu = G_ * ((a_source ? a.mass : 0.0) + (b_source ? b.mass : 0.0));
+            best2 = std::min(best2, pair_timescale2(r2, b.vel - a.vel, mu));
+        }
+    }
+    return std::sqrt(best2);
+}
+
+// Every pair with a source has that source on some rank, so each rank pairs
+// its own bodies with the sources of all ranks (position, velocity, mass and
+// softening; the force pass's records lack the velocities). A pair of two
+// sources is seen twice, which the minimum does not mind. The result matches
+// one simulator up to the order in which two softening lengths are added.
+double SimulatorBase::domain_timescale(Transport& transport) const {
+    constexpr std::size_t kFields = 6;
+    std::vector<double> local;
+    for (const Body& b : bodies_) {
+        if (b.is_test_particle || !(b.mass > 0.0)) continue;
+        local.insert(local.end(), {b.pos.x, b.pos.y, b.vel.x, b.vel.y, b.mass, b.softening});
+    }
+    std::vector<unsigned char> all;
+    std::vector<std::size_t> offsets;
+    transport.allgather(local.data(), local.size() * sizeof(double), all, offsets);
+
+    const std::size_t me = static_cast<std::size_t>(transport.rank());
+    const std::size_t own = offsets[me] / (kFields * sizeof(double));
+    const std::size_t count = all.size() / (kFields * sizeof(double));
+    std::vector<double> sources(count * kFields);
+    if (!all.empty()) std::memcpy(sources.data(), all.data(), sources.size() * sizeof(double));
+
+    double best2 = std::numeric_limits<double>::infinity();
+    std::size_t source = own; // record of the current body, when it is a source
+    for (const Body& a : bodies_) {
+        const bool a_source = !a.is_test_particle && a.mass > 0.0;
+        const std::size_t self = a_source ? source++ : count;
+        for (std::size_t j = 0; j < count; ++j) {
+            if (j == self) continue;
+            const double* s = &sources[j * kFields];
+            const double r2 = (Vec2{s[0], s[1]} - a.pos).length_squared() + a.softening * a.softening + s[5] * s[5];
+            const double mu = G_ * ((a_source ? a.mass : 0.0) + s[4]);
+            best2 = std::min(best2, pair_timescale2(r2, Vec2{s[2], s[3]} - a.vel, mu));
+        }
+    }
+    return std::sqrt(transport.min(best2));
+}
+
+double SimulatorBase::get_time() const { return time_; }
+void SimulatorBase::reset_time() {
+    time_ = 0.0;
+    time_carry_ = 0.0;
+    step_start_valid_ = false;
+}
+void SimulatorBase::set_time(double t) {
+    time_ = t;
+    time_carry_ = 0.0;
+    step_start_valid_ = false;
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,266 @@
+// OrbitSimLite - Snapshot encoder/decoder implementation
+#include "snapshot_codec.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "lz_codec.hpp"
+
+namespace orbitsimlite {
+
+namespace {
+
+constexpr std::uint8_t kKeyframeFlag = 1u << 0;
+constexpr std::uint8_t kAccelerationFlag = 1u << 1;
+
+// Quantized values are clamped well inside the int64 range so that the
+// prediction arithmetic cannot overflow.
+constexpr double kQuantLimit = 4.0e18;
+
+std::int64_t quantize(double value, double reference, double step) {
+    const double q = std::clamp((value - reference) / step, -kQuantLimit, kQuantLimit);
+    return static_cast<std::int64_t>(std::llround(q));
+}
+
+double dequantize(std::int64_t q, double reference, double step) {
+    return reference + static_cast<double>(q) * step;
+}
+
+// Polynomial extrapolation from up to three previous snapshots (constant,
+// linear, quadratic), in wrap-around arithmetic so that encoder and decoder
+// agree bit for bit.
+std::uint64_t predict(std::uint32_t history, std::int64_t prev, std::int64_t prev2, std::int64_t prev3) {
+    const auto p1 = static_cast<std::uint64_t>(prev);
+    const auto p2 = static_cast<std::uint64_t>(prev2);
+    const auto p3 = static_cast<std::uint64_t>(prev3);
+    switch (history) {
+    case 0: return 0;
+    case 1: return p1;
+    case 2: return 2 * p1 - p2;
+    default: return 3 * p1 - 3 * p2 + p3;
+    }
+}
+
+std::uint64_t zigzag(std::uint64_t v) {
+    return (v << 1) ^ (0 - (v >> 63));
+}
+
+std::uint64_t unzigzag(std::uint64_t v) {
+    return (v >> 1) ^ (0 - (v & 1));
+}
+
+void put_double(std::vector<std::uint8_t>& out, double v) {
+    std::uint8_t bytes[sizeof(double)];
+    std::memcpy(bytes, &v, sizeof(v));
+    out.insert(out.end(), bytes, bytes + sizeof(v));
+}
+
+bool get_double(const std::uint8_t* src, std::size_t size, std::size_t& at, double& v) {
+    if (at > size || size - at < sizeof(double)) return false;
+    std::memcpy(&v, src + at, sizeof(v));
+    at += sizeof(v);
+    return true;
+}
+
+bool same_masses(const std::vector<Body>& bodies, const std::vector<double>& mass) {
+    if (bodies.size() != mass.size()) return false;
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        if (std::memcmp(&bodies[i].mass, &mass[i], sizeof(double)) != 0) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+// Encoder -------------------------------------------------------------------
+
+SnapshotEncoder::SnapshotEncoder(const SnapshotCodecOptions& options) : options_(options), active_(options) {}
+
+void SnapshotEncoder::set_options(const SnapshotCodecOptions& options) { options_ = options; }
+
+const SnapshotCodecOptions& SnapshotEncoder::options() const { return options_; }
+
+void SnapshotEncoder::force_keyframe() { need_keyframe_ = true; }
+
+void SnapshotEncoder::encode(const SimulatorBase& sim, std::vector<std::uint8_t>& out) {
+    encode(sim.get_bodies(), sim.get_time(), out);
+}
+
+void SnapshotEncoder::encode(const std::vector<Body>& bodies, double time, std::vector<std::uint8_t>& out) {
+    const std::size_t n = bodies.size();
+
+    const bool keyframe = need_keyframe_ || since_keyframe_ >= std::max<std::uint32_t>(active_.keyframe_interval, 1) ||
+                          !same_masses(bodies, mass_) ||
+                          options_.include_acceleration != active_.include_acceleration;
+    if (keyframe) {
+        active_ = options_;
+        need_keyframe_ = false;
+        since_keyframe_ = 0;
+        history_ = 0;
+
+        // Reference frame: centre of mass and its velocity.
+        mass_.resize(n);
+        double total = 0.0;
+        Vec2 mp, mv;
+        for (std::size_t i = 0; i < n; ++i) {
+            mass_[i] = bodies[i].mass;
+            total += bodies[i].mass;
+            mp += bodies[i].pos * bodies[i].mass;
+            mv += bodies[i].vel * bodies[i].mass;
+        }
+        ref_pos_ = (total > 0.0) ? mp / total : Vec2{};
+        ref_vel_ = (total > 0.0) ? mv / total : Vec2{};
+    }
+    ++since_keyframe_;
+
+    const bool acc = active_.include_acceleration;
+    const std::size_t channels = acc ? 6 : 4;
+    quantized_.resize(channels * n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const Body& b = bodies[i];
+        quantized_[0 * n + i] = quantize(b.pos.x, ref_pos_.x, active_.position_step);
+        quantized_[1 * n + i] = quantize(b.pos.y, ref_pos_.y, active_.position_step);
+        quantized_[2 * n + i] = quantize(b.vel.x, ref_vel_.x, active_.velocity_step);
+        quantized_[3 * n + i] = quantize(b.vel.y, ref_vel_.y, active_.velocity_step);
+        if (acc) {
+            quantized_[4 * n + i] = quantize(b.acc.x, 0.0, active_.acceleration_step);
+            quantized_[5 * n + i] = quantize(b.acc.y, 0.0, active_.acceleration_step);
+        }
+    }
+
+    raw_.clear();
+    raw_.push_back(static_cast<std::uint8_t>((keyframe ? kKeyframeFlag : 0) | (acc ? kAccelerationFlag : 0)));
+    put_varint(raw_, n);
+    put_double(raw_, time);
+    if (keyframe) {
+        put_double(raw_, active_.position_step);
+        put_double(raw_, active_.velocity_step);
+        put_double(raw_, active_.acceleration_step);
+        put_double(raw_, ref_pos_.x);
+        put_double(raw_, ref_pos_.y);
+        put_double(raw_, ref_vel_.x);
+        put_double(raw_, ref_vel_.y);
+        for (double m : mass_) put_double(raw_, m);
+    }
+
+    prev_.resize(quantized_.size());
+    prev2_.resize(quantized_.size());
+    prev3_.resize(quantized_.size());
+    for (std::size_t k = 0; k < quantized_.size(); ++k) {
+        const std::uint64_t residual =
+            static_cast<std::uint64_t>(quantized_[k]) - predict(history_, prev_[k], prev2_[k], prev3_[k]);
+        put_varint(raw_, zigzag(residual));
+    }
+    prev3_.swap(prev2_);
+    prev2_.swap(prev_);
+    prev_.swap(quantized_);
+    history_ = std::min<std::uint32_t>(history_ + 1, 3);
+
+    packed_.clear();
+    lz_compress(raw_.data(), raw_.size(), packed_);
+    put_varint(out, raw_.size());
+    put_varint(out, packed_.size());
+    out.insert(out.end(), packed_.begin(), packed_.end());
+}
+
+// Decoder -------------------------------------------------------------------
+
+void SnapshotDecoder::reset() {
+    synced_ = false;
+    history_ = 0;
+}
+
+bool SnapshotDecoder::decode(const std::uint8_t* data, std::size_t size, std::size_t& offset, Snapshot& out) {
+    std::size_t at = offset;
+    std::uint64_t raw_size = 0, packed_size = 0;
+    if (!get_varint(data, size, at, raw_size) || !get_varint(data, size, at, packed_size)) return false;
+    if (packed_size > size - at) return false;
+    // Both sizes are untrusted: the block cannot expand beyond the LZ bound.
+    if (raw_size > lz_max_decompressed_size(static_cast<std::size_t>(packed_size))) return false;
+    if (!lz_decompress(data + at, static_cast<std::size_t>(packed_size), static_cast<std::size_t>(raw_size), raw_)) {
+        return false;
+    }
+    at += static_cast<std::size_t>(packed_size);
+
+    // A snapshot that decompressed but does not parse breaks the chain.
+    auto fail = [this] {
+        synced_ = false;
+        return false;
+    };
+
+    const std::uint8_t* src = raw_.data();
+    const std::size_t len = raw_.size();
+    std::size_t r = 0;
+    if (len < 1) return fail();
+    const std::uint8_t flags = src[r++];
+    const bool keyframe = (flags & kKeyframeFlag) != 0;
+    const bool acc = (flags & kAccelerationFlag) != 0;
+
+    std::uint64_t count = 0;
+    double time = 0.0;
+    if (!get_varint(src, len, r, count) || !get_double(src, len, r, time)) return fail();
+    if (count > len) return fail(); // every body needs at least one byte per channel
+
+    if (keyframe) {
+        double ref[4];
+        if (!get_double(src, len, r, steps_[0]) || !get_double(src, len, r, steps_[1]) ||
+            !get_double(src, len, r, steps_[2])) {
+            return fail();
+        }
+        for (double& v : ref) {
+            if (!get_double(src, len, r, v)) return fail();
+        }
+        ref_pos_ = Vec2{ref[0], ref[1]};
+        ref_vel_ = Vec2{ref[2], ref[3]};
+        mass_.resize(static_cast<std::size_t>(count));
+        for (double& m : mass_) {
+            if (!get_double(src, len, r, m)) return fail();
+        }
+        count_ = static_cast<std::size_t>(count);
+        has_acc_ = acc;
+        history_ = 0;
+        synced_ = true;
+    } else if (!synced_ || count != count_ || acc != has_acc_) {
+        return fail();
+    }
+
+    const std::size_t n = count_;
+    const std::size_t channels = has_acc_ ? 6 : 4;
+    std::vector<std::int64_t> q(channels * n);
+    prev_.resize(q.size());
+    prev2_.resize(q.size());
+    prev3_.resize(q.size());
+    for (std::size_t k = 0; k < q.size(); ++k) {
+        std::uint64_t z = 0;
+        if (!get_varint(src, len, r, z)) return fail();
+        q[k] = static_cast<std::int64_t>(unzigzag(z) + predict(history_, prev_[k], prev2_[k], prev3_[k]));
+    }
+    if (r != len) return fail();
+
+    prev3_.swap(prev2_);
+    prev2_.swap(prev_);
+    prev_.swap(q);
+    history_ = std::min<std::uint32_t>(history_ + 1, 3);
+
+    out.time = time;
+    out.keyframe = keyframe;
+    out.mass = mass_;
+    out.pos.resize(n);
+    out.vel.resize(n);
+    out.acc.resize(has_acc_ ? n : 0);
+    for (std::size_t i = 0; i < n; ++i) {
+        out.pos[i] = Vec2{dequantize(prev_[0 * n + i], ref_pos_.x, steps_[0]),
+                          dequantize(prev_[1 * n + i], ref_pos_.y, steps_[0])};
+        out.vel[i] = Vec2{dequantize(prev_[2 * n + i], ref_vel_.x, steps_[1]),
+                          dequantize(prev_[3 * n + i], ref_vel_.y, steps_[1])};
+        if (has_acc_) {
+            out.acc[i] = Vec2{dequantize(prev_[4 * n + i], 0.0, steps_[2]),
+                              dequantize(prev_[5 * n + i], 0.0, steps_[2])};
+        }
+    }
+    offset = at;
+    return true;
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,64 @@
+// OrbitSimLite - Morton ordering
+#include "spatial_order.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace orbitsimlite {
+
+namespace {
+
+// Spread the low 16 bits of 'v' to the even bit positions.
+std::uint32_t spread_bits(std::uint32_t v) {
+    v &= 0x0000FFFFu;
+    v = (v | (v << 8)) & 0x00FF00FFu;
+    v = (v | (v << 4)) & 0x0F0F0F0Fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+} // namespace
+
+std::uint32_t morton_key(std::uint32_t x, std::uint32_t y) { return spread_bits(x) | (spread_bits(y) << 1); }
+
+// Keys are sorted together with the indices so the comparison stays in one
+// contiguous array; non-finite positions go last.
+void spatial_order(const std::vector<Body>& bodies, std::vector<std::size_t>& order) {
+    const std::size_t n = bodies.size();
+    order.resize(n);
+    std::iota(order.begin(), order.end(), std::size_t {0});
+    if (n < 2) return;
+
+    constexpr double inf = std::numeric_limits<double>::infinity();
+    double x0 = inf, x1 = -inf, y0 = inf, y1 = -inf;
+    for (const Body& b : bodies) {
+        if (!std::isfinite(b.pos.x) || !std::isfinite(b.pos.y)) continue;
+        x0 = std::min(x0, b.pos.x);
+        x1 = std::max(x1, b.pos.x);
+        y0 = std::min(y0, b.pos.y);
+        y1 = std::max(y1, b.pos.y);
+    }
+    if (!(x0 <= x1)) return; // no finite position
+    const double extent = std::max(x1 - x0, y1 - y0);
+    const double scale = (extent > 0.0) ? 65535.0 / extent : 0.0;
+
+    std::vector<std::pair<std::uint64_t, std::size_t>> keyed(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const Vec2& p = bodies[i].pos;
+        std::uint64_t key = std::uint64_t {1} << 32;
+        if (std::isfinite(p.x) && std::isfinite(p.y)) {
+            const double cx = std::clamp((p.x - x0) * scale, 0.0, 65535.0);
+            const double cy = std::clamp((p.y - y0) * scale, 0.0, 65535.0);
+            key = morton_key(static_cast<std::uint32_t>(cx), static_cast<std::uint32_t>(cy));
+        }
+        keyed[i] = {key, i};
+    }
+    std::sort(keyed.begin(), keyed.end());
+    for (std::size_t k = 0; k < n; ++k) order[k] = keyed[k].second;
+}
+
+} // namespace orbitsimlite
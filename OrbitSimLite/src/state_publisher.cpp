@@ -0,0 +1,287 @@
+// OrbitSimLite - StatePublisher / StateReader implementation
+#include "state_publisher.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include "simulator_base.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace orbitsimlite {
+
+namespace {
+
+constexpr std::uint32_t kRegionMagic = 0x4253534Fu; // "OSSB"
+constexpr std::uint32_t kRegionVersion = 1;
+constexpr std::size_t kAlign = 64; // slots start on their own cache line
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "the shared region needs address-free 64-bit atomics");
+
+std::size_t round_up(std::size_t n) { return (n + kAlign - 1) / kAlign * kAlign; }
+
+std::size_t slots_offset() { return round_up(sizeof(StateRegionHeader)); }
+
+std::size_t slot_stride(std::size_t capacity) {
+    return round_up(sizeof(StateSlotHeader) + capacity * sizeof(PublishedBody));
+}
+
+std::size_t region_size(std::size_t capacity, unsigned slots) {
+    return slots_offset() + slots * slot_stride(capacity);
+}
+
+const StateRegionHeader* header_of(const unsigned char* base) {
+    return reinterpret_cast<const StateRegionHeader*>(base);
+}
+
+const StateSlotHeader* slot_of(const unsigned char* base, std::uint64_t generation) {
+    const StateRegionHeader* h = header_of(base);
+    const std::size_t index = static_cast<std::size_t>((generation - 1) % h->slots);
+    return reinterpret_cast<const StateSlotHeader*>(base + slots_offset() + index * h->slot_stride);
+}
+
+const PublishedBody* bodies_of(const StateSlotHeader* slot) {
+    return reinterpret_cast<const PublishedBody*>(slot + 1);
+}
+
+void fill(PublishedBody& out, const Body& b) {
+    out.mass = b.mass;
+    out.pos[0] = b.pos.x;
+    out.pos[1] = b.pos.y;
+    out.vel[0] = b.vel.x;
+    out.vel[1] = b.vel.y;
+    out.acc[0] = b.acc.x;
+    out.acc[1] = b.acc.y;
+    out.radius = b.radius;
+    out.color = b.color;
+    out.flags = (b.is_star ? kPublishedStar : 0u) | (b.is_satellite ? kPublishedSatellite : 0u) |
+                (b.is_test_particle ? kPublishedPassive : 0u);
+    const std::string& name = b.name();
+    const std::size_t len = std::min(name.size(), sizeof(out.name) - 1);
+    std::memcpy(out.name, name.data(), len);
+    std::memset(out.name + len, 0, sizeof(out.name) - len);
+}
+
+void set_error(std::string* error, const std::string& what) {
+    if (error) *error = what;
+}
+
+} // namespace
+
+// Publisher -------------------------------------------------------------------
+
+StatePublisher::StatePublisher(std::size_t capacity, unsigned slots) {
+    slots = std::max(slots, 2u);
+    size_ = region_size(capacity, slots);
+    base_ = static_cast<unsigned char*>(::operator new(size_, std::align_val_t(kAlign)));
+    init(capacity, slots);
+}
+
+std::unique_ptr<StatePublisher> StatePublisher::create_shared(const std::string& name, std::size_t capacity,
+                                                              unsigned slots, std::string* error) {
+#ifdef _WIN32
+    (void)name;
+    (void)capacity;
+    (void)slots;
+    set_error(error, "shared memory regions are not supported on this platform");
+    return nullptr;
+#else
+    slots = std::max(slots, 2u);
+    const std::size_t size = region_size(capacity, slots);
+
+    ::shm_unlink(name.c_str());
+    const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        set_error(error, "shm_open '" + name + "': " + std::strerror(errno));
+        return nullptr;
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        set_error(error, std::string("ftruncate: ") + std::strerror(errno));
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        return nullptr;
+    }
+    void* base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        set_error(error, std::string("mmap: ") + std::strerror(errno));
+        ::shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    std::unique_ptr<StatePublisher> pub(new StatePublisher());
+    pub->base_ = static_cast<unsigned char*>(base);
+    pub->size_ = size;
+    pub->shm_name_ = name;
+    pub->init(capacity, slots);
+    return pub;
+#endif
+}
+
+StatePublisher::~StatePublisher() {
+    if (!base_) return;
+    if (shm_name_.empty()) {
+        ::operator delete(base_, std::align_val_t(kAlign));
+        return;
+    }
+#ifndef _WIN32
+    ::munmap(base_, size_);
+    ::shm_unlink(shm_name_.c_str());
+#endif
+}
+
+void StatePublisher::init(std::size_t capacity, unsigned slots) {
+    auto* h = new (base_) StateRegionHeader();
+    h->magic = kRegionMagic;
+    h->version = kRegionVersion;
+    h->slots = slots;
+    h->capacity = static_cast<std::uint32_t>(capacity);
+    h->slot_stride = slot_stride(capacity);
+    h->latest.store(0, std::memory_order_relaxed);
+    for (unsigned k = 0; k < slots; ++k) {
+        auto* slot = new (base_ + slots_offset() + k * h->slot_stride) StateSlotHeader();
+        slot->sequence.store(0, std::memory_order_relaxed);
+        slot->generation = 0;
+        slot->time = 0.0;
+        slot->count = 0;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+std::size_t StatePublisher::capacity() const { return header_of(base_)->capacity; }
+
+unsigned StatePublisher::slots() const { return header_of(base_)->slots; }
+
+bool StatePublisher::publish(const SimulatorBase& sim) { return publish(sim.get_bodies(), sim.get_time()); }
+
+// Seqlock write: odd sequence, release fence, payload, even sequence
+// (release), then advertise the slot through 'latest'.
+bool StatePublisher::publish(const std::vector<Body>& bodies, double time) {
+    auto* h = reinterpret_cast<StateRegionHeader*>(base_);
+    if (bodies.size() > h->capacity) return false;
+
+    const std::uint64_t generation = h->latest.load(std::memory_order_relaxed) + 1;
+    auto* slot = const_cast<StateSlotHeader*>(slot_of(base_, generation));
+    auto* out = const_cast<PublishedBody*>(bodies_of(slot));
+
+    const std::uint64_t seq = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->generation = generation;
+    slot->time = time;
+    slot->count = bodies.size();
+    for (std::size_t i = 0; i < bodies.size(); ++i) fill(out[i], bodies[i]);
+
+    slot->sequence.store(seq + 2, std::memory_order_release);
+    h->latest.store(generation, std::memory_order_release);
+    return true;
+}
+
+// Reader ----------------------------------------------------------------------
+
+StateReader::StateReader(const StatePublisher& publisher)
+    : base_(publisher.base_), size_(publisher.size_) {}
+
+std::unique_ptr<StateReader> StateReader::open_shared(const std::string& name, std::string* error) {
+#ifdef _WIN32
+    (void)name;
+    set_error(error, "shared memory regions are not supported on this platform");
+    return nullptr;
+#else
+    const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        set_error(error, "shm_open '" + name + "': " + std::strerror(errno));
+        return nullptr;
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(StateRegionHeader)) {
+        set_error(error, "'" + name + "' is not a snapshot region");
+        ::close(fd);
+        return nullptr;
+    }
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* base = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        set_error(error, std::string("mmap: ") + std::strerror(errno));
+        return nullptr;
+    }
+
+    const StateRegionHeader* h = header_of(static_cast<const unsigned char*>(base));
+    if (h->magic != kRegionMagic || h->version != kRegionVersion || h->slots < 2 ||
+        h->slot_stride != slot_stride(h->capacity) || region_size(h->capacity, h->slots) > size) {
+        set_error(error, "'" + name + "' is not a compatible snapshot region");
+        ::munmap(base, size);
+        return nullptr;
+    }
+
+    std::unique_ptr<StateReader> reader(new StateReader());
+    reader->base_ = static_cast<const unsigned char*>(base);
+    reader->size_ = size;
+    reader->mapped_ = true;
+    return reader;
+#endif
+}
+
+StateReader::~StateReader() {
+#ifndef _WIN32
+    if (mapped_) ::munmap(const_cast<unsigned char*>(base_), size_);
+#endif
+}
+
+bool StateReader::acquire(View& view) const {
+    const StateRegionHeader* h = header_of(base_);
+    for (;;) {
+        const std::uint64_t generation = h->latest.load(std::memory_order_acquire);
+        if (generation == 0) return false;
+
+        const StateSlotHeader* slot = slot_of(base_, generation);
+        const std::uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+        if (seq & 1) continue; // the writer has lapped us and is refilling it
+
+        const std::uint64_t slot_generation = slot->generation;
+        const double time = slot->time;
+        const std::uint64_t count = slot->count;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) != seq || slot_generation != generation) continue;
+        if (count > h->capacity) return false;
+
+        view.bodies = bodies_of(slot);
+        view.count = static_cast<std::size_t>(count);
+        view.time = time;
+        view.generation = generation;
+        view.sequence = seq;
+        view.slot = slot;
+        return true;
+    }
+}
+
+bool StateReader::still_valid(const View& view) const {
+    if (!view.slot) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+bool StateReader::read(std::vector<PublishedBody>& out, double* time, std::uint64_t* generation) const {
+    View view;
+    for (;;) {
+        if (!acquire(view)) return false;
+        out.resize(view.count);
+        if (view.count > 0) std::memcpy(out.data(), view.bodies, view.count * sizeof(PublishedBody));
+        if (!still_valid(view)) continue;
+        if (time) *time = view.time;
+        if (generation) *generation = view.generation;
+        return true;
+    }
+}
+
+} // namespace orbitsimlite
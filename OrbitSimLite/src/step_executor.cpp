@@ -0,0 +1,152 @@
+// OrbitSimLite - StepExecutor implementation
+#include "step_executor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <utility>
+
+#include "simulator_base.hpp"
+
+namespace orbitsimlite {
+
+struct StepExecutor::Job {
+    SimulatorBase* sim {nullptr};
+    double target {0.0};
+    std::uint64_t total {0};
+    std::uint64_t steps {0};
+    ProgressCallback progress;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    std::promise<AdvanceResult> promise;
+
+    void finish(AdvanceStatus status) {
+        promise.set_value(AdvanceResult{status, sim->get_time(), steps});
+    }
+};
+
+// Handle ----------------------------------------------------------------------
+
+void AdvanceHandle::cancel() {
+    if (cancel_) cancel_->store(true, std::memory_order_relaxed);
+}
+
+bool AdvanceHandle::ready() const {
+    return future_.valid() && future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+// Executor --------------------------------------------------------------------
+
+StepExecutor::StepExecutor(unsigned workers, std::uint64_t chunk_steps)
+    : chunk_steps_(std::max<std::uint64_t>(chunk_steps, 1)) {
+    if (workers == 0) workers = std::thread::hardware_concurrency();
+    if (workers == 0) workers = 1;
+    threads_.reserve(workers);
+    for (unsigned w = 0; w < workers; ++w) {
+        threads_.emplace_back([this] { worker_loop(); });
+    }
+}
+
+StepExecutor::~StepExecutor() {
+    std::deque<std::unique_ptr<Job>> queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        queued.swap(ready_);
+    }
+    wake_.notify_all();
+    for (auto& job : queued) job->finish(AdvanceStatus::Cancelled);
+    for (auto& t : threads_) t.join();
+}
+
+unsigned StepExecutor::workers() const { return static_cast<unsigned>(threads_.size()); }
+
+std::uint64_t StepExecutor::chunk_steps() const { return chunk_steps_; }
+
+std::size_t StepExecutor::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ready_.size() + running_;
+}
+
+// The step count is fixed up front so that rounding in the accumulated time
+// cannot add or drop a step.
+AdvanceHandle StepExecutor::advance_until(SimulatorBase& sim, double t, ProgressCallback progress) {
+    auto job = std::make_unique<Job>();
+    job->sim = &sim;
+    job->target = t;
+    const double dt = sim.get_dt();
+    const double remaining = (dt > 0.0) ? (t - sim.get_time()) / dt : 0.0;
+    job->total = (remaining > 0.0) ? static_cast<std::uint64_t>(std::ceil(remaining - 1e-9)) : 0;
+    job->progress = std::move(progress);
+    job->cancel = std::make_shared<std::atomic<bool>>(false);
+
+    AdvanceHandle handle;
+    handle.cancel_ = job->cancel;
+    handle.future_ = job->promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+            job->finish(AdvanceStatus::Cancelled);
+            return handle;
+        }
+        ready_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+    return handle;
+}
+
+bool StepExecutor::run_chunk(Job& job) {
+    if (job.cancel->load(std::memory_order_relaxed)) {
+        job.finish(AdvanceStatus::Cancelled);
+        return true;
+    }
+    try {
+        const std::uint64_t n = std::min(chunk_steps_, job.total - job.steps);
+        for (std::uint64_t k = 0; k < n; ++k) job.sim->step();
+        job.steps += n;
+        if (job.progress && n > 0) {
+            job.progress(AdvanceProgress{job.sim->get_time(), job.target, job.steps, job.total});
+        }
+    } catch (...) {
+        job.promise.set_exception(std::current_exception());
+        return true;
+    }
+    if (job.steps < job.total) return false;
+    job.finish(AdvanceStatus::Completed);
+    return true;
+}
+
+// A job that needs more chunks goes to the back of the queue, which gives
+// every queued simulator one chunk per round.
+void StepExecutor::worker_loop() {
+    for (;;) {
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || !ready_.empty(); });
+            if (ready_.empty()) return;
+            job = std::move(ready_.front());
+            ready_.pop_front();
+            ++running_;
+        }
+
+        const bool ended = run_chunk(*job);
+
+        bool requeued = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --running_;
+            if (!ended && !stop_) {
+                ready_.push_back(std::move(job));
+                requeued = true;
+            }
+        }
+        if (requeued) {
+            wake_.notify_one();
+        } else if (!ended) {
+            job->finish(AdvanceStatus::Cancelled);
+        }
+    }
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,74 @@
+// OrbitSimLite - TaskQueue implementation
+#include "task_queue.hpp"
+
+#include <utility>
+
+namespace orbitsimlite {
+
+TaskQueue::TaskQueue(unsigned workers, std::size_t capacity) {
+    if (workers == 0) workers = std::thread::hardware_concurrency();
+    if (workers == 0) workers = 1;
+    capacity_ = (capacity > 0) ? capacity : 2 * static_cast<std::size_t>(workers);
+    threads_.reserve(workers);
+    for (unsigned w = 0; w < workers; ++w) {
+        threads_.emplace_back([this] { worker_loop(); });
+    }
+}
+
+TaskQueue::~TaskQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    not_empty_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+unsigned TaskQueue::workers() const { return static_cast<unsigned>(threads_.size()); }
+
+void TaskQueue::push(Task task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return tasks_.size() < capacity_; });
+    tasks_.push_back(std::move(task));
+    lock.unlock();
+    not_empty_.notify_one();
+}
+
+void TaskQueue::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return tasks_.empty() && running_ == 0; });
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+// Workers drain the queue before honouring 'stop_', so destruction never
+// drops pushed tasks.
+void TaskQueue::worker_loop() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+            if (tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+            ++running_;
+        }
+        not_full_.notify_one();
+
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (error && !error_) error_ = error;
+            --running_;
+            if (tasks_.empty() && running_ == 0) idle_.notify_all();
+        }
+    }
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,481 @@
+// OrbitSimLite - Telemetry server and client implementation
+#include "telemetry.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace orbitsimlite {
+
+using Frame = std::shared_ptr<const std::vector<char>>;
+
+// State handed from the publisher to the delivery thread. Kept alive by
+// both sides, so the thread never touches the server object.
+struct TelemetryServer::Shared {
+    std::mutex mutex;
+    Frame state;
+    Frame catalog;
+    std::uint64_t state_sequence {0};
+    std::uint64_t catalog_revision {0};
+    bool stop {false};
+
+    int listen_fd {-1};
+    int wake_read {-1};
+    int wake_write {-1};
+    std::atomic<std::size_t> clients {0};
+};
+
+namespace {
+
+void append_bytes(std::vector<char>& out, const void* data, std::size_t size) {
+    const char* p = static_cast<const char*>(data);
+    out.insert(out.end(), p, p + size);
+}
+
+TelemetryHeader make_header(TelemetryMessage type, std::size_t count, std::uint64_t sequence,
+                            double time, std::uint64_t catalog) {
+    TelemetryHeader h {};
+    h.magic = kTelemetryMagic;
+    h.version = kTelemetryVersion;
+    h.type = static_cast<std::uint16_t>(type);
+    h.count = static_cast<std::uint32_t>(count);
+    h.sequence = sequence;
+    h.time = time;
+    h.catalog = catalog;
+    return h;
+}
+
+void finish(std::vector<char>& message) {
+    const auto size = static_cast<std::uint32_t>(message.size());
+    std::memcpy(message.data() + offsetof(TelemetryHeader, size), &size, sizeof(size));
+}
+
+// Catalog record of a body as sent, without the name length.
+TelemetryCatalogEntry catalog_entry(const Body& b) {
+    TelemetryCatalogEntry e {};
+    e.color = b.color;
+    e.radius = static_cast<float>(b.radius);
+    e.flags = (b.is_star ? kTelemetryStar : 0u) | (b.is_satellite ? kTelemetrySatellite : 0u) |
+              (b.is_test_particle ? kTelemetryPassive : 0u);
+    return e;
+}
+
+Frame encode_catalog(const std::vector<Body>& bodies, std::uint64_t revision, double time) {
+    auto out = std::make_shared<std::vector<char>>();
+    const TelemetryHeader h = make_header(TelemetryMessage::Catalog, bodies.size(), revision, time, revision);
+    append_bytes(*out, &h, sizeof(h));
+    for (const auto& b : bodies) {
+        TelemetryCatalogEntry e = catalog_entry(b);
+        const std::string& name = b.name();
+        e.name_length = static_cast<std::uint32_t>(name.size());
+        append_bytes(*out, &e, sizeof(e));
+        append_bytes(*out, name.data(), name.size());
+    }
+    finish(*out);
+    return out;
+}
+
+Frame encode_state(const std::vector<Body>& bodies, std::uint64_t sequence, std::uint64_t revision, double time) {
+    auto out = std::make_shared<std::vector<char>>();
+    out->reserve(sizeof(TelemetryHeader) + bodies.size() * sizeof(TelemetryBodyState));
+    const TelemetryHeader h = make_header(TelemetryMessage::State, bodies.size(), sequence, time, revision);
+    append_bytes(*out, &h, sizeof(h));
+    for (const auto& b : bodies) {
+        const TelemetryBodyState s {b.mass, {b.pos.x, b.pos.y}, {b.vel.x, b.vel.y}, {b.acc.x, b.acc.y}};
+        append_bytes(*out, &s, sizeof(s));
+    }
+    finish(*out);
+    return out;
+}
+
+#ifndef _WIN32
+
+void close_fd(int& fd) {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+struct Subscriber {
+    int fd {-1};
+    Frame pending;
+    std::size_t offset {0};
+    std::uint64_t sent_sequence {0};
+    std::uint64_t sent_catalog {0};
+    bool pending_is_catalog {false};
+    bool dead {false};
+};
+
+// Queue the next message for 's': the catalog first if it is out of date,
+// otherwise the newest state frame it has not seen yet.
+void refill(Subscriber& s, const Frame& catalog, std::uint64_t revision, const Frame& state,
+            std::uint64_t sequence) {
+    if (s.pending) return;
+    if (catalog && s.sent_catalog != revision) {
+        s.pending = catalog;
+        s.pending_is_catalog = true;
+    } else if (state && s.sent_sequence != sequence) {
+        s.pending = state;
+        s.pending_is_catalog = false;
+    }
+    s.offset = 0;
+}
+
+// Send as much as the socket accepts without blocking.
+void flush(Subscriber& s, const Frame& catalog, std::uint64_t revision, const Frame& state,
+           std::uint64_t sequence) {
+    refill(s, catalog, revision, state, sequence);
+    while (s.pending && !s.dead) {
+        const std::vector<char>& data = *s.pending;
+        const ssize_t n = ::send(s.fd, data.data() + s.offset, data.size() - s.offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR) continue;
+            s.dead = true;
+            return;
+        }
+        s.offset += static_cast<std::size_t>(n);
+        if (s.offset < data.size()) continue;
+
+        // Record what the message was, not what is current: a catalog that
+        // changed while this one was in flight is sent again.
+        TelemetryHeader h;
+        std::memcpy(&h, data.data(), sizeof(h));
+        if (s.pending_is_catalog) {
+            s.sent_catalog = h.sequence;
+        } else {
+            s.sent_sequence = h.sequence;
+        }
+        s.pending.reset();
+        refill(s, catalog, revision, state, sequence);
+    }
+}
+
+#endif
+
+} // namespace
+
+#ifndef _WIN32
+
+// Delivery thread: accepts subscribers and pushes frames to them.
+void TelemetryServer::serve(std::shared_ptr<Shared> shared, std::size_t max_clients) {
+    std::vector<Subscriber> subs;
+    std::vector<pollfd> fds;
+
+    for (;;) {
+        fds.clear();
+        fds.push_back(pollfd{shared->listen_fd, POLLIN, 0});
+        fds.push_back(pollfd{shared->wake_read, POLLIN, 0});
+        for (const auto& s : subs) {
+            fds.push_back(pollfd{s.fd, static_cast<short>(POLLIN | (s.pending ? POLLOUT : 0)), 0});
+        }
+
+        if (::poll(fds.data(), static_cast<nfds_t>(fds.size()), -1) < 0 && errno != EINTR) break;
+
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (::read(shared->wake_read, drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        Frame catalog, state;
+        std::uint64_t revision = 0, sequence = 0;
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if (shared->stop) break;
+            catalog = shared->catalog;
+            state = shared->state;
+            revision = shared->catalog_revision;
+            sequence = shared->state_sequence;
+        }
+
+        // Subscribers are not expected to send anything: input is discarded,
+        // end-of-file or an error ends the subscription.
+        for (std::size_t k = 0; k < subs.size(); ++k) {
+            const short ev = fds[k + 2].revents;
+            if (ev & (POLLERR | POLLHUP | POLLNVAL)) {
+                subs[k].dead = true;
+            } else if (ev & POLLIN) {
+                char discard[256];
+                const ssize_t n = ::recv(subs[k].fd, discard, sizeof(discard), MSG_DONTWAIT);
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    subs[k].dead = true;
+                }
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            for (;;) {
+                int fd = ::accept(shared->listen_fd, nullptr, nullptr);
+                if (fd < 0) break;
+                if (subs.size() >= max_clients) {
+                    ::close(fd);
+                    continue;
+                }
+                ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+                ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+                Subscriber s;
+                s.fd = fd;
+                subs.push_back(std::move(s));
+            }
+        }
+
+        for (auto& s : subs) {
+            if (!s.dead) flush(s, catalog, revision, state, sequence);
+        }
+
+        for (auto& s : subs) {
+            if (s.dead) close_fd(s.fd);
+        }
+        subs.erase(std::remove_if(subs.begin(), subs.end(), [](const Subscriber& s) { return s.dead; }),
+                   subs.end());
+        shared->clients.store(subs.size(), std::memory_order_relaxed);
+    }
+
+    for (auto& s : subs) close_fd(s.fd);
+    shared->clients.store(0, std::memory_order_relaxed);
+}
+
+#endif
+
+// Server ----------------------------------------------------------------------
+
+TelemetryServer::TelemetryServer(const TelemetryOptions& options) : options_(options) {}
+
+TelemetryServer::~TelemetryServer() { stop(); }
+
+bool TelemetryServer::start(const std::string& socket_path) {
+    stop();
+#ifdef _WIN32
+    (void)socket_path;
+    error_ = "telemetry sockets are not supported on this platform";
+    return false;
+#else
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) {
+        error_ = "invalid socket path '" + socket_path + "'";
+        return false;
+    }
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    auto shared = std::make_shared<Shared>();
+    auto fail = [&](const char* what) {
+        error_ = std::string(what) + ": " + std::strerror(errno);
+        close_fd(shared->listen_fd);
+        close_fd(shared->wake_read);
+        close_fd(shared->wake_write);
+        return false;
+    };
+
+    int wake[2];
+    if (::pipe(wake) != 0) return fail("pipe");
+    shared->wake_read = wake[0];
+    shared->wake_write = wake[1];
+    for (int fd : wake) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    shared->listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (shared->listen_fd < 0) return fail("socket");
+    ::fcntl(shared->listen_fd, F_SETFD, FD_CLOEXEC);
+    ::fcntl(shared->listen_fd, F_SETFL, ::fcntl(shared->listen_fd, F_GETFL) | O_NONBLOCK);
+
+    ::unlink(socket_path.c_str());
+    if (::bind(shared->listen_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) return fail("bind");
+    if (::listen(shared->listen_fd, 16) != 0) return fail("listen");
+
+    path_ = socket_path;
+    error_.clear();
+    shared_ = shared;
+    published_once_ = false;
+    catalog_.clear();
+    thread_ = std::thread(serve, shared, std::max<std::size_t>(options_.max_clients, 1));
+    return true;
+#endif
+}
+
+void TelemetryServer::stop() {
+#ifndef _WIN32
+    if (!shared_) return;
+    {
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        shared_->stop = true;
+    }
+    const char wake = 1;
+    (void)!::write(shared_->wake_write, &wake, 1);
+    if (thread_.joinable()) thread_.join();
+
+    close_fd(shared_->listen_fd);
+    close_fd(shared_->wake_read);
+    close_fd(shared_->wake_write);
+    ::unlink(path_.c_str());
+    shared_.reset();
+    path_.clear();
+#endif
+}
+
+bool TelemetryServer::is_running() const { return shared_ != nullptr; }
+
+const std::string& TelemetryServer::last_error() const { return error_; }
+
+std::size_t TelemetryServer::client_count() const {
+    return shared_ ? shared_->clients.load(std::memory_order_relaxed) : 0;
+}
+
+// Compares every field the catalog carries; names are interned, so equal
+// ids mean equal names.
+bool TelemetryServer::catalog_changed(const std::vector<Body>& bodies) const {
+    if (bodies.size() != catalog_.size()) return true;
+    for (std::size_t i = 0; i < bodies.size(); ++i) {
+        const TelemetryCatalogEntry e = catalog_entry(bodies[i]);
+        const CatalogRecord& sent = catalog_[i];
+        if (bodies[i].name_id != sent.name_id || e.color != sent.entry.color || e.flags != sent.entry.flags ||
+            std::memcmp(&e.radius, &sent.entry.radius, sizeof(float)) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Encoding happens on the calling thread; the hand-over is a pointer swap
+// under a mutex the delivery thread only holds for the same swap.
+bool TelemetryServer::publish(const SimulatorBase& sim) {
+    if (!shared_) return false;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (published_once_ && options_.rate_hz > 0.0 &&
+        std::chrono::duration<double>(now - last_publish_).count() < 1.0 / options_.rate_hz) {
+        return false;
+    }
+    last_publish_ = now;
+
+    const auto& bodies = sim.get_bodies();
+    Frame catalog;
+    if (!published_once_ || catalog_changed(bodies)) {
+        ++catalog_revision_;
+        catalog = encode_catalog(bodies, catalog_revision_, sim.get_time());
+        catalog_.clear();
+        for (const auto& b : bodies) catalog_.push_back({catalog_entry(b), b.name_id});
+    }
+    published_once_ = true;
+    Frame state = encode_state(bodies, ++sequence_, catalog_revision_, sim.get_time());
+
+    {
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        if (catalog) {
+            shared_->catalog = std::move(catalog);
+            shared_->catalog_revision = catalog_revision_;
+        }
+        shared_->state = std::move(state);
+        shared_->state_sequence = sequence_;
+    }
+#ifndef _WIN32
+    const char wake = 1;
+    (void)!::write(shared_->wake_write, &wake, 1);
+#endif
+    return true;
+}
+
+// Client ----------------------------------------------------------------------
+
+TelemetryClient::~TelemetryClient() { close(); }
+
+bool TelemetryClient::connect(const std::string& socket_path) {
+    close();
+#ifdef _WIN32
+    (void)socket_path;
+    return false;
+#else
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0) return false;
+    if (::connect(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close();
+        return false;
+    }
+    return true;
+#endif
+}
+
+void TelemetryClient::close() {
+#ifndef _WIN32
+    close_fd(fd_);
+#endif
+}
+
+bool TelemetryClient::read(std::vector<char>& message) {
+#ifdef _WIN32
+    (void)message;
+    return false;
+#else
+    auto read_exact = [this](char* dst, std::size_t size) {
+        while (size > 0) {
+            const ssize_t n = ::recv(fd_, dst, size, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            dst += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+    };
+
+    if (fd_ < 0) return false;
+    message.resize(sizeof(TelemetryHeader));
+    if (!read_exact(message.data(), message.size())) return false;
+    const TelemetryHeader h = header(message);
+    if (h.magic != kTelemetryMagic || h.size < sizeof(TelemetryHeader)) return false;
+    message.resize(h.size);
+    return read_exact(message.data() + sizeof(TelemetryHeader), h.size - sizeof(TelemetryHeader));
+#endif
+}
+
+TelemetryHeader TelemetryClient::header(const std::vector<char>& message) {
+    TelemetryHeader h {};
+    if (message.size() >= sizeof(h)) std::memcpy(&h, message.data(), sizeof(h));
+    return h;
+}
+
+std::vector<TelemetryBodyState> TelemetryClient::states(const std::vector<char>& message) {
+    const TelemetryHeader h = header(message);
+    std::vector<TelemetryBodyState> out;
+    if (h.type != static_cast<std::uint16_t>(TelemetryMessage::State)) return out;
+    if (message.size() < sizeof(h) + h.count * sizeof(TelemetryBodyState)) return out;
+    out.resize(h.count);
+    std::memcpy(out.data(), message.data() + sizeof(h), h.count * sizeof(TelemetryBodyState));
+    return out;
+}
+
+std::vector<std::string> TelemetryClient::names(const std::vector<char>& message) {
+    const TelemetryHeader h = header(message);
+    std::vector<std::string> out;
+    if (h.type != static_cast<std::uint16_t>(TelemetryMessage::Catalog)) return out;
+    std::size_t at = sizeof(h);
+    for (std::uint32_t i = 0; i < h.count; ++i) {
+        TelemetryCatalogEntry e {};
+        if (at + sizeof(e) > message.size()) break;
+        std::memcpy(&e, message.data() + at, sizeof(e));
+        at += sizeof(e);
+        if (at + e.name_length > message.size()) break;
+        out.emplace_back(message.data() + at, e.name_length);
+        at += e.name_length;
+    }
+    return out;
+}
+
+} // namespace orbitsimlite
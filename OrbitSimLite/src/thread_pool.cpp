@@ -0,0 +1,92 @@
+// OrbitSimLite - ThreadPool implementation
+#include "thread_pool.hpp"
+
+#include <utility>
+
+namespace orbitsimlite {
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    workers_.reserve(threads - 1);
+    for (unsigned w = 1; w < threads; ++w) {
+        workers_.emplace_back([this, w] { worker_loop(w); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+unsigned ThreadPool::size() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+std::size_t ThreadPool::chunk_begin(std::size_t n, unsigned k, unsigned chunks) {
+    return n * k / chunks;
+}
+
+void ThreadPool::parallel_for(std::size_t n, const Job& fn) {
+    const unsigned chunks = size();
+    if (chunks == 1 || n < 2) {
+        if (n > 0) fn(0, n);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        job_size_ = n;
+        pending_ = chunks - 1;
+        ++generation_;
+    }
+    start_cv_.notify_all();
+
+    // The workers use 'fn' until they are done, so the caller's own chunk
+    // must not unwind past the wait.
+    run_chunk(fn, 0, chunk_begin(n, 1, chunks));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return pending_ == 0; });
+    job_ = nullptr;
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+void ThreadPool::run_chunk(const Job& fn, std::size_t begin, std::size_t end) {
+    try {
+        fn(begin, end);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) error_ = std::current_exception();
+    }
+}
+
+void ThreadPool::worker_loop(unsigned index) {
+    unsigned seen = 0;
+    for (;;) {
+        const Job* job = nullptr;
+        std::size_t n = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+            job = job_;
+            n = job_size_;
+        }
+
+        const unsigned chunks = size();
+        const std::size_t begin = chunk_begin(n, index, chunks);
+        const std::size_t end = chunk_begin(n, index + 1, chunks);
+        if (begin < end) run_chunk(*job, begin, end);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) done_cv_.notify_one();
+        }
+    }
+}
+
+} // namespace orbitsimlite
@@ -0,0 +1,436 @@
+// OrbitSimLite - Transport reductions, the loopback group and Unix sockets
+#include "transport.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace orbitsimlite {
+
+// Transport -------------------------------------------------------------------
+
+// Every rank gathers all send buffers together with their offset tables and
+// picks out the block addressed to it from each.
+void Transport::alltoall(const std::vector<unsigned char>& send, const std::vector<std::size_t>& send_offsets,
+                         std::vector<unsigned char>& recv, std::vector<std::size_t>& recv_offsets) {
+    const int n = size();
+    const std::size_t table = (static_cast<std::size_t>(n) + 1) * sizeof(std::size_t);
+    std::vector<unsigned char> packet(table + send.size());
+    std::memcpy(packet.data(), send_offsets.data(), table);
+    if (!send.empty()) std::memcpy(packet.data() + table, send.data(), send.size());
+
+    std::vector<unsigned char> all;
+    std::vector<std::size_t> offsets;
+    allgather(packet.data(), packet.size(), all, offsets);
+
+    const std::size_t me = static_cast<std::size_t>(rank());
+    recv.clear();
+    recv_offsets.assign(1, 0);
+    for (int r = 0; r < n; ++r) {
+        const unsigned char* from = all.data() + offsets[static_cast<std::size_t>(r)];
+        std::size_t begin = 0, end = 0;
+        std::memcpy(&begin, from + me * sizeof(std::size_t), sizeof(std::size_t));
+        std::memcpy(&end, from + (me + 1) * sizeof(std::size_t), sizeof(std::size_t));
+        recv.insert(recv.end(), from + table + begin, from + table + end);
+        recv_offsets.push_back(recv.size());
+    }
+}
+
+namespace {
+
+template <class Combine>
+double reduce(Transport& t, double value, Combine combine) {
+    std::vector<unsigned char> all;
+    std::vector<std::size_t> offsets;
+    t.allgather(&value, sizeof(value), all, offsets);
+    double result = 0.0;
+    for (int r = 0; r < t.size(); ++r) {
+        double v = 0.0;
+        std::memcpy(&v, all.data() + offsets[static_cast<std::size_t>(r)], sizeof(v));
+        result = (r == 0) ? v : combine(result, v);
+    }
+    return result;
+}
+
+} // namespace
+
+double Transport::sum(double value) {
+    return reduce(*this, value, [](double a, double b) { return a + b; });
+}
+
+double Transport::min(double value) {
+    return reduce(*this, value, [](double a, double b) { return std::min(a, b); });
+}
+
+double Transport::max(double value) {
+    return reduce(*this, value, [](double a, double b) { return std::max(a, b); });
+}
+
+// LoopbackGroup ---------------------------------------------------------------
+
+class LoopbackGroup::Endpoint final : public Transport {
+public:
+    Endpoint(LoopbackGroup& group, int rank) : group_(group), rank_(rank) {}
+
+    int rank() const override { return rank_; }
+    int size() const override { return group_.size(); }
+
+    void allgather(const void* data, std::size_t bytes, std::vector<unsigned char>& out,
+                   std::vector<std::size_t>& offsets) override {
+        group_.allgather(rank_, data, bytes, out, offsets);
+    }
+
+private:
+    LoopbackGroup& group_;
+    int rank_;
+};
+
+LoopbackGroup::LoopbackGroup(int ranks) {
+    if (ranks < 1) ranks = 1;
+    for (int r = 0; r < ranks; ++r) endpoints_.push_back(std::make_unique<Endpoint>(*this, r));
+    for (auto& slots : slots_) slots.resize(static_cast<std::size_t>(ranks));
+    parity_.assign(static_cast<std::size_t>(ranks), 0);
+}
+
+LoopbackGroup::~LoopbackGroup() = default;
+
+int LoopbackGroup::size() const { return static_cast<int>(endpoints_.size()); }
+
+Transport& LoopbackGroup::rank(int r) { return *endpoints_[static_cast<std::size_t>(r)]; }
+
+// Exchange k uses slot set k % 2. A rank can only start exchange k + 2 (and
+// overwrite its slot of set k % 2) after every rank arrived at exchange
+// k + 1, i.e. finished reading the slots of exchange k.
+void LoopbackGroup::allgather(int rank, const void* data, std::size_t bytes, std::vector<unsigned char>& out,
+                              std::vector<std::size_t>& offsets) {
+    const std::size_t me = static_cast<std::size_t>(rank);
+    const int set = parity_[me];
+    parity_[me] = 1 - set;
+    const auto* bytes_in = static_cast<const unsigned char*>(data);
+    slots_[set][me].assign(bytes_in, bytes_in + bytes);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const unsigned long generation = generation_;
+        if (++arrived_ == size()) {
+            arrived_ = 0;
+            ++generation_;
+            arrived_cv_.notify_all();
+        } else {
+            arrived_cv_.wait(lock, [&] { return generation_ != generation; });
+        }
+    }
+
+    out.clear();
+    offsets.assign(1, 0);
+    for (const auto& slot : slots_[set]) {
+        out.insert(out.end(), slot.begin(), slot.end());
+        offsets.push_back(out.size());
+    }
+}
+
+// SocketTransport -------------------------------------------------------------
+
+#ifndef _WIN32
+
+namespace {
+
+void close_fd(int& fd) {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+bool socket_address(const std::string& path, sockaddr_un& addr) {
+    addr = sockaddr_un {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Blocking transfer of the few bytes of the connection handshake.
+bool send_all(int fd, const void* data, std::size_t size) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    while (size > 0) {
+        const ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool recv_all(int fd, void* data, std::size_t size) {
+    auto* p = static_cast<unsigned char*>(data);
+    while (size > 0) {
+        const ssize_t n = ::recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+[[noreturn]] void exchange_failed(int peer) {
+    std::fprintf(stderr, "orbitsimlite: SocketTransport lost rank %d: %s\n", peer,
+                 (errno != 0) ? std::strerror(errno) : "connection closed");
+    std::abort();
+}
+
+} // namespace
+
+#endif
+
+SocketTransport::~SocketTransport() { close(); }
+
+// Rank r listens, connects to every lower rank and accepts every higher one;
+// a connecting rank introduces itself with its rank number. Lower ranks may
+// not be listening yet, so refused connections are retried until the
+// deadline.
+bool SocketTransport::connect(const std::string& path_prefix, int rank, int size, double timeout_seconds) {
+    close();
+#ifdef _WIN32
+    (void)path_prefix;
+    (void)rank;
+    (void)size;
+    (void)timeout_seconds;
+    error_ = "socket transports are not supported on this platform";
+    return false;
+#else
+    if (size < 1 || rank < 0 || rank >= size) {
+        error_ = "invalid rank " + std::to_string(rank) + " of " + std::to_string(size);
+        return false;
+    }
+    auto path_of = [&](int r) { return path_prefix + "." + std::to_string(r); };
+    sockaddr_un own {}; // the longest path is that of the highest rank
+    if (!socket_address(path_of(size - 1), own) || !socket_address(path_of(rank), own)) {
+        error_ = "invalid socket path '" + path_of(rank) + "'";
+        return false;
+    }
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::duration<double>(std::max(timeout_seconds, 0.0));
+
+    std::vector<int> fds(static_cast<std::size_t>(size), -1);
+    int listen_fd = -1;
+    auto fail = [&](const std::string& what) {
+        error_ = what + ": " + std::strerror(errno);
+        for (int& fd : fds) close_fd(fd);
+        close_fd(listen_fd);
+        ::unlink(own.sun_path);
+        return false;
+    };
+
+    if (rank + 1 < size) {
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0) return fail("socket");
+        ::fcntl(listen_fd, F_SETFD, FD_CLOEXEC);
+        ::unlink(own.sun_path);
+        if (::bind(listen_fd, reinterpret_cast<const sockaddr*>(&own), sizeof(own)) != 0) return fail("bind");
+        if (::listen(listen_fd, size) != 0) return fail("listen");
+    }
+
+    for (int r = 0; r < rank; ++r) {
+        sockaddr_un addr {};
+        socket_address(path_of(r), addr);
+        int& fd = fds[static_cast<std::size_t>(r)];
+        for (;;) {
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0) return fail("socket");
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+            if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0) break;
+            close_fd(fd);
+            if (errno != ENOENT && errno != ECONNREFUSED && errno != EINTR) {
+                return fail("connect to rank " + std::to_string(r));
+            }
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return fail("timed out connecting to rank " + std::to_string(r));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        const std::int32_t me = rank;
+        if (!send_all(fd, &me, sizeof(me))) return fail("handshake with rank " + std::to_string(r));
+    }
+
+    for (int accepted = rank + 1; accepted < size; ++accepted) {
+        pollfd pfd {listen_fd, POLLIN, 0};
+        const auto left = deadline - std::chrono::steady_clock::now();
+        const auto wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(left).count();
+        const int ready = ::poll(&pfd, 1, static_cast<int>(std::max<decltype(wait_ms)>(wait_ms, 0)));
+        if (ready < 0 && errno == EINTR) {
+            --accepted;
+            continue;
+        }
+        if (ready <= 0) {
+            if (ready == 0) errno = ETIMEDOUT;
+            return fail("waiting for higher ranks");
+        }
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) return fail("accept");
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        std::int32_t peer = -1;
+        if (!recv_all(fd, &peer, sizeof(peer)) || peer <= rank || peer >= size ||
+            fds[static_cast<std::size_t>(peer)] >= 0) {
+            close_fd(fd);
+            errno = EPROTO;
+            return fail("handshake");
+        }
+        fds[static_cast<std::size_t>(peer)] = fd;
+    }
+    close_fd(listen_fd);
+    ::unlink(own.sun_path);
+
+    rank_ = rank;
+    size_ = size;
+    fds_ = std::move(fds);
+    inbox_.assign(static_cast<std::size_t>(size), {});
+    error_.clear();
+    return true;
+#endif
+}
+
+void SocketTransport::close() {
+#ifndef _WIN32
+    for (int& fd : fds_) close_fd(fd);
+#endif
+    fds_.clear();
+    inbox_.clear();
+    rank_ = 0;
+    size_ = 1;
+}
+
+bool SocketTransport::is_connected() const { return !fds_.empty(); }
+
+const std::string& SocketTransport::last_error() const { return error_; }
+
+int SocketTransport::rank() const { return rank_; }
+
+int SocketTransport::size() const { return size_; }
+
+void SocketTransport::allgather(const void* data, std::size_t bytes, std::vector<unsigned char>& out,
+                                std::vector<std::size_t>& offsets) {
+    const std::vector<std::pair<const unsigned char*, std::size_t>> blocks(
+        static_cast<std::size_t>(size_), {static_cast<const unsigned char*>(data), bytes});
+    exchange(blocks, out, offsets);
+}
+
+void SocketTransport::alltoall(const std::vector<unsigned char>& send, const std::vector<std::size_t>& send_offsets,
+                               std::vector<unsigned char>& recv, std::vector<std::size_t>& recv_offsets) {
+    std::vector<std::pair<const unsigned char*, std::size_t>> blocks(static_cast<std::size_t>(size_));
+    for (std::size_t r = 0; r < blocks.size(); ++r) {
+        blocks[r] = {send.data() + send_offsets[r], send_offsets[r + 1] - send_offsets[r]};
+    }
+    exchange(blocks, recv, recv_offsets);
+}
+
+// Each peer gets an 8-byte length and then its block. A peer can already be
+// sending its block of the next exchange, so exactly one message is read
+// from each stream.
+void SocketTransport::exchange(const std::vector<std::pair<const unsigned char*, std::size_t>>& blocks,
+                               std::vector<unsigned char>& out, std::vector<std::size_t>& offsets) {
+    const std::size_t me = static_cast<std::size_t>(rank_);
+#ifndef _WIN32
+    struct Progress {
+        std::uint64_t out_size;
+        std::size_t sent;
+        std::uint64_t in_size;
+        std::size_t received; // header included
+    };
+    constexpr std::size_t header = sizeof(std::uint64_t);
+    std::vector<Progress> progress(static_cast<std::size_t>(size_));
+    std::size_t pending = 0;
+    for (std::size_t r = 0; r < progress.size(); ++r) {
+        if (r == me) continue;
+        progress[r] = Progress {blocks[r].second, 0, 0, 0};
+        pending += 2;
+    }
+
+    std::vector<pollfd> fds;
+    std::vector<std::size_t> peers;
+    while (pending > 0) {
+        fds.clear();
+        peers.clear();
+        for (std::size_t r = 0; r < progress.size(); ++r) {
+            if (r == me) continue;
+            const Progress& p = progress[r];
+            short events = 0;
+            if (p.sent < header + p.out_size) events |= POLLOUT;
+            if (p.received < header || p.received < header + p.in_size) events |= POLLIN;
+            if (events == 0) continue;
+            fds.push_back(pollfd {fds_[r], events, 0});
+            peers.push_back(r);
+        }
+        if (::poll(fds.data(), static_cast<nfds_t>(fds.size()), -1) < 0) {
+            if (errno == EINTR) continue;
+            exchange_failed(-1);
+        }
+        for (std::size_t k = 0; k < fds.size(); ++k) {
+            const std::size_t r = peers[k];
+            Progress& p = progress[r];
+            const int fd = fds[k].fd;
+            const int peer = static_cast<int>(r);
+            if ((fds[k].revents & POLLOUT) != 0) {
+                while (p.sent < header + p.out_size) {
+                    const unsigned char* from = (p.sent < header)
+                                                    ? reinterpret_cast<const unsigned char*>(&p.out_size) + p.sent
+                                                    : blocks[r].first + (p.sent - header);
+                    const std::size_t left = (p.sent < header) ? header - p.sent : header + p.out_size - p.sent;
+                    const ssize_t n = ::send(fd, from, left, MSG_DONTWAIT | MSG_NOSIGNAL);
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                    if (n <= 0) exchange_failed(peer);
+                    p.sent += static_cast<std::size_t>(n);
+                    if (p.sent == header + p.out_size) --pending;
+                }
+            }
+            if ((fds[k].revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+                std::vector<unsigned char>& in = inbox_[r];
+                while (p.received < header || p.received < header + p.in_size) {
+                    unsigned char* to = (p.received < header)
+                                            ? reinterpret_cast<unsigned char*>(&p.in_size) + p.received
+                                            : in.data() + (p.received - header);
+                    const std::size_t left = (p.received < header) ? header - p.received
+                                                                   : header + p.in_size - p.received;
+                    const ssize_t n = ::recv(fd, to, left, MSG_DONTWAIT);
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                    if (n <= 0) {
+                        if (n == 0) errno = 0;
+                        exchange_failed(peer);
+                    }
+                    p.received += static_cast<std::size_t>(n);
+                    if (p.received == header) in.resize(static_cast<std::size_t>(p.in_size));
+                    if (p.received == header + p.in_size) --pending;
+                }
+            }
+        }
+    }
+#endif
+
+    out.clear();
+    offsets.assign(1, 0);
+    for (std::size_t r = 0; r < static_cast<std::size_t>(size_); ++r) {
+        if (r == me) {
+            out.insert(out.end(), blocks[r].first, blocks[r].first + blocks[r].second);
+        } else {
+            out.insert(out.end(), inbox_[r].begin(), inbox_[r].end());
+        }
+        offsets.push_back(out.size());
+    }
+}
+
+} // namespace orbitsimlite
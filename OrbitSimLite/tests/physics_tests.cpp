@@ -8,11 +8,37 @@
 //   cmake --build . --target orbitsimlite_tests
 //   ./orbitsimlite_tests
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
-
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "basic_simulator.hpp"
+#include "density_map.hpp"
+#include "domain.hpp"
+#include "ensemble.hpp"
 #include "physics.hpp"
 #include "simulator.hpp"
+#include "lz_codec.hpp"
+#include "snapshot_codec.hpp"
+#include "spatial_order.hpp"
+#include "state_publisher.hpp"
+#include "step_executor.hpp"
+#include "task_queue.hpp"
+#include "telemetry.hpp"
 
 using namespace orbitsimlite;
 
@@ -30,6 +56,17 @@ double rel_error(double value, double reference) {
     return std::abs(value - reference) / denom;
 }
 
+// Reproducible uniform numbers in [0, 1): a linear congruential generator
+// started from 'seed'.
+struct Lcg {
+    std::uint32_t seed;
+
+    double operator()() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<double>(seed >> 8) / 16777216.0;
+    }
+};
+
 bool test_newtonian_accel_single_mass() {
     // Analytic case: a light body at (r, 0) under the gravity of a single
     // massive body at the origin. Expected acceleration:
@@ -309,6 +346,1529 @@ bool test_satellite_flag_preserved() {
     return bodies[0].is_satellite && !bodies[0].is_star;
 }
 
+bool test_diagnostics_match_manual_invariants() {
+    // Sun + planet on a circular orbit. The Simulator's diagnostics (with the
+    // potential taken from its force pass) must agree with a direct
+    // evaluation of the invariants.
+    const double M = 1.989e30;
+    const double m = 5.972e24;
+    const double r0 = 1.496e11;
+    const double v0 = std::sqrt(Physics::DefaultG * M / r0);
+
+    Simulator sim(Physics::DefaultG, 3600.0, Integrator::RK4);
+    sim.add_body(Body(M, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFF00));
+    sim.add_body(Body(m, Vec2{r0, 0.0}, Vec2{0.0, v0}, 1.0, 0x0000FF));
+
+    for (int i = 0; i < 100; ++i) {
+        sim.step();
+    }
+
+    const auto& bs = sim.get_bodies();
+    const double r = Vec2::distance(bs[0].pos, bs[1].pos);
+    const double U = -Physics::DefaultG * M * m / r;
+    const double K = 0.5 * M * bs[0].vel.length_squared() +
+                     0.5 * m * bs[1].vel.length_squared();
+    const double L = M * (bs[0].pos.x * bs[0].vel.y - bs[0].pos.y * bs[0].vel.x) +
+                     m * (bs[1].pos.x * bs[1].vel.y - bs[1].pos.y * bs[1].vel.x);
+    const Vec2 com = (M * bs[0].pos + m * bs[1].pos) / (M + m);
+
+    const Diagnostics d = sim.diagnostics();
+
+    return rel_error(d.potential_energy, U) < 1e-12 &&
+           rel_error(d.kinetic_energy, K) < 1e-12 &&
+           rel_error(d.total_energy, K + U) < 1e-12 &&
+           rel_error(d.angular_momentum, L) < 1e-12 &&
+           Vec2::distance(d.center_of_mass, com) < 1e-6 * r0;
+}
+
+bool test_energy_drift_alert() {
+    // A coarse Euler integration of an eccentric orbit drifts in energy; a
+    // tight alert must fire exactly once, a loose one must stay silent.
+    const double M = 1.989e30;
+    const double r0 = 1.496e11;
+    const double v0 = 0.6 * std::sqrt(Physics::DefaultG * M / r0);
+
+    auto make = [&](Simulator& sim) {
+        sim.add_body(Body(M, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFF00));
+        sim.add_body(Body(1.0e20, Vec2{r0, 0.0}, Vec2{0.0, v0}, 1.0, 0x0000FF));
+    };
+
+    Simulator tight(Physics::DefaultG, 86400.0, Integrator::Euler);
+    Simulator loose(Physics::DefaultG, 86400.0, Integrator::Euler);
+    make(tight);
+    make(loose);
+
+    int tight_calls = 0;
+    int loose_calls = 0;
+    tight.set_energy_drift_alert(1e-6, [&](const Diagnostics&, double) { ++tight_calls; });
+    loose.set_energy_drift_alert(10.0, [&](const Diagnostics&, double) { ++loose_calls; });
+
+    for (int i = 0; i < 365; ++i) {
+        tight.step();
+        loose.step();
+    }
+
+    std::cout << "[Drift alert] tight calls=" << tight_calls
+              << ", loose calls=" << loose_calls << "\n";
+
+    return tight_calls == 1 && tight.energy_drift_exceeded() &&
+           loose_calls == 0 && !loose.energy_drift_exceeded();
+}
+
+std::vector<Body> three_body_scene() {
+    // Sun with two planets on slightly eccentric orbits.
+    const double M = 1.989e30;
+    const double v1 = std::sqrt(Physics::DefaultG * M / 1.0e11);
+    const double v2 = std::sqrt(Physics::DefaultG * M / 2.0e11);
+    return {
+        Body(M, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFF00),
+        Body(5.0e24, Vec2{1.0e11, 0.0}, Vec2{0.0, 1.05 * v1}, 1.0, 0x00FF00),
+        Body(6.0e23, Vec2{0.0, -2.0e11}, Vec2{0.95 * v2, 0.0}, 1.0, 0xFF0000),
+    };
+}
+
+bool test_basic_simulator_matches_facade() {
+    // The compile-time pipeline and the runtime facade run the same kernel,
+    // so their results must be bit-identical.
+    bool ok = true;
+    for (Integrator kind : {Integrator::Euler, Integrator::RK4}) {
+        Simulator facade(Physics::DefaultG, 3600.0, kind);
+        facade.set_substeps(8);
+        facade.set_bodies(three_body_scene());
+
+        BasicSimulator<EulerIntegration> euler(Physics::DefaultG, 3600.0);
+        BasicSimulator<RK4Integration> rk4(Physics::DefaultG, 3600.0);
+        SimulatorBase& basic = (kind == Integrator::Euler)
+            ? static_cast<SimulatorBase&>(euler) : static_cast<SimulatorBase&>(rk4);
+        basic.set_substeps(8);
+        basic.set_bodies(three_body_scene());
+
+        for (int i = 0; i < 200; ++i) {
+            facade.step();
+            basic.step();
+        }
+        for (std::size_t i = 0; i < 3; ++i) {
+            const Body& a = facade.get_bodies()[i];
+            const Body& b = basic.get_bodies()[i];
+            ok = ok && a.pos.x == b.pos.x && a.pos.y == b.pos.y &&
+                 a.vel.x == b.vel.x && a.vel.y == b.vel.y;
+        }
+    }
+    return ok;
+}
+
+bool test_float_kernel_tracks_double() {
+    // A single-precision pair loop should stay close to the double one over
+    // a short integration.
+    BasicSimulator<RK4Integration, NewtonianGravity, double> ref(Physics::DefaultG, 3600.0);
+    BasicSimulator<RK4Integration, NewtonianGravity, float> fast(Physics::DefaultG, 3600.0);
+    ref.set_bodies(three_body_scene());
+    fast.set_bodies(three_body_scene());
+    for (int i = 0; i < 24 * 30; ++i) {
+        ref.step();
+        fast.step();
+    }
+    const double err = Vec2::distance(ref.get_bodies()[1].pos, fast.get_bodies()[1].pos);
+    std::cout << "[Float kernel] position difference after 30 days: " << err << " m\n";
+    return err < 1e-4 * 1.0e11;
+}
+
+bool test_custom_force_law_functor() {
+    // A user-supplied force law (here a generic lambda switching gravity off)
+    // plugs into the same pipeline: bodies must move on straight lines.
+    auto no_gravity = [](auto, auto, auto& accel, auto& potential) {
+        accel = 0;
+        potential = 0;
+    };
+    BasicSimulator<EulerIntegration, decltype(no_gravity)> sim(Physics::DefaultG, 10.0, no_gravity);
+    sim.add_body(Body(1.0e30, Vec2{0.0, 0.0}, Vec2{1.0, 2.0}, 1.0, 0xFFFFFF));
+    sim.add_body(Body(1.0e30, Vec2{1.0e3, 0.0}, Vec2{-1.0, 0.0}, 1.0, 0xFFFFFF));
+    for (int i = 0; i < 10; ++i) {
+        sim.step();
+    }
+    const auto& bs = sim.get_bodies();
+    return std::abs(bs[0].pos.x - 100.0) < 1e-9 && std::abs(bs[0].pos.y - 200.0) < 1e-9 &&
+           std::abs(bs[1].pos.x - 900.0) < 1e-9 && sim.diagnostics().potential_energy == 0.0;
+}
+
+bool test_plummer_softening_bounds_force() {
+    // Two bodies passing through each other: with Plummer softening the
+    // acceleration stays bounded by G m / eps^2 and energy stays finite.
+    const double eps = 1.0e3;
+    Simulator sim(1.0, 1.0, Integrator::RK4);
+    sim.set_softening(eps);
+    sim.set_substeps(20);
+    sim.add_body(Body(1.0e6, Vec2{-5.0e3, 0.0}, Vec2{10.0, 0.0}, 1.0, 0xFFFFFF));
+    sim.add_body(Body(1.0e6, Vec2{ 5.0e3, 0.0}, Vec2{-10.0, 0.0}, 1.0, 0xFFFFFF));
+
+    const Diagnostics d0 = sim.diagnostics();
+    double max_acc = 0.0;
+    for (int i = 0; i < 1000; ++i) {
+        sim.step();
+        max_acc = std::max(max_acc, sim.get_bodies()[0].acc.length());
+    }
+    const Diagnostics d1 = sim.diagnostics();
+    // Energy error measured against the initial kinetic energy scale, as the
+    // total energy of this configuration is close to zero.
+    const double energy_err = std::abs(d1.total_energy - d0.total_energy) / d0.kinetic_energy;
+    std::cout << "[Plummer] max acceleration=" << max_acc
+              << ", energy error=" << energy_err << "\n";
+    return max_acc <= 1.0e6 / (eps * eps) && energy_err < 1e-2;
+}
+
+bool test_spline_softening_kernel() {
+    // The spline kernel must be exactly Newtonian beyond h = 2.8 eps,
+    // continuous at the piece boundaries and finite at zero separation.
+    const SplineGravity law{1.0};
+    const double h = 2.8;
+
+    auto eval = [&](double r, double& accel, double& pot) {
+        law(r * r, 0.0, accel, pot);
+    };
+
+    double a_out, p_out;
+    eval(1.5 * h, a_out, p_out);
+    const double r_out = 1.5 * h;
+    bool ok = rel_error(a_out, 1.0 / (r_out * r_out * r_out)) < 1e-12 &&
+              rel_error(p_out, 1.0 / r_out) < 1e-12;
+
+    for (double u : {0.5, 1.0}) {
+        double a_lo, p_lo, a_hi, p_hi;
+        eval(u * h * (1.0 - 1e-9), a_lo, p_lo);
+        eval(u * h * (1.0 + 1e-9), a_hi, p_hi);
+        ok = ok && rel_error(a_lo, a_hi) < 1e-6 && rel_error(p_lo, p_hi) < 1e-6;
+    }
+
+    double a0, p0;
+    eval(0.0, a0, p0);
+    ok = ok && std::isfinite(a0) && std::isfinite(p0) && p0 > 0.0;
+    return ok;
+}
+
+bool test_per_body_softening() {
+    // Two bodies with equal softening lengths under the default Newtonian
+    // law interact like Plummer spheres with that length.
+    const double eps = 2.0;
+    const double r = 3.0;
+    Body a(5.0, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFFFF);
+    Body b(7.0, Vec2{r, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFFFF);
+    a.softening = eps;
+    b.softening = eps;
+
+    Simulator sim(1.0, 1e-6, Integrator::Euler);
+    sim.add_body(a);
+    sim.add_body(b);
+
+    const double d = std::sqrt(r * r + eps * eps);
+    const double U_ref = -5.0 * 7.0 / d;
+    const bool potential_ok = rel_error(sim.diagnostics().potential_energy, U_ref) < 1e-12;
+
+    sim.step();
+    const double a_ref = 7.0 * r / (d * d * d);
+    return potential_ok && rel_error(sim.get_bodies()[0].acc.x, a_ref) < 1e-3;
+}
+
+bool test_linear_drag_decay() {
+    // An isolated body under linear drag slows down as v0 * exp(-k t).
+    const double k = 0.1;
+    Simulator sim(1.0, 0.01, Integrator::RK4);
+    sim.add_body(Body(1.0, Vec2{0.0, 0.0}, Vec2{3.0, 0.0}, 1.0, 0xFFFFFF));
+    ExtraForces extra;
+    extra.drag_rate = k;
+    sim.set_extra_forces(extra);
+
+    for (int i = 0; i < 1000; ++i) {
+        sim.step();
+    }
+    return rel_error(sim.get_bodies()[0].vel.x, 3.0 * std::exp(-k * 10.0)) < 1e-8;
+}
+
+bool test_post_newtonian_precession() {
+    // With the 1PN term switched on, an eccentric orbit precesses by
+    // 6 pi G M / (c^2 a (1 - e^2)) per revolution. A small speed of light
+    // (dimensionless units) makes the effect measurable in a few orbits.
+    const double a = 1.0;
+    const double e = 0.2;
+    const double c = 100.0;
+    const double rp = a * (1.0 - e);
+    const double vp = std::sqrt((1.0 + e) / rp);
+    const double period = 2.0 * M_PI;
+    const int orbits = 10;
+    const int steps_per_orbit = 4000;
+
+    Simulator sim(1.0, period / steps_per_orbit, Integrator::RK4);
+    sim.add_body(Body(1.0, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFF00, false, true));
+    sim.add_body(Body(1e-12, Vec2{rp, 0.0}, Vec2{0.0, vp}, 1.0, 0x0000FF));
+    ExtraForces extra;
+    extra.speed_of_light = c;
+    sim.set_extra_forces(extra);
+
+    // Direction of the Laplace-Runge-Lenz vector (points to periapsis).
+    auto periapsis_angle = [](const Body& star, const Body& p) {
+        const Vec2 r = p.pos - star.pos;
+        const Vec2 v = p.vel - star.vel;
+        const double hz = r.x * v.y - r.y * v.x;
+        const double len = r.length();
+        return std::atan2(-v.x * hz - r.y / len, v.y * hz - r.x / len);
+    };
+
+    const double w0 = periapsis_angle(sim.get_bodies()[0], sim.get_bodies()[1]);
+    for (int i = 0; i < orbits * steps_per_orbit; ++i) {
+        sim.step();
+    }
+    const double w1 = periapsis_angle(sim.get_bodies()[0], sim.get_bodies()[1]);
+
+    const double expected = orbits * 6.0 * M_PI / (c * c * a * (1.0 - e * e));
+    std::cout << "[1PN precession] measured=" << (w1 - w0)
+              << " rad, expected=" << expected << " rad\n";
+    return rel_error(w1 - w0, expected) < 0.05;
+}
+
+bool test_test_particles_match_massless_bodies() {
+    // A bulk test particle must follow exactly the same trajectory as a
+    // massless body (which contributes nothing as a source), for both
+    // integrators.
+    bool ok = true;
+    for (Integrator kind : {Integrator::Euler, Integrator::RK4}) {
+        const auto scene = three_body_scene();
+        const Vec2 p0{1.5e11, 0.0};
+        const Vec2 v0{0.0, std::sqrt(Physics::DefaultG * scene[0].mass / 1.5e11)};
+
+        Simulator with_body(Physics::DefaultG, 3600.0, kind);
+        with_body.set_substeps(4);
+        with_body.set_bodies(scene);
+        with_body.add_body(Body(0.0, p0, v0, 1.0, 0xFFFFFF));
+
+        Simulator with_tracer(Physics::DefaultG, 3600.0, kind);
+        with_tracer.set_substeps(4);
+        with_tracer.set_bodies(scene);
+        with_tracer.add_test_particle(p0, v0);
+
+        for (int i = 0; i < 500; ++i) {
+            with_body.step();
+            with_tracer.step();
+        }
+        const Body& b = with_body.get_bodies().back();
+        const TestParticles& t = with_tracer.get_test_particles();
+        ok = ok && b.pos.x == t.x[0] && b.pos.y == t.y[0] &&
+             b.vel.x == t.vx[0] && b.vel.y == t.vy[0];
+    }
+    return ok;
+}
+
+bool test_passive_body_is_not_a_source() {
+    // A heavy body flagged as a test particle feels the star but does not
+    // pull on it.
+    Body star(1.0e30, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFF00, false, true);
+    Body heavy(1.0e29, Vec2{1.0e10, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFFFF);
+    heavy.is_test_particle = true;
+
+    Simulator sim(Physics::DefaultG, 60.0, Integrator::RK4);
+    sim.add_body(star);
+    sim.add_body(heavy);
+    for (int i = 0; i < 100; ++i) {
+        sim.step();
+    }
+    const auto& bs = sim.get_bodies();
+    const double r = 1.0e10;
+    const double a_ref = Physics::DefaultG * 1.0e30 / (r * r);
+    return bs[0].pos.x == 0.0 && bs[0].pos.y == 0.0 && bs[0].acc.length() == 0.0 &&
+           rel_error(bs[1].acc.length(), a_ref) < 1e-2;
+}
+
+bool test_kepler_drift_closed_and_open_orbits() {
+    // After one period an eccentric orbit must return to its start; a
+    // hyperbolic flyby must conserve energy and angular momentum and agree
+    // with a finely stepped RK4 reference.
+    const double mu = 1.0;
+    const double e = 0.6;
+    const double rp = 1.0 - e; // a = 1
+    Vec2 p{rp, 0.0};
+    Vec2 v{0.0, std::sqrt(mu * (1.0 + e) / rp)};
+    Physics::kepler_drift(p, v, mu, 2.0 * M_PI);
+    bool ok = rel_error(p.x, rp) < 1e-10 && std::abs(p.y) < 1e-10;
+
+    Vec2 hp{1.0, 0.0};
+    Vec2 hv{0.0, 2.0};
+    const double energy0 = 0.5 * hv.length_squared() - mu / hp.length();
+    Physics::kepler_drift(hp, hv, mu, 5.0);
+    const double energy1 = 0.5 * hv.length_squared() - mu / hp.length();
+    const double h1 = hp.x * hv.y - hp.y * hv.x;
+    ok = ok && rel_error(energy1, energy0) < 1e-12 && rel_error(h1, 2.0) < 1e-12;
+
+    Body star(1.0, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFF00, false, true);
+    Body probe(0.0, Vec2{1.0, 0.0}, Vec2{0.0, 2.0}, 1.0, 0xFFFFFF);
+    const std::vector<Body> others{star};
+    for (int i = 0; i < 50000; ++i) {
+        Physics::step_rk4(probe, others, 1.0, 1e-4);
+    }
+    return ok && rel_error(hp.x, probe.pos.x) < 1e-8 && rel_error(hp.y, probe.pos.y) < 1e-8;
+}
+
+bool test_wisdom_holman_long_steps() {
+    // Star-dominated system: at a 10x longer step the Wisdom–Holman scheme
+    // must track a finely stepped reference better than RK4 at the
+    // original step, and keep the energy bounded.
+    auto scene = [] {
+        std::vector<Body> bs;
+        bs.emplace_back(1.989e30, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFF00, false, true);
+        const double radii[] = {5.79e10, 1.082e11, 1.496e11, 2.279e11};
+        const double masses[] = {3.301e23, 4.867e24, 5.972e24, 6.417e23};
+        for (int k = 0; k < 4; ++k) {
+            const double th = 1.3 * k;
+            const double v = std::sqrt(Physics::DefaultG * 1.989e30 / radii[k]);
+            bs.emplace_back(masses[k], Vec2{radii[k] * std::cos(th), radii[k] * std::sin(th)},
+                            Vec2{-v * std::sin(th), v * std::cos(th)}, 1.0, 0xFFFFFF);
+        }
+        return bs;
+    };
+    const double year = 3.15e7; // a multiple of every step below
+    auto run_for_year = [&](Integrator kind, double dt) {
+        Simulator sim(Physics::DefaultG, dt, kind);
+        sim.set_bodies(scene());
+        const int steps = static_cast<int>(std::lround(year / dt));
+        double worst_drift = 0.0;
+        const double e0 = sim.diagnostics().total_energy;
+        for (int i = 0; i < steps; ++i) {
+            sim.step();
+            worst_drift = std::max(worst_drift, relative_drift(sim.diagnostics().total_energy, e0));
+        }
+        return std::make_pair(sim.get_bodies(), worst_drift);
+    };
+
+    const auto ref = run_for_year(Integrator::RK4, 300.0);
+    const auto rk4 = run_for_year(Integrator::RK4, 3000.0);
+    const auto wh = run_for_year(Integrator::WisdomHolman, 30000.0);
+
+    auto max_pos_error = [&](const std::vector<Body>& bs) {
+        double err = 0.0;
+        for (std::size_t i = 1; i < bs.size(); ++i) {
+            err = std::max(err, (bs[i].pos - ref.first[i].pos).length() / ref.first[i].pos.length());
+        }
+        return err;
+    };
+    const double err_rk4 = max_pos_error(rk4.first);
+    const double err_wh = max_pos_error(wh.first);
+    std::cout << "[Wisdom-Holman] rel pos error: RK4(dt) = " << err_rk4
+              << ", WH(10 dt) = " << err_wh << ", WH energy drift = " << wh.second << "\n";
+    return err_wh < err_rk4 && wh.second < 1e-6;
+}
+
+bool test_ensemble_matches_independent_simulators() {
+    // Every member of a threaded ensemble must reproduce, bit for bit, the
+    // run of a separate Simulator with the same initial conditions.
+    const auto scene = three_body_scene();
+    const std::size_t members = 7;
+    bool ok = true;
+    for (Integrator kind : {Integrator::Euler, Integrator::RK4, Integrator::WisdomHolman}) {
+        Ensemble ensemble(scene, members, Physics::DefaultG, 3600.0, kind, 3);
+        ensemble.set_substeps(2);
+        std::vector<std::vector<Body>> variants;
+        for (std::size_t m = 0; m < members; ++m) {
+            auto bs = scene;
+            bs[1].vel = bs[1].vel * (1.0 + 0.01 * static_cast<double>(m));
+            bs[2].mass *= 1.0 + 0.1 * static_cast<double>(m);
+            ensemble.set_member(m, bs);
+            variants.push_back(bs);
+        }
+        ensemble.run(150);
+        ensemble.step();
+
+        for (std::size_t m = 0; m < members; ++m) {
+            Simulator sim(Physics::DefaultG, 3600.0, kind);
+            sim.set_substeps(2);
+            sim.set_bodies(variants[m]);
+            for (int i = 0; i < 151; ++i) {
+                sim.step();
+            }
+            const auto& bs = sim.get_bodies();
+            for (std::size_t i = 0; i < bs.size(); ++i) {
+                const Vec2 p = ensemble.position(m, i);
+                const Vec2 v = ensemble.velocity(m, i);
+                ok = ok && p.x == bs[i].pos.x && p.y == bs[i].pos.y &&
+                     v.x == bs[i].vel.x && v.y == bs[i].vel.y;
+            }
+            ok = ok && rel_error(ensemble.diagnostics(m).total_energy,
+                                 sim.diagnostics().total_energy) < 1e-12;
+        }
+        ok = ok && ensemble.get_time() == 151 * 3600.0;
+    }
+
+    // A throwing chunk, on a worker or on the caller, reaches the caller
+    // once every chunk is done and leaves the pool usable.
+    ThreadPool pool(3);
+    for (std::size_t bad : {0u, 8u}) {
+        std::atomic<int> done {0};
+        bool thrown = false;
+        try {
+            pool.parallel_for(9, [&](std::size_t begin, std::size_t end) {
+                if (bad >= begin && bad < end) throw std::runtime_error("chunk");
+                done.fetch_add(1);
+            });
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        ok = ok && thrown && done.load() == 2;
+    }
+    std::atomic<std::size_t> sum {0};
+    pool.parallel_for(9, [&](std::size_t begin, std::size_t end) { sum.fetch_add(end - begin); });
+    return ok && sum.load() == 9;
+}
+
+bool test_reproducible_across_thread_counts() {
+    // In reproducible mode the whole final state, including the potential
+    // energy, must hash identically for any number of threads.
+    std::vector<Body> scene;
+    scene.emplace_back(1.0, Vec2{0.0, 0.0}, Vec2{0.0, 0.0}, 1.0, 0xFFFF00, false, true);
+    std::uint32_t seed = 12345u;
+    auto uniform = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<double>(seed >> 8) / static_cast<double>(1u << 24);
+    };
+    for (int i = 0; i < 300; ++i) {
+        const double r = 1.0 + uniform();
+        const double th = 2.0 * M_PI * uniform();
+        const double v = std::sqrt(1.0 / r);
+        scene.emplace_back(1e-5 * uniform(), Vec2{r * std::cos(th), r * std::sin(th)},
+                           Vec2{-v * std::sin(th), v * std::cos(th)}, 1.0, 0xFFFFFF);
+    }
+
+    auto state_hash = [](const SimulatorBase& sim) {
+        std::uint64_t h = 1469598103934665603ull; // FNV-1a
+        auto mix = [&h](double value) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof bits);
+            for (int k = 0; k < 8; ++k) {
+                h ^= (bits >> (8 * k)) & 0xFFu;
+                h *= 1099511628211ull;
+            }
+        };
+        for (const auto& b : sim.get_bodies()) {
+            mix(b.pos.x);
+            mix(b.pos.y);
+            mix(b.vel.x);
+            mix(b.vel.y);
+            mix(b.acc.x);
+            mix(b.acc.y);
+        }
+        mix(sim.diagnostics().potential_energy);
+        return h;
+    };
+
+    std::uint64_t reference = 0;
+    bool ok = true;
+    for (unsigned threads : {1u, 2u, 8u}) {
+        Simulator sim(1.0, 1e-3, Integrator::RK4);
+        sim.set_softening(1e-2);
+        sim.set_bodies(scene);
+        sim.set_threads(threads);
+        sim.set_reproducible(true);
+        for (int i = 0; i < 50; ++i) {
+            sim.step();
+        }
+        const std::uint64_t h = state_hash(sim);
+        if (threads == 1) reference = h;
+        ok = ok && sim.get_threads() == threads && h == reference;
+    }
+    return ok;
+}
+
+bool test_compensated_summation_long_run() {
+    // A free body far from the origin with a step much smaller than its
+    // coordinate: plain summation loses the low digits of every increment,
+    // the compensated mode tracks the exact result (and the clock) closely.
+    const int steps = 1000000;
+    const double dt = 0.1;
+    const Vec2 p0{1.0e12, -3.0e11};
+    const Vec2 v0{1.0 / 3.0, 2.0 / 7.0};
+
+    auto run = [&](bool compensated) {
+        Simulator sim(Physics::DefaultG, dt, Integrator::Euler);
+        sim.set_compensated(compensated);
+        sim.add_body(Body(1.0, p0, v0, 1.0, 0xFFFFFF));
+        for (int i = 0; i < steps; ++i) {
+            sim.step();
+        }
+        const long double exact_x = static_cast<long double>(p0.x) +
+                                    steps * static_cast<long double>(v0.x * dt);
+        const double pos_error = static_cast<double>(std::abs(sim.get_bodies()[0].pos.x - exact_x));
+        const double time_error = std::abs(sim.get_time() - steps * dt);
+        return std::make_pair(pos_error, time_error);
+    };
+
+    const auto plain = run(false);
+    const auto comp = run(true);
+    std::cout << "[Compensated] position error: plain=" << plain.first << " m, compensated="
+              << comp.first << " m; time error: plain=" << plain.second
+              << " s, compensated=" << comp.second << " s\n";
+    const double ulp = std::nextafter(1.0e12, 2.0e12) - 1.0e12;
+    return comp.first <= ulp && comp.second <= 1e-10 &&
+           plain.first > 100.0 * comp.first && plain.second > 100.0 * comp.second;
+}
+
+bool test_density_map_incremental_update() {
+    // Moving items one by one must give the same counts and pixels as
+    // binning the final positions from scratch, and the dirty box must
+    // cover every changed cell.
+    const unsigned cols = 16, rows = 8, threshold = 3;
+    const std::size_t items = 200;
+    DensityMap incremental;
+    incremental.reset(cols, rows, items, threshold);
+    std::vector<int> cells(items);
+    for (std::size_t k = 0; k < items; ++k) {
+        cells[k] = incremental.cell_at(static_cast<int>(k % 5), static_cast<int>(k % 3));
+        incremental.place(k, cells[k]);
+    }
+    incremental.clear_dirty();
+    const std::vector<std::uint8_t> before = incremental.pixels();
+
+    for (std::size_t k = 0; k < items; k += 7) {
+        cells[k] = incremental.cell_at(static_cast<int>(10 + k % 4), 6);
+        incremental.place(k, cells[k]);
+    }
+    cells[1] = DensityMap::kOutside;
+    incremental.place(1, cells[1]);
+
+    DensityMap fresh;
+    fresh.reset(cols, rows, items, threshold);
+    for (std::size_t k = 0; k < items; ++k) {
+        fresh.place(k, cells[k]);
+    }
+
+    bool ok = incremental.pixels() == fresh.pixels() && incremental.dirty();
+    for (unsigned y = 0; y < rows; ++y) {
+        for (unsigned x = 0; x < cols; ++x) {
+            const int c = incremental.cell_at(static_cast<int>(x), static_cast<int>(y));
+            ok = ok && incremental.count(c) == fresh.count(c);
+            const bool changed = std::memcmp(&before[static_cast<std::size_t>(c) * 4],
+                                             &incremental.pixels()[static_cast<std::size_t>(c) * 4], 4) != 0;
+            const bool inside = x >= incremental.dirty_x0() && x < incremental.dirty_x1() &&
+                                y >= incremental.dirty_y0() && y < incremental.dirty_y1();
+            ok = ok && (!changed || inside);
+        }
+    }
+    return ok && incremental.aggregated(incremental.cell_at(10, 6)) &&
+           !incremental.aggregated(DensityMap::kOutside);
+}
+
+bool test_task_queue_runs_every_task() {
+    // A small queue forces the producer to block in push(); every task must
+    // still run exactly once, both before wait_idle() and at destruction.
+    constexpr int kTasks = 500;
+    std::vector<std::atomic<int>> hits(kTasks);
+    std::atomic<int> late {0};
+    {
+        TaskQueue queue(3, 2);
+        for (int k = 0; k < kTasks; ++k) {
+            queue.push([&hits, k] { hits[static_cast<std::size_t>(k)].fetch_add(1); });
+        }
+        queue.wait_idle();
+        for (int k = 0; k < 50; ++k) {
+            queue.push([&late] { late.fetch_add(1); });
+        }
+    }
+    bool ok = late.load() == 50;
+    for (const auto& h : hits) ok = ok && h.load() == 1;
+
+    // A throwing task leaves the workers running; wait_idle reports the first
+    // exception once.
+    std::atomic<int> after {0};
+    TaskQueue queue(2, 4);
+    queue.push([] { throw std::runtime_error("first"); });
+    for (int k = 0; k < 20; ++k) queue.push([&after] { after.fetch_add(1); });
+    std::string caught;
+    try {
+        queue.wait_idle();
+    } catch (const std::runtime_error& e) {
+        caught = e.what();
+    }
+    queue.wait_idle();
+    return ok && caught == "first" && after.load() == 20;
+}
+
+bool test_telemetry_stream_round_trip() {
+#ifdef _WIN32
+    return true;
+#else
+    Simulator sim(Physics::DefaultG, 60.0, Integrator::RK4);
+    sim.add_body(Body(5.97e24, Vec2{}, Vec2{}, 10.0, 0x3366FF, false, true, "Earth"));
+    const BodyHandle moon =
+        sim.add_body(Body(7.35e22, Vec2{3.84e8, 0.0}, Vec2{0.0, 1022.0}, 3.0, 0xCCCCCC, true, false, "Moon"));
+
+    TelemetryOptions options;
+    options.rate_hz = 0.0; // every publish
+    TelemetryServer server(options);
+    const std::string path = "/tmp/orbitsimlite_tests_" + std::to_string(::getpid()) + ".sock";
+    if (!server.start(path)) return false;
+
+    TelemetryClient client;
+    if (!client.connect(path)) return false;
+
+    // A new subscriber gets the catalog, then the newest state.
+    sim.step();
+    server.publish(sim);
+    std::vector<char> msg;
+    if (!client.read(msg)) return false;
+    const std::vector<std::string> names = TelemetryClient::names(msg);
+    bool ok = TelemetryClient::header(msg).type == static_cast<std::uint16_t>(TelemetryMessage::Catalog) &&
+              names.size() == 2 && names[0] == "Earth" && names[1] == "Moon";
+
+    if (!client.read(msg)) return false;
+    std::vector<TelemetryBodyState> states = TelemetryClient::states(msg);
+    ok = ok && states.size() == 2 && TelemetryClient::header(msg).time == sim.get_time() &&
+         states[1].pos[0] == sim.get_bodies()[1].pos.x && states[1].vel[1] == sim.get_bodies()[1].vel.y &&
+         states[0].mass == 5.97e24;
+
+    // Adding a body re-sends the catalog before the next state.
+    sim.add_body(Body(1.0e3, Vec2{4.0e8, 0.0}, Vec2{0.0, 900.0}, 1.0, 0xFFFFFF, false, false, "Probe"));
+    sim.step();
+    server.publish(sim);
+    if (!client.read(msg)) return false;
+    const TelemetryHeader catalog = TelemetryClient::header(msg);
+    ok = ok && catalog.type == static_cast<std::uint16_t>(TelemetryMessage::Catalog) && catalog.count == 3;
+    if (!client.read(msg)) return false;
+    states = TelemetryClient::states(msg);
+    ok = ok && TelemetryClient::header(msg).catalog == catalog.sequence && states.size() == 3 &&
+         states[2].pos[0] == sim.get_bodies()[2].pos.x;
+
+    // So does a change of colour with the same bodies and names.
+    sim.find_body(moon)->color = 0xFF0000;
+    sim.step();
+    server.publish(sim);
+    if (!client.read(msg)) return false;
+    const TelemetryHeader recoloured = TelemetryClient::header(msg);
+    ok = ok && recoloured.type == static_cast<std::uint16_t>(TelemetryMessage::Catalog) &&
+         recoloured.sequence > catalog.sequence;
+    if (ok && !client.read(msg)) return false; // the state that follows it
+
+    server.stop();
+    return ok && !client.read(msg);
+#endif
+}
+
+bool test_snapshot_codec_bounded_error() {
+    // Sun with four planets, recorded every step for 600 steps. Every decoded
+    // value must be within half a quantization step, and the stream must be
+    // far smaller than raw 56-byte-per-body frames.
+    Simulator sim(Physics::DefaultG, 3600.0, Integrator::RK4);
+    sim.add_body(Body(1.989e30, Vec2{}, Vec2{}, 30.0, 0xFFFF00, false, true, "Sun"));
+    const double radii[] = {5.79e10, 1.082e11, 1.496e11, 2.279e11};
+    for (int k = 0; k < 4; ++k) {
+        const double v = std::sqrt(Physics::DefaultG * 1.989e30 / radii[k]);
+        sim.add_body(Body(1.0e24, Vec2{radii[k] * std::cos(k), radii[k] * std::sin(k)},
+                          Vec2{-v * std::sin(k), v * std::cos(k)}, 5.0, 0xFFFFFF));
+    }
+
+    SnapshotCodecOptions options;
+    options.position_step = 10.0;
+    options.velocity_step = 1e-4;
+    options.include_acceleration = true;
+    options.acceleration_step = 1e-12;
+    options.keyframe_interval = 100;
+    SnapshotEncoder encoder(options);
+
+    constexpr int kFrames = 600;
+    std::vector<std::uint8_t> stream;
+    std::vector<std::vector<Body>> truth;
+    for (int f = 0; f < kFrames; ++f) {
+        sim.step();
+        if (f == 350) sim.access_bodies()[2].mass *= 2.0; // forces a keyframe
+        encoder.encode(sim, stream);
+        truth.push_back(sim.get_bodies());
+    }
+
+    SnapshotDecoder decoder;
+    Snapshot snap;
+    std::size_t offset = 0;
+    int keyframes = 0;
+    double pos_err = 0.0, vel_err = 0.0, acc_err = 0.0;
+    for (int f = 0; f < kFrames; ++f) {
+        if (!decoder.decode(stream.data(), stream.size(), offset, snap)) return false;
+        keyframes += snap.keyframe ? 1 : 0;
+        const auto& bs = truth[static_cast<std::size_t>(f)];
+        if (snap.pos.size() != bs.size() || snap.acc.size() != bs.size()) return false;
+        for (std::size_t i = 0; i < bs.size(); ++i) {
+            if (snap.mass[i] != bs[i].mass) return false;
+            pos_err = std::max({pos_err, std::abs(snap.pos[i].x - bs[i].pos.x), std::abs(snap.pos[i].y - bs[i].pos.y)});
+            vel_err = std::max({vel_err, std::abs(snap.vel[i].x - bs[i].vel.x), std::abs(snap.vel[i].y - bs[i].vel.y)});
+            acc_err = std::max({acc_err, std::abs(snap.acc[i].x - bs[i].acc.x), std::abs(snap.acc[i].y - bs[i].acc.y)});
+        }
+    }
+
+    // Half a step, plus the rounding of reference + q * step near 2e11 m.
+    const bool bounded = pos_err <= 0.5 * options.position_step + 1e-4 &&
+                         vel_err <= 0.5 * options.velocity_step * (1.0 + 1e-9) &&
+                         acc_err <= 0.5 * options.acceleration_step * (1.0 + 1e-9);
+    const double raw_bytes = 56.0 * 5 * kFrames;
+    const bool compact = static_cast<double>(stream.size()) < 0.25 * raw_bytes;
+    // Keyframes at 0, 100, 200, 300, 350 (mass change), 450, 550.
+    return bounded && compact && keyframes == 7 && offset == stream.size() &&
+           !decoder.decode(stream.data(), stream.size(), offset, snap);
+}
+
+bool test_lz_codec_round_trip() {
+    std::vector<std::uint8_t> data;
+    std::uint32_t x = 12345;
+    for (int k = 0; k < 20000; ++k) {
+        x = x * 1664525u + 1013904223u;
+        // Mix of random bytes, short repeats and long runs.
+        if (k % 1000 < 600) data.push_back(static_cast<std::uint8_t>(x >> 24));
+        else if (k % 1000 < 900) data.push_back(static_cast<std::uint8_t>("orbit"[k % 5]));
+        else data.push_back(0);
+    }
+
+    bool ok = true;
+    for (std::size_t len : {std::size_t(0), std::size_t(3), std::size_t(17), data.size()}) {
+        std::vector<std::uint8_t> packed, unpacked;
+        lz_compress(data.data(), len, packed);
+        ok = ok && lz_decompress(packed.data(), packed.size(), len, unpacked) &&
+             std::equal(unpacked.begin(), unpacked.end(), data.begin()) && unpacked.size() == len;
+        if (len == data.size()) {
+            ok = ok && packed.size() < data.size() &&
+                 !lz_decompress(packed.data(), packed.size() - 1, len, unpacked);
+        }
+    }
+
+    // Untrusted sizes: a recorded length the block cannot reach is rejected
+    // before anything is reserved, and a match or literal run longer than
+    // the rest of the output fails without the bound check wrapping.
+    std::vector<std::uint8_t> packed, unpacked;
+    lz_compress(data.data(), data.size(), packed);
+    const std::size_t huge = std::numeric_limits<std::size_t>::max() - 2;
+    ok = ok && !lz_decompress(packed.data(), packed.size(), huge, unpacked) &&
+         !lz_decompress(packed.data(), packed.size(), lz_max_decompressed_size(packed.size()), unpacked);
+    std::vector<std::uint8_t> long_match;
+    put_varint(long_match, 4);
+    long_match.insert(long_match.end(), {'a', 'b', 'c', 'd'});
+    put_varint(long_match, 4);
+    put_varint(long_match, std::numeric_limits<std::uint64_t>::max() - 2);
+    put_varint(long_match, 0);
+    put_varint(long_match, 0);
+    ok = ok && !lz_decompress(long_match.data(), long_match.size(), 64, unpacked);
+
+    // Runs longer than the longest match still round-trip.
+    std::vector<std::uint8_t> run(200000, 7), run_packed, run_unpacked;
+    lz_compress(run.data(), run.size(), run_packed);
+    return ok && lz_decompress(run_packed.data(), run_packed.size(), run.size(), run_unpacked) && run_unpacked == run;
+}
+
+bool test_state_publisher_consistent_views() {
+    // Writer thread: every body of snapshot g carries g in all fields. A
+    // reader racing with it must only ever see uniform snapshots.
+    constexpr std::size_t kBodies = 64;
+    StatePublisher publisher(kBodies, 3);
+    StateReader reader(publisher);
+
+    std::atomic<bool> done {false};
+    std::thread writer([&] {
+        std::vector<Body> bodies(kBodies);
+        for (int g = 1; g <= 20000; ++g) {
+            for (auto& b : bodies) {
+                b.mass = b.pos.x = b.pos.y = b.vel.x = b.vel.y = b.acc.x = b.acc.y = g;
+            }
+            publisher.publish(bodies, g);
+        }
+        done = true;
+    });
+
+    bool ok = true;
+    std::vector<PublishedBody> copy;
+    std::uint64_t last = 0;
+    while (!done.load()) {
+        double time = 0.0;
+        std::uint64_t generation = 0;
+        if (!reader.read(copy, &time, &generation)) continue;
+        ok = ok && copy.size() == kBodies && generation >= last && time == static_cast<double>(generation);
+        last = generation;
+        for (const auto& b : copy) {
+            ok = ok && b.mass == time && b.pos[0] == time && b.pos[1] == time && b.vel[0] == time &&
+                 b.vel[1] == time && b.acc[0] == time && b.acc[1] == time;
+        }
+
+        // Zero-copy: read in place, then confirm.
+        StateReader::View view;
+        if (reader.acquire(view)) {
+            const double first = view.bodies[0].mass;
+            const double last_body = view.bodies[view.count - 1].acc[1];
+            if (reader.still_valid(view)) ok = ok && first == view.time && last_body == view.time;
+        }
+    }
+    writer.join();
+
+    // Attached to a simulator: each step publishes the new state.
+    Simulator sim(Physics::DefaultG, 60.0, Integrator::RK4);
+    sim.add_body(Body(5.97e24, Vec2{}, Vec2{}, 10.0, 0x3366FF, false, true, "Earth"));
+    sim.add_body(Body(7.35e22, Vec2{3.84e8, 0.0}, Vec2{0.0, 1022.0}, 3.0, 0xCCCCCC, true, false,
+                      "Moon with a rather long name"));
+    StatePublisher sim_publisher(8);
+    StateReader sim_reader(sim_publisher);
+    sim.set_state_publisher(&sim_publisher);
+    ok = ok && !sim_reader.read(copy);
+    sim.step();
+    sim.step();
+    double time = 0.0;
+    ok = ok && sim_reader.read(copy, &time) && copy.size() == 2 && time == sim.get_time() &&
+         copy[1].pos[0] == sim.get_bodies()[1].pos.x && copy[1].vel[1] == sim.get_bodies()[1].vel.y &&
+         std::string(copy[0].name) == "Earth" && std::string(copy[1].name) == "Moon with a rather long" &&
+         (copy[0].flags & kPublishedStar) && (copy[1].flags & kPublishedSatellite);
+
+#ifndef _WIN32
+    // Cross-process layout, mapped twice within this process.
+    const std::string name = "/orbitsimlite_tests_" + std::to_string(::getpid());
+    std::string error;
+    auto shared = StatePublisher::create_shared(name, 8, 3, &error);
+    if (!shared) return false;
+    auto mapped = StateReader::open_shared(name, &error);
+    if (!mapped) return false;
+    sim.set_state_publisher(shared.get());
+    sim.step();
+    ok = ok && mapped->read(copy, &time) && copy.size() == 2 && time == sim.get_time() &&
+         copy[0].mass == 5.97e24 && copy[1].pos[1] == sim.get_bodies()[1].pos.y;
+    sim.set_state_publisher(nullptr);
+#endif
+    return ok;
+}
+
+bool test_interned_body_names() {
+    Body a(1.0, Vec2{}, Vec2{}, 1.0, 0xFFFFFF, false, false, "Phobos");
+    Body b(2.0, Vec2{}, Vec2{}, 1.0, 0xFFFFFF, false, false, std::string("Pho") + "bos");
+    Body unnamed;
+
+    // Equal text, equal id; copies share it without touching the table.
+    const std::size_t before = interned_name_count();
+    std::vector<Body> copies(1000, a);
+    Body c = b;
+    c.set_name("Deimos");
+    return a.name_id == b.name_id && a.name() == "Phobos" && copies[999].name_id == a.name_id &&
+           !unnamed.has_name() && unnamed.name().empty() && intern_name("") == kNoName &&
+           c.name() == "Deimos" && b.name() == "Phobos" && interned_name_count() == before + 1 &&
+           name_of(1u << 30).empty();
+}
+
+bool test_body_handles_stable_across_removal() {
+    Simulator sim(Physics::DefaultG, 60.0, Integrator::RK4);
+    std::vector<BodyHandle> handles;
+    for (int k = 0; k < 10; ++k) {
+        handles.push_back(sim.add_body(Body(1.0e20 * (k + 1), Vec2{1.0e7 * k, 0.0}, Vec2{}, 1.0, 0xFFFFFF)));
+    }
+
+    // Remove a few in arbitrary order; survivors keep their handles.
+    bool ok = sim.remove_body(handles[3]) && sim.remove_body(handles[0]) && sim.remove_body(handles[9]);
+    ok = ok && !sim.remove_body(handles[3]) && !sim.contains(handles[0]) && sim.get_bodies().size() == 7;
+    for (int k : {1, 2, 4, 5, 6, 7, 8}) {
+        const Body* b = sim.find_body(handles[static_cast<std::size_t>(k)]);
+        ok = ok && b && b->mass == 1.0e20 * (k + 1) &&
+             sim.handle_at(sim.index_of(handles[static_cast<std::size_t>(k)])) == handles[static_cast<std::size_t>(k)];
+    }
+
+    // Reused slots get a new generation: the old handle stays stale.
+    const BodyHandle fresh = sim.add_body(Body(5.0, Vec2{}, Vec2{}, 1.0, 0xFFFFFF));
+    ok = ok && fresh.slot == handles[9].slot && fresh != handles[9] && !sim.find_body(handles[9]) &&
+         sim.find_body(fresh)->mass == 5.0;
+
+    // Handles survive stepping; bodies appended through access_bodies() get
+    // handles lazily; set_bodies() starts over.
+    sim.step();
+    ok = ok && sim.find_body(handles[5]) && sim.find_body(handles[5])->mass == 6.0e20;
+    sim.access_bodies().push_back(Body(7.0, Vec2{}, Vec2{}, 1.0, 0xFFFFFF));
+    const BodyHandle appended = sim.handle_at(sim.get_bodies().size() - 1);
+    ok = ok && sim.find_body(appended) && sim.find_body(appended)->mass == 7.0 && sim.contains(handles[5]);
+    sim.set_bodies(sim.get_bodies());
+    return ok && !sim.contains(handles[5]) && !sim.contains(BodyHandle{}) && sim.contains(sim.handle_at(0));
+}
+
+bool test_hierarchical_subsystem_tracks_moon() {
+    // Sun, Jupiter, Earth and Moon over three months. With the Earth-Moon
+    // pair declared as a subsystem, 6-hour outer steps follow the lunar orbit
+    // closely; the same step without it loses the Moon entirely.
+    auto make = [](double dt, Integrator integrator) {
+        Simulator sim(Physics::DefaultG, dt, integrator);
+        sim.add_body(Body(1.989e30, Vec2{}, Vec2{}, 1.0, 0xFFFFFF, false, true, "Sun"));
+        sim.add_body(Body(1.898e27, Vec2{7.785e11, 0.0}, Vec2{0.0, 13070.0}, 1.0, 0xFFFFFF));
+        sim.add_body(Body(5.972e24, Vec2{1.496e11, 0.0}, Vec2{0.0, 29783.0}, 1.0, 0xFFFFFF));
+        sim.add_body(Body(7.35e22, Vec2{1.496e11 + 3.844e8, 0.0}, Vec2{0.0, 29783.0 + 1022.0}, 1.0, 0xFFFFFF, true));
+        return sim;
+    };
+    auto moon_offset = [](const Simulator& sim) { return sim.get_bodies()[3].pos - sim.get_bodies()[2].pos; };
+
+    const double span = 90.0 * 86400.0;
+    Simulator ref = make(60.0, Integrator::WisdomHolman);
+    for (int k = 0; k < static_cast<int>(span / 60.0); ++k) ref.step();
+
+    Simulator plain = make(21600.0, Integrator::RK4);
+    Simulator hier = make(21600.0, Integrator::RK4);
+    if (hier.detect_subsystems() != 1) return false;
+    const Subsystem& sub = hier.get_subsystems()[0];
+    if (sub.primary != hier.handle_at(2) || sub.secondary != hier.handle_at(3)) return false;
+    if (hier.add_subsystem(hier.handle_at(1), hier.handle_at(3))) return false; // Moon is taken
+
+    for (int k = 0; k < static_cast<int>(span / 21600.0); ++k) {
+        plain.step();
+        hier.step();
+    }
+    const double sep = 3.844e8;
+    const double err_hier = (moon_offset(hier) - moon_offset(ref)).length() / sep;
+    const double err_plain = (moon_offset(plain) - moon_offset(ref)).length() / sep;
+    const double err_earth = (hier.get_bodies()[2].pos - ref.get_bodies()[2].pos).length() / 1.496e11;
+
+    // Removing the Moon dissolves the subsystem.
+    hier.remove_body(hier.handle_at(3));
+    hier.step();
+    return err_hier < 1.0e-3 && err_plain > 100.0 * err_hier && err_earth < 1.0e-5 && hier.get_subsystems().empty();
+}
+
+bool test_close_encounter_regularization() {
+    // Two bodies falling almost head-on (miss distance 1e-4) next to a
+    // distant third one. Fixed steps blow the pair apart at the first
+    // pericentre; with regularisation the encounters cost the same per step
+    // and energy holds.
+    auto run = [](double distance, std::size_t* regularized) {
+        Simulator sim(1.0, 0.01, Integrator::RK4);
+        sim.set_substeps(4);
+        sim.add_body(Body(1.0, Vec2{-1.0, -5.0e-5}, Vec2{0.5, 0.0}, 1.0, 0xFFFFFF));
+        sim.add_body(Body(1.0, Vec2{1.0, 5.0e-5}, Vec2{-0.5, 0.0}, 1.0, 0xFFFFFF));
+        sim.add_body(Body(0.5, Vec2{0.0, 10.0}, Vec2{}, 1.0, 0xFFFFFF));
+        sim.set_regularization(distance);
+        const double e0 = sim.diagnostics().total_energy;
+        for (int k = 0; k < 400; ++k) {
+            sim.step();
+            if (regularized) *regularized += sim.get_regularized_pair_count();
+        }
+        return std::fabs(sim.diagnostics().total_energy / e0 - 1.0);
+    };
+    std::size_t regularized = 0;
+    const double drift_plain = run(0.0, nullptr);
+    const double drift_regularized = run(0.5, &regularized);
+
+    // Automatic substeps skip exactly the regularised pairs. A third body
+    // inside the distance of a regularised pair stays in the outer
+    // integration and must drive the substeps...
+    Simulator triple(1.0, 0.01, Integrator::RK4);
+    triple.add_body(Body(1.0, Vec2{0.0, 0.0}, Vec2{}, 1.0, 0xFFFFFF));
+    triple.add_body(Body(1.0, Vec2{0.02, 0.0}, Vec2{}, 1.0, 0xFFFFFF));
+    triple.add_body(Body(1.0, Vec2{-0.05, 0.0}, Vec2{}, 1.0, 0xFFFFFF));
+    triple.set_regularization(0.1);
+    triple.set_auto_substeps(0.1);
+    triple.step();
+    // ...while a pair that only comes within the distance during the step
+    // is regularised and must not.
+    Simulator flyby(1.0, 0.01, Integrator::RK4);
+    flyby.add_body(Body(1e-3, Vec2{0.0, 0.0}, Vec2{15.0, 0.0}, 1.0, 0xFFFFFF));
+    flyby.add_body(Body(1e-3, Vec2{0.3, 0.01}, Vec2{-15.0, 0.0}, 1.0, 0xFFFFFF));
+    flyby.set_regularization(0.1);
+    flyby.set_auto_substeps(0.1);
+    flyby.step();
+    return drift_plain > 1.0 && drift_regularized < 0.05 && regularized > 0 &&
+           triple.get_regularized_pair_count() == 1 && triple.get_last_substeps() > 10 &&
+           flyby.get_regularized_pair_count() == 1 && flyby.get_last_substeps() == 1;
+}
+
+bool test_step_executor_shares_workers() {
+    // Jobs on one worker take turns chunk by chunk, end bit-identical to
+    // serial stepping and can be cancelled between chunks.
+    auto make = [] {
+        Simulator sim(Physics::DefaultG, 60.0, Integrator::RK4);
+        sim.add_body(Body(5.97e24, Vec2{}, Vec2{}, 10.0, 0xFFFFFF));
+        sim.add_body(Body(7.35e22, Vec2{3.84e8, 0.0}, Vec2{0.0, 1022.0}, 3.0, 0xFFFFFF, true));
+        return sim;
+    };
+    Simulator a = make(), b = make(), c = make(), serial = make();
+    for (int k = 0; k < 100; ++k) serial.step();
+
+    std::vector<int> order;
+    std::mutex order_mutex;
+    auto log = [&](int id) {
+        return [&order, &order_mutex, id](const AdvanceProgress&) {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(id);
+        };
+    };
+
+    AdvanceResult ra, rb, rc;
+    {
+        // The gate job holds the only worker until all three are queued.
+        StepExecutor executor(1, 10);
+        std::atomic<bool> open {false};
+        Simulator gate = make();
+        AdvanceHandle hg = executor.advance_until(gate, 60.0, [&open](const AdvanceProgress&) {
+            while (!open.load()) std::this_thread::yield();
+        });
+        AdvanceHandle ha = executor.advance_until(a, 6000.0, log(0));
+        AdvanceHandle hb = executor.advance_until(b, 3000.0, log(1));
+        AdvanceHandle hc = executor.advance_until(c, 1.0e9, log(2));
+        open.store(true);
+        if (hg.future().get().steps != 1) return false;
+        while (!hb.ready()) std::this_thread::yield(); // how an event loop would poll
+        ra = ha.future().get();
+        rb = hb.future().get();
+        hc.cancel();
+        rc = hc.future().get();
+    }
+
+    // Round-robin while all three are queued.
+    bool ok = order.size() >= 15;
+    for (std::size_t k = 0; ok && k < 15; ++k) ok = order[k] == static_cast<int>(k % 3);
+
+    ok = ok && ra.status == AdvanceStatus::Completed && ra.steps == 100 && a.get_time() == 6000.0;
+    ok = ok && rb.status == AdvanceStatus::Completed && rb.steps == 50;
+    ok = ok && rc.status == AdvanceStatus::Cancelled && rc.steps < 1000000 && rc.steps % 10 == 0;
+    for (std::size_t i = 0; i < 2; ++i) {
+        ok = ok && a.get_bodies()[i].pos.x == serial.get_bodies()[i].pos.x &&
+             a.get_bodies()[i].pos.y == serial.get_bodies()[i].pos.y;
+    }
+    return ok;
+}
+
+bool test_events_located_within_step() {
+    // Periapsis/apoapsis and line-crossing times of a Kepler ellipse (e =
+    // 0.5, started at apoapsis) against the analytic orbit, at 100 steps per
+    // orbit; then an escape under thrust, located where the orbital energy is
+    // zero.
+    const double mu = 1.0, a = 1.0, e = 0.5;
+    const double period = 2.0 * 3.14159265358979323846 * std::sqrt(a * a * a / mu);
+    const double ra = a * (1.0 + e);
+    const double va = std::sqrt(mu * (1.0 - e) / ra);
+
+    Simulator sim(1.0, period / 100.0, Integrator::RK4);
+    sim.set_substeps(4);
+    const BodyHandle sun = sim.add_body(Body(1.0, Vec2{}, Vec2{}, 1.0, 0xFFFFFF));
+    const BodyHandle planet = sim.add_body(Body(1.0e-12, Vec2{ra, 0.0}, Vec2{0.0, va}, 1.0, 0xFFFFFF));
+
+    std::vector<double> peri, apo, cross;
+    double peri_distance = 0.0;
+    sim.add_event(distance_minimum(sim, planet, sun), [&](const EventInfo& ev, const std::vector<Body>& bs) {
+        peri.push_back(ev.time);
+        peri_distance = bs[1].pos.length();
+    });
+    sim.add_event(distance_maximum(sim, planet, sun), [&](const EventInfo& ev, const std::vector<Body>&) {
+        apo.push_back(ev.time);
+    });
+    // Upward crossings of the x axis (from the right of +x to its left).
+    sim.add_event(line_crossing(sim, planet, Vec2{}, Vec2{1.0, 0.0}, EventDirection::Rising),
+                  [&](const EventInfo& ev, const std::vector<Body>&) { cross.push_back(ev.time); });
+    for (int k = 0; k < 300; ++k) sim.step();
+
+    bool ok = peri.size() == 3 && apo.size() == 3 && cross.size() == 3;
+    for (std::size_t k = 0; ok && k < 3; ++k) {
+        ok = std::fabs(peri[k] - (k + 0.5) * period) < 1e-5 * period &&
+             std::fabs(apo[k] - (k + 1.0) * period) < 1e-5 * period &&
+             std::fabs(cross[k] - (k + 1.0) * period) < 1e-5 * period;
+    }
+    ok = ok && std::fabs(peri_distance - a * (1.0 - e)) < 1e-6;
+
+    // Copies and assignment targets keep the sample count but start
+    // without events or a publisher.
+    sim.set_event_samples(9);
+    StatePublisher publisher(4);
+    Simulator copy = sim;
+    Simulator assigned(1.0, 1.0, Integrator::Euler);
+    const std::size_t own = assigned.add_event(escape(sim, planet, sun), nullptr);
+    assigned.set_state_publisher(&publisher);
+    assigned = sim;
+    ok = ok && copy.get_event_samples() == 9 && assigned.get_event_samples() == 9 && !assigned.remove_event(own) &&
+         assigned.get_state_publisher() == nullptr;
+
+    // Thrust along the velocity until the planet is unbound.
+    ExtraForces thrust;
+    thrust.drag_rate = -0.05;
+    sim.set_extra_forces(thrust);
+    sim.clear_events();
+    int escapes = 0;
+    double energy_at_escape = 1.0;
+    sim.add_event(escape(sim, planet, sun), [&](const EventInfo&, const std::vector<Body>& bs) {
+        ++escapes;
+        energy_at_escape = 0.5 * bs[1].vel.length_squared() - mu / bs[1].pos.length();
+    });
+    for (int k = 0; k < 2000 && escapes == 0; ++k) sim.step();
+    return ok && escapes == 1 && std::fabs(energy_at_escape) < 1e-9;
+}
+
+bool test_dense_output_between_steps() {
+    // The interpolant inside each coarse step must follow a run with eight
+    // times smaller steps; Wisdom-Holman is exact for two bodies, so the
+    // difference is the interpolation error alone.
+    const double mu = 1.0, a = 1.0, e = 0.5;
+    const double period = 2.0 * 3.14159265358979323846 * std::sqrt(a * a * a / mu);
+    const double ra = a * (1.0 + e);
+    const double va = std::sqrt(mu * (1.0 - e) / ra);
+    const int sub = 8;
+
+    Simulator coarse(1.0, period / 100.0, Integrator::WisdomHolman);
+    coarse.add_body(Body(1.0, Vec2{}, Vec2{}, 1.0, 0xFFFFFF));
+    coarse.add_body(Body(1.0e-12, Vec2{ra, 0.0}, Vec2{0.0, va}, 1.0, 0xFFFFFF));
+    Simulator fine = coarse;
+    fine.set_dt(period / (100.0 * sub));
+
+    std::vector<Body> interpolated;
+    if (coarse.state_at(0.0, interpolated)) return false; // no step yet
+    coarse.set_dense_output(true);
+
+    double max_err = 0.0;
+    for (int k = 0; k < 100; ++k) {
+        coarse.step();
+        for (int j = 1; j <= sub; ++j) {
+            fine.step();
+            const double t = std::min(fine.get_time(), coarse.get_time());
+            if (!coarse.state_at(t, interpolated)) return false;
+            max_err = std::max(max_err, (interpolated[1].pos - fine.get_bodies()[1].pos).length());
+        }
+    }
+
+    const double t1 = coarse.get_time();
+    const bool outside = !coarse.state_at(t1 + 1e-9, interpolated) &&
+                         !coarse.state_at(coarse.dense_output_begin() - 1e-9, interpolated);
+    coarse.access_bodies();
+    const bool invalidated = !coarse.state_at(t1, interpolated);
+    return max_err < 1e-7 && outside && invalidated;
+}
+
+bool test_auto_substeps_follow_timescale() {
+    // On an e = 0.9 orbit the automatic count concentrates substeps near
+    // periapsis; the same total spent uniformly leaves a 100x larger error.
+    const double mu = 1.0, a = 1.0, e = 0.9;
+    const double period = 2.0 * 3.14159265358979323846 * std::sqrt(a * a * a / mu);
+    const double ra = a * (1.0 + e);
+    const double va = std::sqrt(mu * (1.0 - e) / ra);
+    const int steps = 200;
+
+    Simulator adaptive(1.0, period / steps, Integrator::RK4);
+    adaptive.add_body(Body(1.0, Vec2{}, Vec2{}, 1.0, 0xFFFFFF));
+    adaptive.add_body(Body(1.0e-12, Vec2{ra, 0.0}, Vec2{0.0, va}, 1.0, 0xFFFFFF));
+    Simulator uniform = adaptive;
+    adaptive.set_auto_substeps(0.02);
+
+    const double tau_apo = std::min(std::sqrt(ra * ra * ra / mu), ra / va);
+    if (std::fabs(adaptive.dynamical_timescale() - tau_apo) > 1e-12 * tau_apo) return false;
+
+    int total = 0, fewest = 1 << 30, most = 0;
+    for (int k = 0; k < steps; ++k) {
+        adaptive.step();
+        total += adaptive.get_last_substeps();
+        fewest = std::min(fewest, adaptive.get_last_substeps());
+        most = std::max(most, adaptive.get_last_substeps());
+    }
+    uniform.set_substeps((total + steps - 1) / steps);
+    for (int k = 0; k < steps; ++k) uniform.step();
+
+    const Vec2 start{ra, 0.0};
+    const double err_adaptive = (adaptive.get_bodies()[1].pos - start).length();
+    const double err_uniform = (uniform.get_bodies()[1].pos - start).length();
+    return most > 10 * fewest && err_adaptive < 1e-5 && err_adaptive * 100.0 < err_uniform;
+}
+
+bool test_spatial_reordering_keeps_handles() {
+    // Sorting along the Morton curve keeps every handle on its body, leaves a
+    // sorted set unchanged and does not alter the trajectories beyond the
+    // round-off of the changed summation order.
+    Simulator sim(1.0, 1e-3, Integrator::RK4);
+    std::vector<BodyHandle> handles;
+    Lcg next{12345u};
+    for (int k = 0; k < 200; ++k) {
+        const Vec2 pos{next() * 10.0, next() * 10.0};
+        handles.push_back(sim.add_body(Body(1e-3 * (k + 1), pos, Vec2{next() - 0.5, next() - 0.5}, 1.0, 0xFFFFFF)));
+    }
+    Simulator plain = sim;
+    sim.reorder_bodies();
+
+    bool ok = sim.index_of(handles[0]) != 0 || sim.index_of(handles[1]) != 1; // actually reordered
+    for (int k = 0; k < 200 && ok; ++k) {
+        const Body* b = sim.find_body(handles[static_cast<std::size_t>(k)]);
+        const Body& orig = plain.get_bodies()[static_cast<std::size_t>(k)];
+        ok = b && b->mass == orig.mass && b->pos.x == orig.pos.x && b->pos.y == orig.pos.y &&
+             b->vel.x == orig.vel.x && b->vel.y == orig.vel.y;
+    }
+    std::vector<std::size_t> order;
+    spatial_order(sim.get_bodies(), order);
+    for (std::size_t k = 0; k < order.size() && ok; ++k) ok = order[k] == k;
+    ok = ok && morton_key(1, 0) == 1 && morton_key(0, 1) == 2 && morton_key(3, 3) == 15;
+
+    // A non-finite first body neither seeds the bounding box nor sorts first.
+    std::vector<Body> stray;
+    for (const Vec2 p : {Vec2{std::nan(""), 0.0}, Vec2{1.0, 1.0}, Vec2{0.0, 0.0}, Vec2{1.0, 0.0}}) {
+        stray.emplace_back(1.0, p, Vec2{}, 1.0, 0xFFFFFF);
+    }
+    spatial_order(stray, order);
+    ok = ok && order == std::vector<std::size_t> {2, 3, 1, 0};
+
+    sim.set_spatial_reordering(5);
+    double max_dev = 0.0;
+    for (int k = 0; k < 50; ++k) {
+        sim.step();
+        plain.step();
+    }
+    for (int k = 0; k < 200; ++k) {
+        const Body* b = sim.find_body(handles[static_cast<std::size_t>(k)]);
+        max_dev = std::max(max_dev, (b->pos - plain.get_bodies()[static_cast<std::size_t>(k)].pos).length());
+    }
+    return ok && max_dev < 1e-9;
+}
+
+bool test_tiled_forces_match_single_target() {
+    // The tiled force pass must give exactly the bits of one target at a
+    // time, including targets whose own source falls inside a register block
+    // and a last tile that is only partly filled.
+    std::vector<Body> bodies;
+    Lcg next{4242u};
+    for (int k = 0; k < 203; ++k) {
+        Body b(1.0 + next(), Vec2{next(), next()}, Vec2{}, 1.0, 0xFFFFFF);
+        b.softening = (k % 3 == 0) ? 0.01 * next() : 0.0;
+        b.is_test_particle = (k % 17 == 5);
+        bodies.push_back(b);
+    }
+    TestParticles none;
+    ForceKernel<PlummerGravity> kernel(PlummerGravity{0.002});
+    kernel.compute(bodies, none, 1.0);
+
+    bool ok = true;
+    for (std::size_t i = 0; i < bodies.size() && ok; ++i) {
+        double phi = 0.0;
+        const Vec2 a = kernel.field_at(bodies[i].pos, bodies[i].softening * bodies[i].softening,
+                                       kernel.source_of(i), phi);
+        ok = a.x == bodies[i].acc.x && a.y == bodies[i].acc.y;
+    }
+    return ok;
+}
+
+void make_domain_system(int ranks, std::vector<Simulator>& parts, Simulator& whole) {
+    // A softened system of 20 bodies and 10 test particles per rank, each
+    // rank starting with a scattered slice so that rebalancing has work;
+    // 'whole' holds the concatenation of the slices.
+    Lcg next{777u};
+    parts.assign(static_cast<std::size_t>(ranks), Simulator(1.0, 1e-3, Integrator::RK4));
+    whole = Simulator(1.0, 1e-3, Integrator::RK4);
+    ExtraForces extra;
+    extra.speed_of_light = 20.0;
+    whole.set_extra_forces(extra);
+    for (Simulator& sim : parts) sim.set_extra_forces(extra);
+    for (int r = 0; r < ranks; ++r) {
+        for (int k = 0; k < 20; ++k) {
+            Body b(0.01 + 0.01 * next(), Vec2{next() * 10.0, next() * 10.0}, Vec2{next() - 0.5, next() - 0.5}, 1.0,
+                   0xFFFFFF);
+            b.softening = 0.05;
+            b.is_test_particle = (k % 7 == 3);
+            b.is_star = (r == 1 && k == 5); // anchors the post-Newtonian term on another rank
+            b.set_name("d" + std::to_string(r * 20 + k));
+            parts[static_cast<std::size_t>(r)].add_body(b);
+            whole.add_body(b);
+        }
+        for (int k = 0; k < 10; ++k) {
+            const Vec2 p{next() * 10.0, next() * 10.0};
+            const Vec2 v{next() - 0.5, next() - 0.5};
+            parts[static_cast<std::size_t>(r)].add_test_particle(p, v);
+            whole.add_test_particle(p, v);
+        }
+    }
+}
+
+double max_deviation_by_name(const Simulator& part, const Simulator& whole) {
+    // Largest distance between a body of 'part' and the body of 'whole' with
+    // the same name; infinite if one is missing.
+    double max_dev = 0.0;
+    for (const Body& b : part.get_bodies()) {
+        const Body* w = nullptr;
+        for (const Body& c : whole.get_bodies()) {
+            if (c.name() == b.name()) w = &c;
+        }
+        if (!w) return std::numeric_limits<double>::infinity();
+        max_dev = std::max(max_dev, (b.pos - w->pos).length());
+    }
+    return max_dev;
+}
+
+bool test_domain_decomposition_matches_single_process() {
+    // Three ranks on loopback threads integrate the same system as one
+    // simulator holding the concatenation of their bodies: the same bits
+    // before any migration, the same trajectories after rebalancing.
+    constexpr int ranks = 3;
+    std::vector<Simulator> parts;
+    Simulator whole;
+    make_domain_system(ranks, parts, whole);
+
+    LoopbackGroup group(ranks);
+
+    // Schemes that need every body in one place are refused in either order.
+    Simulator wh(1.0, 1e-3, Integrator::WisdomHolman);
+    BasicSimulator<WisdomHolmanIntegration> basic_wh(1.0, 1e-3);
+    Simulator regularised(1.0, 1e-3, Integrator::RK4);
+    regularised.set_regularization(0.1);
+    Simulator decomposed = parts[0];
+    bool refused = !wh.set_transport(&group.rank(0)) && wh.get_transport() == nullptr &&
+                   !basic_wh.set_transport(&group.rank(0)) &&
+                   !regularised.set_transport(&group.rank(0)) && decomposed.set_transport(&group.rank(0)) &&
+                   !decomposed.set_integrator(Integrator::WisdomHolman) &&
+                   decomposed.get_integrator() == Integrator::RK4 && !decomposed.set_regularization(0.1) &&
+                   decomposed.set_regularization(0.0) && decomposed.detect_subsystems() == 0 &&
+                   !decomposed.add_subsystem(decomposed.handle_at(0), decomposed.handle_at(1));
+
+    // The closest pair straddles two ranks, so no rank finds it on its own;
+    // the timescale and the substeps it drives must cover it.
+    const Vec2 close = parts[0].get_bodies()[0].pos + Vec2{0.02, 0.01};
+    parts[1].access_bodies()[0].pos = close;
+    whole.access_bodies()[20].pos = close;
+    double local_tau = std::numeric_limits<double>::infinity();
+    for (const Simulator& sim : parts) local_tau = std::min(local_tau, sim.dynamical_timescale());
+    const double whole_tau = whole.dynamical_timescale();
+    whole.set_auto_substeps(1e-3);
+    for (Simulator& sim : parts) sim.set_auto_substeps(1e-3);
+
+    std::vector<double> timescales(ranks, 0.0);
+    std::vector<Diagnostics> shares(ranks);
+    std::vector<Diagnostics> totals(ranks);
+    std::vector<std::size_t> counts(ranks);
+    std::atomic<int> energy_before_step {0};
+    std::atomic<int> drift_alerts {0};
+    std::vector<double> references(ranks, 0.0);
+    auto run_ranks = [&](int steps, bool rebalance) {
+        std::vector<std::thread> threads;
+        for (int r = 0; r < ranks; ++r) {
+            threads.emplace_back([&, r] {
+                Simulator& sim = parts[static_cast<std::size_t>(r)];
+                sim.set_transport(&group.rank(r));
+                // A rank cannot evaluate its potential without a force pass.
+                if (!std::isnan(sim.diagnostics().total_energy)) energy_before_step.fetch_add(1);
+                if (!rebalance) timescales[static_cast<std::size_t>(r)] = sim.dynamical_timescale();
+                if (rebalance) {
+                    // The reference taken at the first step must survive
+                    // every later migration.
+                    sim.set_energy_drift_alert(1e-3, [&](const Diagnostics&, double) { drift_alerts.fetch_add(1); });
+                    sim.rebalance();
+                    sim.step();
+                    references[static_cast<std::size_t>(r)] = sim.get_energy_reference();
+                    sim.set_rebalancing(2);
+                }
+                for (int k = rebalance ? 1 : 0; k < steps; ++k) sim.step();
+                if (rebalance && sim.get_energy_reference() != references[static_cast<std::size_t>(r)]) {
+                    drift_alerts.fetch_add(100);
+                }
+                shares[static_cast<std::size_t>(r)] = sim.diagnostics();
+                totals[static_cast<std::size_t>(r)] = reduce_diagnostics(sim.diagnostics(), group.rank(r));
+                counts[static_cast<std::size_t>(r)] = sim.get_bodies().size() + sim.get_test_particles().size();
+            });
+        }
+        for (auto& t : threads) t.join();
+        for (int k = 0; k < steps; ++k) whole.step();
+    };
+
+    run_ranks(10, false);
+    bool ok = local_tau > 2.0 * whole_tau && whole.get_last_substeps() > 1;
+    for (int r = 0; r < ranks; ++r) {
+        ok = ok && timescales[static_cast<std::size_t>(r)] == whole_tau &&
+             parts[static_cast<std::size_t>(r)].get_last_substeps() == whole.get_last_substeps();
+    }
+    std::size_t at = 0, tracer_at = 0;
+    for (const Simulator& sim : parts) {
+        for (const Body& b : sim.get_bodies()) {
+            const Body& w = whole.get_bodies()[at++];
+            ok = ok && b.pos.x == w.pos.x && b.pos.y == w.pos.y && b.vel.x == w.vel.x && b.vel.y == w.vel.y;
+        }
+        const TestParticles& tp = sim.get_test_particles();
+        for (std::size_t k = 0; k < tp.size(); ++k, ++tracer_at) {
+            ok = ok && tp.x[k] == whole.get_test_particles().x[tracer_at] &&
+                 tp.vy[k] == whole.get_test_particles().vy[tracer_at];
+        }
+    }
+    const Diagnostics ref = whole.diagnostics();
+    double share_sum = 0.0;
+    for (const Diagnostics& d : shares) share_sum += d.potential_energy;
+    ok = ok && std::fabs(share_sum - ref.potential_energy) < 1e-12 * std::fabs(ref.potential_energy);
+    for (const Diagnostics& d : totals) {
+        ok = ok && d.total_energy == totals[0].total_energy &&
+             std::fabs(d.total_energy - ref.total_energy) < 1e-12 * std::fabs(ref.total_energy);
+    }
+
+    run_ranks(10, true);
+    std::size_t total = 0;
+    for (std::size_t c : counts) {
+        total += c;
+        ok = ok && c >= 20 && c <= 40; // 90 targets over 3 ranks
+    }
+    ok = ok && total == 90;
+    double max_dev = 0.0;
+    for (const Simulator& sim : parts) max_dev = std::max(max_dev, max_deviation_by_name(sim, whole));
+    std::cout << "[Domains] targets per rank " << counts[0] << "/" << counts[1] << "/" << counts[2]
+              << ", max deviation after rebalancing " << max_dev << "\n";
+    ok = ok && std::isfinite(references[0]) && references[1] == references[0] && references[2] == references[0];
+    return ok && refused && max_dev < 1e-9 && energy_before_step.load() == 0 && drift_alerts.load() == 0;
+}
+
+#ifndef _WIN32
+bool run_socket_rank(const std::string& prefix, int r, int ranks) {
+    // Rank 'r' of the socket test, run in its own process: compares its
+    // domain with a single simulator it integrates itself.
+    std::vector<Simulator> parts;
+    Simulator whole;
+    make_domain_system(ranks, parts, whole);
+    std::size_t first = 0, first_tracer = 0;
+    for (int q = 0; q < r; ++q) {
+        first += parts[static_cast<std::size_t>(q)].get_bodies().size();
+        first_tracer += parts[static_cast<std::size_t>(q)].get_test_particles().size();
+    }
+
+    SocketTransport transport;
+    Simulator& sim = parts[static_cast<std::size_t>(r)];
+    if (!transport.connect(prefix, r, ranks, 10.0) || !sim.set_transport(&transport)) return false;
+
+    // Blocks far larger than a socket buffer, sent by every rank at once.
+    std::vector<unsigned char> block(1u << 20, static_cast<unsigned char>(r + 1)), all;
+    std::vector<std::size_t> offsets;
+    transport.allgather(block.data(), block.size(), all, offsets);
+    bool ok = offsets.size() == static_cast<std::size_t>(ranks) + 1 && all.size() == block.size() * ranks;
+    for (int q = 0; q < ranks && ok; ++q) {
+        const std::size_t begin = offsets[static_cast<std::size_t>(q)], end = offsets[static_cast<std::size_t>(q) + 1];
+        ok = end - begin == block.size() && all[begin] == q + 1 && all[end - 1] == q + 1;
+    }
+
+    for (int k = 0; k < 10; ++k) {
+        sim.step();
+        whole.step();
+    }
+    for (std::size_t i = 0; i < sim.get_bodies().size(); ++i) {
+        const Body& b = sim.get_bodies()[i];
+        const Body& w = whole.get_bodies()[first + i];
+        ok = ok && b.pos.x == w.pos.x && b.pos.y == w.pos.y && b.vel.x == w.vel.x && b.vel.y == w.vel.y;
+    }
+    const TestParticles& tp = sim.get_test_particles();
+    for (std::size_t k = 0; k < tp.size(); ++k) {
+        ok = ok && tp.x[k] == whole.get_test_particles().x[first_tracer + k] &&
+             tp.vy[k] == whole.get_test_particles().vy[first_tracer + k];
+    }
+    const double energy = reduce_diagnostics(sim.diagnostics(), transport).total_energy;
+    const double ref = whole.diagnostics().total_energy;
+    ok = ok && std::fabs(energy - ref) < 1e-12 * std::fabs(ref);
+
+    sim.rebalance();
+    for (int k = 0; k < 10; ++k) {
+        sim.step();
+        whole.step();
+    }
+    const double targets = transport.sum(static_cast<double>(sim.get_bodies().size() + tp.size()));
+    return ok && targets == 30.0 * ranks && max_deviation_by_name(sim, whole) < 1e-9;
+}
+#endif
+
+bool test_socket_transport_across_processes() {
+    // The same decomposition as above with every rank in its own process,
+    // joined by a SocketTransport.
+#ifdef _WIN32
+    return true;
+#else
+    constexpr int ranks = 3;
+    const std::string prefix = "/tmp/orbitsimlite_tests_" + std::to_string(::getpid()) + "_rank";
+    std::cout.flush();
+    std::vector<pid_t> children;
+    for (int r = 0; r < ranks; ++r) {
+        const pid_t pid = ::fork();
+        if (pid == 0) ::_exit(run_socket_rank(prefix, r, ranks) ? 0 : 1);
+        if (pid > 0) children.push_back(pid);
+    }
+    bool ok = children.size() == static_cast<std::size_t>(ranks);
+    for (pid_t pid : children) {
+        int status = 0;
+        ok = ::waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+    }
+    return ok;
+#endif
+}
 } // namespace
 
 int main() {
@@ -332,6 +1892,41 @@ int main() {
     run("substeps_equivalence", &test_substeps_equivalence);
     run("fixed_body_does_not_move", &test_fixed_body_does_not_move);
     run("satellite_flag_preserved", &test_satellite_flag_preserved);
+    run("diagnostics_match_manual_invariants", &test_diagnostics_match_manual_invariants);
+    run("energy_drift_alert", &test_energy_drift_alert);
+    run("basic_simulator_matches_facade", &test_basic_simulator_matches_facade);
+    run("float_kernel_tracks_double", &test_float_kernel_tracks_double);
+    run("custom_force_law_functor", &test_custom_force_law_functor);
+    run("plummer_softening_bounds_force", &test_plummer_softening_bounds_force);
+    run("spline_softening_kernel", &test_spline_softening_kernel);
+    run("per_body_softening", &test_per_body_softening);
+    run("linear_drag_decay", &test_linear_drag_decay);
+    run("post_newtonian_precession", &test_post_newtonian_precession);
+    run("test_particles_match_massless_bodies", &test_test_particles_match_massless_bodies);
+    run("passive_body_is_not_a_source", &test_passive_body_is_not_a_source);
+    run("kepler_drift_closed_and_open_orbits", &test_kepler_drift_closed_and_open_orbits);
+    run("wisdom_holman_long_steps", &test_wisdom_holman_long_steps);
+    run("ensemble_matches_independent_simulators", &test_ensemble_matches_independent_simulators);
+    run("reproducible_across_thread_counts", &test_reproducible_across_thread_counts);
+    run("compensated_summation_long_run", &test_compensated_summation_long_run);
+    run("density_map_incremental_update", &test_density_map_incremental_update);
+    run("task_queue_runs_every_task", &test_task_queue_runs_every_task);
+    run("telemetry_stream_round_trip", &test_telemetry_stream_round_trip);
+    run("lz_codec_round_trip", &test_lz_codec_round_trip);
+    run("snapshot_codec_bounded_error", &test_snapshot_codec_bounded_error);
+    run("state_publisher_consistent_views", &test_state_publisher_consistent_views);
+    run("interned_body_names", &test_interned_body_names);
+    run("body_handles_stable_across_removal", &test_body_handles_stable_across_removal);
+    run("hierarchical_subsystem_tracks_moon", &test_hierarchical_subsystem_tracks_moon);
+    run("close_encounter_regularization", &test_close_encounter_regularization);
+    run("step_executor_shares_workers", &test_step_executor_shares_workers);
+    run("events_located_within_step", &test_events_located_within_step);
+    run("dense_output_between_steps", &test_dense_output_between_steps);
+    run("auto_substeps_follow_timescale", &test_auto_substeps_follow_timescale);
+    run("spatial_reordering_keeps_handles", &test_spatial_reordering_keeps_handles);
+    run("tiled_forces_match_single_target", &test_tiled_forces_match_single_target);
+    run("domain_decomposition_matches_single_process", &test_domain_decomposition_matches_single_process);
+    run("socket_transport_across_processes", &test_socket_transport_across_processes);
 
     double percent = 100.0 * static_cast<double>(passed) /
                      static_cast<double>(total);